@@ -1,201 +1,324 @@
 /*
 C++ custom implementation of Stack and Queue (Linked List based) data structures
 Note that the Standard Template Library (STL) provides std::stack and std::queue templated classes
+The Stack pushes and pops at the head of the list, so that both are O(1) in a singly linked list (popping at the tail
+would need a walk along the whole list to find the new tail). For large stacks and queues, the array-based ArrayStack
+and RingQueue of containers/array_stack.h and containers/ring_queue.h are much faster still: they need no heap
+allocation per element
+The List owns its Nodes: they are allocated and freed through the allocator Alloc (by default std::allocator, i.e.
+new and delete), copying a List copies its Nodes, and pop() and dequeue() free the Node and return its data.
+With the PoolAllocator of containers/node_pool.h, the Nodes are carved out of large blocks of memory instead, and the
+blocks are released all at once when the List is destroyed
+The containers are templates over the type T of the data in a Node. push(), enqueue() and emplace() take the arguments
+of one of T's constructors, and PERFECTLY FORWARD them (std::forward keeps rvalues as rvalues) to the constructor of the
+data inside the new Node, so that the data is constructed in place exactly once, with no temporary T to copy or move.
+Only what is actually used is required of T: e.g. a T that can be moved but not copied (such as std::unique_ptr) can be
+pushed and popped, but a Stack of them cannot be copied
+The Birds in the tests share a few short calls, so each Bird holds the Symbol of its call in the StringTable of
+containers/string_table.h (4 bytes, compared as an integer) instead of a std::string of its own (32 bytes)
 */
 
 #include <iostream>
+#include <memory>
+#include <utility>
+#include "../containers/node_pool.h"
+#include "../containers/string_table.h"
 using namespace std;
 
 // struct for an entry in the linked list-derived data structures
+template <typename T>
 struct Node {
 
-    int id;
-    string stringvar;
+    T data;
     Node *next_node;
+
+    // construct the data in place, from the arguments of one of T's constructors
+    template <typename... Args>
+    Node(Node *next_node, Args&&... args) : data(std::forward<Args>(args)...), next_node(next_node) {}
 };
 
 // linked list data structure
+template <typename T, typename Alloc = allocator<Node<T>>>
 class List {
 
     public:
 
+    typedef allocator_traits<Alloc> alloc_traits;
+
+    Alloc alloc;
     int n_entries = 0;
-    Node *head = NULL;
-    Node *tail = NULL;
+    Node<T> *head = NULL;
+    Node<T> *tail = NULL;
 
-    List() {}
-    ~List() {}
+    List(const Alloc& alloc = Alloc()) : alloc(alloc) {}
+    ~List() { clear(); }
 
-    List(const List& rhs) {
-        head = rhs.head; tail = rhs.tail;
-        n_entries = rhs.n_entries; }
+    // copying a List copies its Nodes (into Nodes from the same allocator), so that each List owns its own Nodes
+    List(const List& rhs) : alloc(rhs.alloc) {
+        for (Node<T> *node = rhs.head; node != NULL; node = node->next_node) insertnode(node->data); }
 
     List& operator=(const List& rhs) {
-        head = rhs.head; tail = rhs.tail;
-        n_entries = rhs.n_entries; }
-
-    // for both Stack and Queue, Nodes are inserted at the tail end of the List
-    void insertnode(int id, string stringvar) {
-        Node *temp_node = new Node;
-        temp_node->id = id;
-        temp_node->stringvar = stringvar;
-        temp_node->next_node = NULL;
+        if (this != &rhs) {
+            clear();
+            for (Node<T> *node = rhs.head; node != NULL; node = node->next_node) insertnode(node->data); }
+        return *this; }
+
+    /* moving a List takes over its Nodes, leaving rhs empty. The allocator is copied rather than moved, so that both
+       Lists can free the Nodes, and rhs can still allocate new ones (a moved-from PoolAllocator would have no pool) */
+    List(List&& rhs) : alloc(rhs.alloc), n_entries(rhs.n_entries), head(rhs.head), tail(rhs.tail) {
+        rhs.head = NULL; rhs.tail = NULL; rhs.n_entries = 0; }
+
+    List& operator=(List&& rhs) {
+        if (this != &rhs) {
+            clear();
+            alloc = rhs.alloc;
+            head = rhs.head; tail = rhs.tail; n_entries = rhs.n_entries;
+            rhs.head = NULL; rhs.tail = NULL; rhs.n_entries = 0; }
+        return *this; }
+
+    // allocate a Node and construct it, with its data constructed from args
+    template <typename... Args>
+    Node<T> *newnode(Node<T> *next_node, Args&&... args) {
+        Node<T> *node = alloc_traits::allocate(alloc, 1);
+        try {
+            alloc_traits::construct(alloc, node, next_node, std::forward<Args>(args)...);
+        } catch (...) {
+            alloc_traits::deallocate(alloc, node, 1);
+            throw; }
+        return node; }
+
+    // destroy and free a Node
+    void deletenode(Node<T> *node) {
+        alloc_traits::destroy(alloc, node);
+        alloc_traits::deallocate(alloc, node, 1); }
+
+    // for the Queue, Nodes are inserted at the tail end of the List (the Stack inserts at the head)
+    template <typename... Args>
+    void insertnode(Args&&... args) {
+        Node<T> *temp_node = newnode(NULL, std::forward<Args>(args)...);
         if (head==NULL) { // inserting first node in linked list
             head = temp_node;
             tail = temp_node;
-        } else { // inserting another node in existing linked list, at tail 
+        } else { // inserting another node in existing linked list, at tail
             tail->next_node = temp_node;
             tail = temp_node; }
-        temp_node = NULL;
-        delete temp_node;
         n_entries++; }
 
     // insert Node at the head end rather than at the tail end
-    void insertnode_athead(int id, string stringvar) {
-        Node *temp_node = new Node;
-        temp_node->id = id;
-        temp_node->stringvar = stringvar;
+    template <typename... Args>
+    void insertnode_athead(Args&&... args) {
+        Node<T> *temp_node = newnode(head, std::forward<Args>(args)...);
         if (head==NULL) { // inserting first node in linked list
             head = temp_node;
             tail = temp_node;
         } else { // inserting another node in existing linked list, at head
-            temp_node->next_node = head;
             head = temp_node; }
-        temp_node = NULL;
-        delete temp_node;
         n_entries++; }
+
+    // remove the head Node, and return its data (moved out of the Node)
+    T removenode_athead() {
+        Node<T> *temp_node = head;
+        T removed(std::move(temp_node->data));
+        head = head->next_node;
+        if (head == NULL) tail = NULL; // removed the last node
+        deletenode(temp_node);
+        n_entries--;
+        return removed; }
+
+    // free all of the Nodes
+    void clear() {
+        while (head != NULL) {
+            Node<T> *next_node = head->next_node;
+            deletenode(head);
+            head = next_node; }
+        tail = NULL;
+        n_entries = 0; }
 };
 
 // stack (LIFO) data structure based on linked list
 /* NB Stack has no member variables, so there is nothing to do in the copy constructor or copy assignment operator to initialise
       Stack's members from the "right hand side" (rhs) object in a copy or assignment operation. However, one must ensure that
-      the base class List has the opportunity to initialise its members. */
-class Stack : public List {
+      the base class List has the opportunity to initialise its members.
+   NB List<T, Alloc> is a dependent base class, so its members must be referred to as this->head etc. in the Stack */
+template <typename T, typename Alloc = allocator<Node<T>>>
+class Stack : public List<T, Alloc> {
 
     public:
 
-    Stack() {}
+    Stack(const Alloc& alloc = Alloc()) : List<T, Alloc>(alloc) {}
     ~Stack() {}
 
-    Stack(const Stack& rhs) : List(rhs) {} // call copy constructor of List base class
+    Stack(const Stack& rhs) : List<T, Alloc>(rhs) {} // call copy constructor of List base class
 
     Stack& operator=(const Stack& rhs) {
-        List::operator=(rhs); // call copy constructor of List base class
+        List<T, Alloc>::operator=(rhs); // call copy constructor of List base class
+        return *this; }
+
+    Stack(Stack&& rhs) : List<T, Alloc>(std::move(rhs)) {} // call move constructor of List base class
+
+    Stack& operator=(Stack&& rhs) {
+        List<T, Alloc>::operator=(std::move(rhs));
         return *this; }
 
-    int top() {
-        if (head == NULL) {
+    T& top() {
+        if (this->head == NULL) {
             throw runtime_error("error in top(): the Stack is empty");
         } else {
-            return head->id;
+            return this->head->data;
         }
     }
 
-    // push a Node to the tail end
-    void push(int id, string stringvar) {
-        insertnode(id, stringvar);
+    // push a Node to the head end (the top of the Stack), with its data constructed in place from args
+    template <typename... Args>
+    void push(Args&&... args) {
+        this->insertnode_athead(std::forward<Args>(args)...);
     }
 
-    // pop the tail Node
-    Node *pop() {
-        if (head == NULL) {
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        this->insertnode_athead(std::forward<Args>(args)...);
+    }
+
+    // pop the head Node: O(1), the next Node becomes the top
+    T pop() {
+        if (this->head == NULL) {
             throw runtime_error("error in pop(): the Stack is empty");
         } else {
-            Node *current_node = new Node;
-            Node *prev_node = new Node;
-            current_node = head;
-            while (current_node->next_node != NULL) {
-                prev_node = current_node;
-                current_node = current_node->next_node; }
-            tail = prev_node;
-            prev_node->next_node = NULL;
-            if (current_node==head) { // popping the last node, reset head and tail Nodes to NULL
-                head = NULL;
-                tail = NULL; }
-            prev_node = NULL;
-            delete prev_node;
-            n_entries--;
-            return current_node;
+            return this->removenode_athead();
         }
     }
 
-    // return a copy of the tail Node
+    // return a copy of the head Node
     void peek() {
 
     }
 };
 
 // queue (FIFO) data structure based on linked list
-class Queue : public List {
+template <typename T, typename Alloc = allocator<Node<T>>>
+class Queue : public List<T, Alloc> {
 
     public:
 
-    Queue() {}
-    Queue(const Queue& rhs) : List(rhs) {}
+    Queue(const Alloc& alloc = Alloc()) : List<T, Alloc>(alloc) {}
+    Queue(const Queue& rhs) : List<T, Alloc>(rhs) {}
     Queue& operator=(const Queue& rhs) {
-        List::operator=(rhs);
+        List<T, Alloc>::operator=(rhs);
+        return *this; }
+    Queue(Queue&& rhs) : List<T, Alloc>(std::move(rhs)) {}
+    Queue& operator=(Queue&& rhs) {
+        List<T, Alloc>::operator=(std::move(rhs));
         return *this; }
     ~Queue() {}
 
-    // enqueue a Node at the tail end
-    void enqueue(int id, string stringvar) {
-        insertnode(id, stringvar);
+    // enqueue a Node at the tail end, with its data constructed in place from args
+    template <typename... Args>
+    void enqueue(Args&&... args) {
+        this->insertnode(std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        this->insertnode(std::forward<Args>(args)...);
     }
 
     // dequeue the head Node
-    Node *dequeue() {
-        if (head == NULL) {
+    T dequeue() {
+        if (this->head == NULL) {
             throw runtime_error("error in dequeue(): the Queue is empty");
         } else {
-            Node *temp_node = new Node;
-            temp_node = head;
-            head = head->next_node;
-            return temp_node;
+            return this->removenode_athead();
         }
     }
 
 };
 
+// the bird calls, each stored once: a Bird holds the 4-byte Symbol of its call rather than a copy of the string
+StringTable bird_calls;
+
+// the data of the Nodes in the tests
+struct Bird {
+
+    int id;
+    Symbol stringvar;
+
+    Bird(int id, const char *stringvar) : id(id), stringvar(bird_calls.intern(stringvar)) {}
+    Bird(int id, const string& stringvar) : id(id), stringvar(bird_calls.intern(stringvar)) {}
+
+    const char* call() const { return bird_calls.c_str(stringvar); }
+};
+
+// counts how its objects are made, to check that emplacing constructs each element exactly once
+struct Tracked {
+
+    static int n_constructed, n_copied, n_moved;
+    int value;
+
+    Tracked(int value) : value(value) { n_constructed++; }
+    Tracked(const Tracked& rhs) : value(rhs.value) { n_copied++; }
+    Tracked(Tracked&& rhs) : value(rhs.value) { n_moved++; }
+};
+int Tracked::n_constructed = 0, Tracked::n_copied = 0, Tracked::n_moved = 0;
+
 int main () {
 
     // test implementation of Stack
-    Stack stack1;
+    Stack<Bird> stack1;
     stack1.push(1,"quack");
     stack1.push(2,"honk");
     stack1.push(3,"squawk");
 
-    Stack stack2 = stack1; // calls copy constructor of Stack
+    Stack<Bird> stack2 = stack1; // calls copy constructor of Stack
 
-    Stack stack3;
+    Stack<Bird> stack3;
     stack3 = stack2; // calls operator= of Stack
 
     cout << "\nTESTING STACK IMPLEMENTATION:" << endl;
-    Node* popped_node;
     while (stack3.head != NULL) {
-        popped_node = stack3.pop();
-        cout << popped_node->id << "  " << popped_node->stringvar << endl;
+        Bird popped = stack3.pop();
+        cout << popped.id << "  " << popped.call() << endl;
         if ((stack3.head != NULL)&&(stack3.tail != NULL)) {
-            cout << " new head: " << stack3.head->id << "  " << stack3.head->stringvar \
-                 << "\tnew tail: " << stack3.tail->id << "  " << stack3.tail->stringvar << endl; }
-        delete popped_node;
+            cout << " new head: " << stack3.head->data.id << "  " << stack3.head->data.call() \
+                 << "\tnew tail: " << stack3.tail->data.id << "  " << stack3.tail->data.call() << endl; }
     }
 
 
-    // test implementation of Queue
-    Queue queue1;
+    // test implementation of Queue, with its Nodes in a node pool
+    Queue<Bird, PoolAllocator<Node<Bird>>> queue1;
     queue1.enqueue(1,"quack");
     queue1.enqueue(2,"honk");
     queue1.enqueue(3,"squawk");
 
     cout << "\nTESTING QUEUE IMPLEMENTATION: " << endl;
-    Node* deqd_node;
     while (queue1.head != NULL) {
-        deqd_node = queue1.dequeue();
-        cout << deqd_node->id << "  " << deqd_node->stringvar << endl;
+        Bird deqd = queue1.dequeue();
+        cout << deqd.id << "  " << deqd.call() << endl;
         if ((queue1.head != NULL)&&(queue1.tail != NULL)) {
-            cout << " new head: " << queue1.head->id << "  " << queue1.head->stringvar \
-                 << "\tnew tail: " << queue1.tail->id << "  " << queue1.tail->stringvar << endl; }
+            cout << " new head: " << queue1.head->data.id << "  " << queue1.head->data.call() \
+                 << "\tnew tail: " << queue1.tail->data.id << "  " << queue1.tail->data.call() << endl; }
     }
 
+    // a moved-from Queue is empty, but can still be used
+    queue1.enqueue(4,"tweet");
+    Queue<Bird, PoolAllocator<Node<Bird>>> queue3(std::move(queue1));
+    queue1.enqueue(5,"coo");
+    cout << "after a move: " << queue3.n_entries << " entry in the new queue, " << queue1.n_entries \
+         << " in the moved-from one" << endl;
+
+
+    // emplace constructs each element once, in its Node: no copies, and no moves until it is popped
+    cout << "\nTESTING EMPLACE: " << endl;
+    Stack<Tracked> stack4;
+    for (int i=0;i<3;i++) stack4.emplace(i);
+    cout << "after 3 emplaces: " << Tracked::n_constructed << " constructed, " << Tracked::n_copied << " copied, " \
+         << Tracked::n_moved << " moved" << endl;
+
+    // a move-only element type
+    Queue<unique_ptr<string>> queue2;
+    queue2.enqueue(new string("quack"));
+    queue2.enqueue(unique_ptr<string>(new string("honk")));
+    unique_ptr<string> first = queue2.dequeue();
+    cout << "dequeued unique_ptr: " << *first << ", " << queue2.n_entries << " left" << endl;
+
     return 0;
 }
@@ -0,0 +1,210 @@
+/*
+Expression templates (array_expressions.h) against operators that return a new array, and against hand-written loops
+
+The EagerVector below overloads its operators the way CVector (operator_overloading.cpp) and Example6
+(move_constructor.cpp) do: every operator allocates and returns a new array (moved, not copied, thanks to its move
+constructor). For two formulas,
+    F1: r = a + b + c + d
+    F2: r = 2*a - b*c + d/3        (b*c element-wise)
+we measure, for vectors of n doubles, the time per element and the number of arrays allocated per evaluation, with
+    - EAGER operators: one pass over memory and one temporary array per operation
+    - EXPRESSION TEMPLATES (Vector of array_expressions.h): the formula is a tree of types, evaluated in one loop
+    - a HAND-WRITTEN loop, r[j] = a[j] + b[j] + c[j] + d[j]: what expression templates should match
+For small n all the arrays are in the cache, and the difference comes from the allocations and the loop overheads; for
+large n the formulas are limited by memory bandwidth, and the time is about proportional to the data moved: for F1, 4
+reads and 1 write per element instead of 6 reads and 3 writes.
+Then the same for a Matrix, M = A + B - 0.5*C, whose rows are padded (the leading dimension is larger than the number of
+columns), and a few checks: compound assignment (r += ...), a vector on both sides of an assignment (a = a + b), the
+explicit conversion of a row-major matrix for a column-major expression, and a size mismatch, which throws. All the
+results are compared with the hand-written loops: the operations are the same, in the same order, so the sums must be
+bitwise equal. F2 multiplies and adds, and with -march=native the compiler may contract a multiplication and an
+addition into one FMA instruction (a single rounding), not necessarily the same ones in the two loops, so F2 only has to
+agree to within a few roundings.
+
+Compile with:
+g++ -std=c++17 -O3 -march=native -o array_expressions array_expressions.cpp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <utility>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include "../profiling/alloc_counter.h"
+#include "array_expressions.h"
+
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point t_start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+// a vector whose operators each return a new vector
+class EagerVector {
+    double* ptr;
+    size_t n;
+    public:
+    explicit EagerVector(size_t n) : ptr(new double[n]()), n(n) {}
+    EagerVector(const EagerVector& x) : ptr(new double[x.n]), n(x.n) { copy(x.ptr, x.ptr + n, ptr); }
+    EagerVector(EagerVector&& x) noexcept : ptr(x.ptr), n(x.n) { x.ptr = nullptr; x.n = 0; }
+    EagerVector& operator=(EagerVector x) noexcept { swap(ptr, x.ptr); swap(n, x.n); return *this; }
+    ~EagerVector() { delete [] ptr; }
+    size_t size() const { return n; }
+    double& operator[](size_t i) { return ptr[i]; }
+    double operator[](size_t i) const { return ptr[i]; }
+
+    EagerVector operator+(const EagerVector& rhs) const {
+        EagerVector r(n);
+        for (size_t i=0;i<n;i++) r.ptr[i] = ptr[i] + rhs.ptr[i];
+        return r; }
+    EagerVector operator-(const EagerVector& rhs) const {
+        EagerVector r(n);
+        for (size_t i=0;i<n;i++) r.ptr[i] = ptr[i] - rhs.ptr[i];
+        return r; }
+    EagerVector operator*(const EagerVector& rhs) const { // element-wise
+        EagerVector r(n);
+        for (size_t i=0;i<n;i++) r.ptr[i] = ptr[i]*rhs.ptr[i];
+        return r; }
+    EagerVector operator/(double s) const {
+        EagerVector r(n);
+        for (size_t i=0;i<n;i++) r.ptr[i] = ptr[i]/s;
+        return r; }
+    friend EagerVector operator*(double s, const EagerVector& x) {
+        EagerVector r(x.n);
+        for (size_t i=0;i<x.n;i++) r.ptr[i] = s*x.ptr[i];
+        return r; }
+};
+
+struct Timing { double seconds; double allocations; };
+
+// the time and the allocations per call of f, repeated for at least 0.2 s
+template <typename F>
+Timing measure(F f) {
+    int reps = 0;
+    const size_t allocations_before = n_allocations;
+    auto t_start = chrono::steady_clock::now();
+    do {
+        f();
+        reps++;
+    } while (seconds_since(t_start) < 0.2);
+    return Timing{seconds_since(t_start)/reps, double(n_allocations - allocations_before)/reps};
+}
+
+int main () {
+
+    bool all_ok = true;
+
+    for (int formula=1;formula<=2;formula++) {
+        cout << (formula == 1 ? "F1: r = a + b + c + d" : "\nF2: r = 2*a - b*c + d/3") \
+             << "   (ns per element, arrays allocated per evaluation)" << endl;
+        cout << setw(10) << "n" << setw(22) << "eager operators" << setw(22) << "expression templates" \
+             << setw(22) << "hand-written loop" << endl;
+        for (size_t n: {1000, 100000, 10000000}) {
+            EagerVector ea(n), eb(n), ec(n), ed(n), er(n);
+            Vector<double> a(n), b(n), c(n), d(n), r(n), expected(n);
+            for (size_t i=0;i<n;i++) {
+                ea[i] = a[i] = 0.5 + double(i % 101);
+                eb[i] = b[i] = 1.0/double(i % 7 + 1);
+                ec[i] = c[i] = double(i % 13) - 6.0;
+                ed[i] = d[i] = 0.25*double(i % 5); }
+
+            Timing t_eager, t_expression, t_hand;
+            if (formula == 1) {
+                t_eager = measure([&] { er = ea + eb + ec + ed; });
+                t_expression = measure([&] { r = a + b + c + d; });
+                t_hand = measure([&] {
+                    double* out = expected.data();
+                    const double *pa = a.data(), *pb = b.data(), *pc = c.data(), *pd = d.data();
+                    for (size_t i=0;i<n;i++) out[i] = pa[i] + pb[i] + pc[i] + pd[i]; });
+            } else {
+                t_eager = measure([&] { er = 2*ea - eb*ec + ed/3; });
+                t_expression = measure([&] { r = 2*a - elementwise_product(b, c) + d/3; });
+                t_hand = measure([&] {
+                    double* out = expected.data();
+                    const double *pa = a.data(), *pb = b.data(), *pc = c.data(), *pd = d.data();
+                    for (size_t i=0;i<n;i++) out[i] = 2*pa[i] - pb[i]*pc[i] + pd[i]/3; }); }
+            bool ok = true;
+            for (size_t i=0;i<n;i++) {
+                if (formula == 1) {
+                    ok = ok && r[i] == expected[i] && er[i] == expected[i];
+                } else {
+                    const double bound = 4*numeric_limits<double>::epsilon()*(2*fabs(a[i]) + fabs(b[i]*c[i]) + fabs(d[i]/3));
+                    ok = ok && fabs(r[i] - expected[i]) <= bound && fabs(er[i] - expected[i]) <= bound; } }
+            all_ok = all_ok && ok;
+            const double scale = 1.0e9/double(n);
+            cout << setw(10) << n << fixed << setprecision(2) << setw(14) << t_eager.seconds*scale << " (" \
+                 << setprecision(0) << t_eager.allocations << ")" << setprecision(2) << setw(18) \
+                 << t_expression.seconds*scale << " (" << setprecision(0) << t_expression.allocations << ")" \
+                 << setprecision(2) << setw(18) << t_hand.seconds*scale << " (" << setprecision(0) \
+                 << t_hand.allocations << ")" << (ok ? "" : "   WRONG RESULTS") << endl;
+            cout.unsetf(ios::fixed); } }
+
+    // matrices with padded rows
+    {
+    const size_t rows = 3000, cols = 3001;
+    Matrix<double> a(rows, cols), b(rows, cols), c(rows, cols), m(rows, cols);
+    DenseMatrix<double> expected(rows, cols);
+    for (size_t i=0;i<rows;i++) {
+        for (size_t j=0;j<cols;j++) {
+            a(i, j) = double((i + j) % 17);
+            b(i, j) = double(i % 3) - 1.0;
+            c(i, j) = double(j % 11); } }
+    const Timing t_expression = measure([&] { m = a + b - 0.5*c; });
+    const Timing t_hand = measure([&] {
+        for (size_t i=0;i<rows;i++) {
+            double* out = expected.line(i).data();
+            const double *pa = a.dense().line(i).data(), *pb = b.dense().line(i).data(), *pc = c.dense().line(i).data();
+            for (size_t j=0;j<cols;j++) out[j] = pa[j] + pb[j] - 0.5*pc[j]; } });
+    const bool ok = m.dense() == expected;
+    all_ok = all_ok && ok;
+    cout << "\nMatrix " << rows << " x " << cols << " (leading dimension " << a.dense().leading_dimension() \
+         << "): M = A + B - 0.5*C (ns per element)" << endl;
+    cout << fixed << setprecision(2) << setw(32) << "expression templates" << setw(10) \
+         << t_expression.seconds*1.0e9/double(rows*cols) << " (" << setprecision(0) << t_expression.allocations \
+         << " allocations)" << endl;
+    cout << setprecision(2) << setw(32) << "hand-written loop" << setw(10) << t_hand.seconds*1.0e9/double(rows*cols) \
+         << (ok ? "" : "   WRONG RESULTS") << endl;
+    cout.unsetf(ios::fixed);
+    }
+
+    // other checks
+    {
+    const size_t n = 1001;
+    Vector<double> a(n, 1.5), b(n), r(n, 2.0);
+    for (size_t i=0;i<n;i++) b[i] = double(i);
+    r += 2*a - b;          // 2 + 3 - i
+    a = a + b;             // 1.5 + i, with a on both sides
+    r -= a/2;              // 5 - i - (1.5 + i)/2
+    bool ok = true;
+    for (size_t i=0;i<n;i++) ok = ok && r[i] == (2.0 + (2*1.5 - double(i))) - (1.5 + double(i))/2 && a[i] == 1.5 + double(i);
+    Vector<double> fresh = -(a - 1.5) + 1.0; // 1 - i: construction from an expression
+    for (size_t i=0;i<n;i++) ok = ok && fresh[i] == 1.0 - double(i);
+    Matrix<float, Layout::ColMajor> p(5, 7, 2.0f), q(5, 7, 3.0f);
+    p *= 2.0f;
+    q = elementwise_quotient(q, p) + p; // 3/4 + 4
+    ok = ok && q(4, 6) == 4.75f && q.rows() == 5 && q.cols() == 7;
+    // mixed layouts are converted explicitly: "q = a_row_major;" or "q = q + a_row_major;" does not compile
+    Matrix<float> a_row_major(5, 7);
+    for (size_t i=0;i<5;i++) {
+        for (size_t j=0;j<7;j++) a_row_major(i, j) = float(10*i + j); }
+    copy(a_row_major.dense().view(), q.dense().view());
+    const Matrix<float, Layout::ColMajor> converted(DenseMatrix<float, Layout::ColMajor>(a_row_major.dense()));
+    q = q + converted;
+    for (size_t i=0;i<5;i++) {
+        for (size_t j=0;j<7;j++) ok = ok && q(i, j) == float(20*i + 2*j); }
+    bool thrown = false;
+    try {
+        Vector<double> x(10), y(11), z(10);
+        z = x + y;
+    } catch (const runtime_error&) {
+        thrown = true; }
+    ok = ok && thrown;
+    all_ok = all_ok && ok;
+    cout << "\ncompound assignments, aliasing, column-major matrices, layout conversions, size mismatch: " << (ok ? "correct" : "WRONG") << endl;
+    }
+
+    cout << "\nresults " << (all_ok ? "correct" : "WRONG") << endl;
+    return all_ok ? 0 : 1;
+}
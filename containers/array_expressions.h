@@ -0,0 +1,366 @@
+/*
+Vector<T> and Matrix<T, Layout>: element-wise arithmetic with EXPRESSION TEMPLATES
+
+The operator+ of CVector (operator_overloading.cpp) and of Example6 (move_constructor.cpp) returns a new object, which
+is the natural way to overload an operator: in r = a + b + c + d, a + b is computed into a temporary t1, then t1 + c
+into t2, then t2 + d into r. For arrays of n elements, that is 2 allocations of temporaries, and 3 loops that together
+read 6n and write 3n elements, where a single loop reading 4n and writing n would do. Once the arrays are larger than
+the cache, such formulas are limited by memory bandwidth, so the time is proportional to the number of passes.
+With expression templates, the operators compute NOTHING: a + b returns a small object of type
+BinaryExpression<AddOp, Vector, Vector> that refers to a and b, (a + b) + c returns a BinaryExpression that contains the
+first one and refers to c, and so on, so that the type of a + b + c + d is the tree of the formula. Only the assignment
+r = ... evaluates it, in ONE loop, r[j] = a[j] + b[j] + c[j] + d[j]: all the calls of the tree are inlined, and the loop
+is vectorized like a hand-written one, with no temporary array at all. The same holds for the compound assignments
+(r += 2*a - b is one loop).
+The nodes are: BinaryExpression (+ and - between arrays, and the element-wise product elementwise_product(a, b) and
+quotient elementwise_quotient(a, b)), UnaryExpression (unary -) and ScalarExpression (a number, broadcast to the shape of
+the other operand: 2*a, a*2, a/2, a + 1, ...). The sizes are checked when the tree is built, and mismatches throw
+std::runtime_error; the operands of a matrix expression, and the Matrix it is assigned to, must all have the same layout
+(checked at compile time: a mixed-layout expression would read one of them across its lines). Convert explicitly, with
+copy() or the converting constructor of DenseMatrix (dense_matrix.h), which transpose in cache-friendly tiles.
+Evaluation works line by line (the contiguous rows of a row-major matrix, the columns of a column-major one, and the
+single line of a Vector), so each array is read sequentially even when matrices with different leading dimensions are
+combined. The operations are element-wise, and element j of the result only depends on the elements j of the operands,
+so an array can appear on both sides of an assignment (a = a + b). Products of matrices are not element-wise, and are
+not expressions: gemm.h computes them (from the DenseMatrix of each Matrix, see dense()).
+The nodes hold arrays by reference and sub-expressions by value, so an expression must not outlive its operands: it is
+meant to be assigned right away, not stored (auto e = a + b is fine while a and b exist, auto e = a + Vector<double>(n)
+is not).
+
+Requires C++17 (dense_matrix.h).
+*/
+
+#ifndef ARRAY_EXPRESSIONS_H
+#define ARRAY_EXPRESSIONS_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include "dense_matrix.h"
+
+// the base of all the expressions (E is the actual type of the expression: the curiously recurring template pattern)
+template <typename E>
+class ArrayExpression {
+    public:
+    const E& derived() const { return static_cast<const E&>(*this); }
+};
+
+template <typename T> class Vector;
+template <typename T, Layout L> class Matrix;
+
+// how a node holds an operand: arrays by reference, nodes (small objects, often temporaries) by value
+template <typename E> struct ExpressionOperand { typedef const E type; };
+template <typename T> struct ExpressionOperand<Vector<T>> { typedef const Vector<T>& type; };
+template <typename T, Layout L> struct ExpressionOperand<Matrix<T, L>> { typedef const Matrix<T, L>& type; };
+
+struct AddOp { template <typename T> static T apply(T a, T b) { return a + b; } };
+struct SubtractOp { template <typename T> static T apply(T a, T b) { return a - b; } };
+struct MultiplyOp { template <typename T> static T apply(T a, T b) { return a*b; } };
+struct DivideOp { template <typename T> static T apply(T a, T b) { return a/b; } };
+struct NegateOp { template <typename T> static T apply(T a) { return -a; } };
+
+// a number, with the shape of the array it is combined with
+template <typename T, Layout L>
+class ScalarExpression : public ArrayExpression<ScalarExpression<T, L>> {
+
+    T value;
+    std::size_t n_lines, length;
+
+    public:
+
+    typedef T value_type;
+    static constexpr Layout layout = L;
+
+    ScalarExpression(T value, std::size_t n_lines, std::size_t length) : value(value), n_lines(n_lines), length(length) {}
+
+    std::size_t lines() const { return n_lines; }
+    std::size_t line_length() const { return length; }
+    T line_element(std::size_t, std::size_t) const { return value; }
+};
+
+template <typename Op, typename E1, typename E2>
+class BinaryExpression : public ArrayExpression<BinaryExpression<Op, E1, E2>> {
+
+    static_assert(E1::layout == E2::layout, "error in array expression: the matrices have different layouts");
+
+    typename ExpressionOperand<E1>::type lhs;
+    typename ExpressionOperand<E2>::type rhs;
+
+    public:
+
+    typedef typename E1::value_type value_type;
+    static constexpr Layout layout = E1::layout;
+
+    BinaryExpression(const E1& lhs, const E2& rhs) : lhs(lhs), rhs(rhs) {
+        if (lhs.lines() != rhs.lines() || lhs.line_length() != rhs.line_length())
+            throw std::runtime_error("error in array expression: the operands have different sizes");
+    }
+
+    std::size_t lines() const { return lhs.lines(); }
+    std::size_t line_length() const { return lhs.line_length(); }
+    value_type line_element(std::size_t k, std::size_t j) const {
+        return Op::apply(lhs.line_element(k, j), rhs.line_element(k, j));
+    }
+};
+
+template <typename Op, typename E>
+class UnaryExpression : public ArrayExpression<UnaryExpression<Op, E>> {
+
+    typename ExpressionOperand<E>::type operand;
+
+    public:
+
+    typedef typename E::value_type value_type;
+    static constexpr Layout layout = E::layout;
+
+    explicit UnaryExpression(const E& operand) : operand(operand) {}
+
+    std::size_t lines() const { return operand.lines(); }
+    std::size_t line_length() const { return operand.line_length(); }
+    value_type line_element(std::size_t k, std::size_t j) const { return Op::apply(operand.line_element(k, j)); }
+};
+
+// evaluate an expression into dst (of the same shape), in one loop per line with the whole tree inlined; the operands
+// may include dst itself, as element j of the result only depends on the elements j of the operands
+template <typename T, Layout L, typename E>
+void evaluate_expression(MatrixView<T, L> dst, const E& e) {
+    for (std::size_t k=0;k<dst.lines();k++) {
+        T* out = dst.line(k).data();
+        const std::size_t n = dst.line(k).size();
+        #pragma GCC ivdep
+        for (std::size_t j=0;j<n;j++) out[j] = e.line_element(k, j); }
+}
+
+template <typename T>
+class Vector : public ArrayExpression<Vector<T>> {
+
+    DenseMatrix<T> elements; // a single row: one aligned allocation
+
+    template <typename E>
+    void check_shape(const ArrayExpression<E>& e) const {
+        if (e.derived().lines() != 1 || e.derived().line_length() != size())
+            throw std::runtime_error("error in Vector: the expression has a different size");
+    }
+
+    public:
+
+    typedef T value_type;
+    static constexpr Layout layout = Layout::RowMajor;
+
+    Vector() {}
+    explicit Vector(std::size_t n) : elements(1, n) {}
+    Vector(std::size_t n, const T& value) : elements(1, n) { elements.fill(value); }
+
+    // evaluate an expression into a new vector
+    template <typename E>
+    Vector(const ArrayExpression<E>& e) : elements(1, e.derived().line_length()) {
+        check_shape(e);
+        evaluate_expression(elements.view(), e.derived());
+    }
+
+    template <typename E>
+    Vector& operator=(const ArrayExpression<E>& e) {
+        if (e.derived().lines() != 1 || e.derived().line_length() != size()) {
+            Vector v(e); // a new size: evaluate into new storage
+            swap(v);
+        } else {
+            evaluate_expression(elements.view(), e.derived()); }
+        return *this;
+    }
+
+    template <typename E>
+    Vector& operator+=(const ArrayExpression<E>& e) {
+        check_shape(e);
+        evaluate_expression(elements.view(), BinaryExpression<AddOp, Vector, E>(*this, e.derived()));
+        return *this;
+    }
+
+    template <typename E>
+    Vector& operator-=(const ArrayExpression<E>& e) {
+        check_shape(e);
+        evaluate_expression(elements.view(), BinaryExpression<SubtractOp, Vector, E>(*this, e.derived()));
+        return *this;
+    }
+
+    Vector& operator*=(const T& s) {
+        for (T& x: *this) x *= s;
+        return *this;
+    }
+
+    Vector& operator/=(const T& s) {
+        for (T& x: *this) x /= s;
+        return *this;
+    }
+
+    void swap(Vector& other) noexcept { elements.swap(other.elements); }
+
+    std::size_t size() const { return elements.cols(); }
+    T& operator[](std::size_t i) { return elements.data()[i]; }
+    const T& operator[](std::size_t i) const { return elements.data()[i]; }
+    T* data() { return elements.data(); }
+    const T* data() const { return elements.data(); }
+    T* begin() { return elements.data(); }
+    T* end() { return elements.data() + size(); }
+    const T* begin() const { return elements.data(); }
+    const T* end() const { return elements.data() + size(); }
+
+    std::size_t lines() const { return 1; }
+    std::size_t line_length() const { return size(); }
+    T line_element(std::size_t, std::size_t j) const { return elements.data()[j]; }
+};
+
+template <typename T, Layout L = Layout::RowMajor>
+class Matrix : public ArrayExpression<Matrix<T, L>> {
+
+    DenseMatrix<T, L> elements;
+
+    template <typename E>
+    void check_shape(const ArrayExpression<E>& e) const {
+        if (e.derived().lines() != lines() || e.derived().line_length() != line_length())
+            throw std::runtime_error("error in Matrix: the expression has a different size");
+    }
+
+    // the (rows, cols) of an expression of lines
+    static std::size_t rows_of(std::size_t n_lines, std::size_t length) { return L == Layout::RowMajor ? n_lines : length; }
+    static std::size_t cols_of(std::size_t n_lines, std::size_t length) { return L == Layout::RowMajor ? length : n_lines; }
+
+    public:
+
+    typedef T value_type;
+    static constexpr Layout layout = L;
+
+    Matrix() {}
+    Matrix(std::size_t n_rows, std::size_t n_cols) : elements(n_rows, n_cols) {}
+    Matrix(std::size_t n_rows, std::size_t n_cols, const T& value) : elements(n_rows, n_cols) { elements.fill(value); }
+    explicit Matrix(DenseMatrix<T, L> m) : elements(std::move(m)) {}
+
+    template <typename E>
+    Matrix(const ArrayExpression<E>& e) :
+        elements(rows_of(e.derived().lines(), e.derived().line_length()), cols_of(e.derived().lines(), e.derived().line_length())) {
+        static_assert(E::layout == L, "error in Matrix: the expression has a different layout (convert it with copy())");
+        evaluate_expression(elements.view(), e.derived());
+    }
+
+    template <typename E>
+    Matrix& operator=(const ArrayExpression<E>& e) {
+        static_assert(E::layout == L, "error in Matrix: the expression has a different layout (convert it with copy())");
+        if (e.derived().lines() != lines() || e.derived().line_length() != line_length()) {
+            Matrix m(e);
+            swap(m);
+        } else {
+            evaluate_expression(elements.view(), e.derived()); }
+        return *this;
+    }
+
+    template <typename E>
+    Matrix& operator+=(const ArrayExpression<E>& e) {
+        check_shape(e);
+        evaluate_expression(elements.view(), BinaryExpression<AddOp, Matrix, E>(*this, e.derived()));
+        return *this;
+    }
+
+    template <typename E>
+    Matrix& operator-=(const ArrayExpression<E>& e) {
+        check_shape(e);
+        evaluate_expression(elements.view(), BinaryExpression<SubtractOp, Matrix, E>(*this, e.derived()));
+        return *this;
+    }
+
+    Matrix& operator*=(const T& s) {
+        evaluate_expression(elements.view(), BinaryExpression<MultiplyOp, Matrix, ScalarExpression<T, L>>(*this,
+                            ScalarExpression<T, L>(s, lines(), line_length())));
+        return *this;
+    }
+
+    Matrix& operator/=(const T& s) {
+        evaluate_expression(elements.view(), BinaryExpression<DivideOp, Matrix, ScalarExpression<T, L>>(*this,
+                            ScalarExpression<T, L>(s, lines(), line_length())));
+        return *this;
+    }
+
+    void swap(Matrix& other) noexcept { elements.swap(other.elements); }
+
+    std::size_t rows() const { return elements.rows(); }
+    std::size_t cols() const { return elements.cols(); }
+    T& operator()(std::size_t i, std::size_t j) { return elements(i, j); }
+    const T& operator()(std::size_t i, std::size_t j) const { return elements(i, j); }
+
+    // the underlying DenseMatrix, e.g. for gemm()
+    DenseMatrix<T, L>& dense() { return elements; }
+    const DenseMatrix<T, L>& dense() const { return elements; }
+
+    std::size_t lines() const { return elements.lines(); }
+    std::size_t line_length() const { return L == Layout::RowMajor ? elements.cols() : elements.rows(); }
+    T line_element(std::size_t k, std::size_t j) const { return elements.data()[k*elements.leading_dimension() + j]; }
+};
+
+template <typename E1, typename E2>
+BinaryExpression<AddOp, E1, E2> operator+(const ArrayExpression<E1>& a, const ArrayExpression<E2>& b) {
+    return BinaryExpression<AddOp, E1, E2>(a.derived(), b.derived());
+}
+
+template <typename E1, typename E2>
+BinaryExpression<SubtractOp, E1, E2> operator-(const ArrayExpression<E1>& a, const ArrayExpression<E2>& b) {
+    return BinaryExpression<SubtractOp, E1, E2>(a.derived(), b.derived());
+}
+
+template <typename E1, typename E2>
+BinaryExpression<MultiplyOp, E1, E2> elementwise_product(const ArrayExpression<E1>& a, const ArrayExpression<E2>& b) {
+    return BinaryExpression<MultiplyOp, E1, E2>(a.derived(), b.derived());
+}
+
+template <typename E1, typename E2>
+BinaryExpression<DivideOp, E1, E2> elementwise_quotient(const ArrayExpression<E1>& a, const ArrayExpression<E2>& b) {
+    return BinaryExpression<DivideOp, E1, E2>(a.derived(), b.derived());
+}
+
+template <typename E>
+UnaryExpression<NegateOp, E> operator-(const ArrayExpression<E>& a) {
+    return UnaryExpression<NegateOp, E>(a.derived());
+}
+
+// the operations with a number (typename E::value_type is not deduced, so that 2*a works for a vector of doubles)
+template <typename E>
+using ScalarOf = ScalarExpression<typename E::value_type, E::layout>;
+
+template <typename E>
+ScalarOf<E> scalar_like(typename E::value_type s, const ArrayExpression<E>& a) {
+    return ScalarOf<E>(s, a.derived().lines(), a.derived().line_length());
+}
+
+template <typename E>
+BinaryExpression<MultiplyOp, ScalarOf<E>, E> operator*(typename E::value_type s, const ArrayExpression<E>& a) {
+    return BinaryExpression<MultiplyOp, ScalarOf<E>, E>(scalar_like(s, a), a.derived());
+}
+
+template <typename E>
+BinaryExpression<MultiplyOp, E, ScalarOf<E>> operator*(const ArrayExpression<E>& a, typename E::value_type s) {
+    return BinaryExpression<MultiplyOp, E, ScalarOf<E>>(a.derived(), scalar_like(s, a));
+}
+
+template <typename E>
+BinaryExpression<DivideOp, E, ScalarOf<E>> operator/(const ArrayExpression<E>& a, typename E::value_type s) {
+    return BinaryExpression<DivideOp, E, ScalarOf<E>>(a.derived(), scalar_like(s, a));
+}
+
+template <typename E>
+BinaryExpression<AddOp, E, ScalarOf<E>> operator+(const ArrayExpression<E>& a, typename E::value_type s) {
+    return BinaryExpression<AddOp, E, ScalarOf<E>>(a.derived(), scalar_like(s, a));
+}
+
+template <typename E>
+BinaryExpression<AddOp, ScalarOf<E>, E> operator+(typename E::value_type s, const ArrayExpression<E>& a) {
+    return BinaryExpression<AddOp, ScalarOf<E>, E>(scalar_like(s, a), a.derived());
+}
+
+template <typename E>
+BinaryExpression<SubtractOp, E, ScalarOf<E>> operator-(const ArrayExpression<E>& a, typename E::value_type s) {
+    return BinaryExpression<SubtractOp, E, ScalarOf<E>>(a.derived(), scalar_like(s, a));
+}
+
+template <typename E>
+BinaryExpression<SubtractOp, ScalarOf<E>, E> operator-(typename E::value_type s, const ArrayExpression<E>& a) {
+    return BinaryExpression<SubtractOp, ScalarOf<E>, E>(scalar_like(s, a), a.derived());
+}
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ArrayStack<T>: a stack (LIFO) stored in one contiguous, growable array
+
+The linked list Stack of brief_examples/stack_and_queue.cpp allocates one Node on the heap per element, and every
+element access follows a pointer to a random place in memory. A stack only ever touches its top element, so it can
+instead keep its elements in an array, as std::vector does:
+    - push writes the element into the first unused slot, pop takes it from the last used slot: O(1)
+    - when the array is full, a new array of TWICE the capacity is allocated and the elements are moved into it. This
+      costs O(n), but happens only after n/2 cheap pushes since the last growth, so a push costs O(1) AMORTISED. (Growing
+      by a constant amount instead would make n pushes cost O(n^2) in total)
+    - there is one heap allocation per doubling rather than one per element, and consecutive elements are next to each
+      other in memory, so pushes and pops run at cache speed
+
+The array is raw, uninitialised memory (from std::allocator), and elements are constructed in it only when they are
+pushed, with placement new, and destroyed when they are popped. So T does not need a default constructor, and a pop
+really does destroy the element (e.g. releases the memory of a popped std::string).
+When the array grows, the elements are MOVED into the new array if T's move constructor is noexcept, and copied
+otherwise (std::move_if_noexcept), as std::vector does: if a move could throw half way through, neither array would
+hold all of the elements any more, whereas if a copy throws, the old array is still intact and we can give up cleanly.
+Move-only element types (e.g. std::unique_ptr) are always moved. emplace() constructs a new element directly in its
+slot of the array, from the arguments of one of T's constructors, so that pushing a large struct costs one construction
+and no copies or moves.
+*/
+
+#ifndef ARRAY_STACK_H
+#define ARRAY_STACK_H
+
+#include <memory>
+#include <utility>
+#include <stdexcept>
+#include <algorithm>
+#include <cstddef>
+
+template <typename T>
+class ArrayStack {
+
+    std::allocator<T> alloc;
+    T* data = nullptr;
+    std::size_t n = 0;   // number of elements
+    std::size_t cap = 0; // number of slots in data
+
+    // move (or copy) the elements into a new array of new_cap slots. If a copy throws, the stack is unchanged
+    void reallocate(std::size_t new_cap) {
+        T* new_data = alloc.allocate(new_cap);
+        std::size_t i = 0;
+        try {
+            for (;i<n;i++) ::new (static_cast<void*>(new_data+i)) T(std::move_if_noexcept(data[i]));
+        } catch (...) {
+            destroy_range(new_data, i);
+            alloc.deallocate(new_data, new_cap);
+            throw; }
+        destroy_range(data, n);
+        if (data) alloc.deallocate(data, cap);
+        data = new_data;
+        cap = new_cap;
+    }
+
+    static void destroy_range(T* p, std::size_t count) {
+        for (std::size_t i=0;i<count;i++) p[i].~T();
+    }
+
+    std::size_t grown_capacity() const { return cap == 0 ? 16 : 2*cap; }
+
+    /* emplace into a full array: the arguments may refer to elements of this stack (e.g. s.push(s.top())), so the new
+       element is constructed in the new array BEFORE the old elements are moved out from under them */
+    template <typename... Args>
+    void emplace_grow(Args&&... args) {
+        const std::size_t new_cap = grown_capacity();
+        T* new_data = alloc.allocate(new_cap);
+        try {
+            ::new (static_cast<void*>(new_data+n)) T(std::forward<Args>(args)...);
+        } catch (...) {
+            alloc.deallocate(new_data, new_cap);
+            throw; }
+        std::size_t i = 0;
+        try {
+            for (;i<n;i++) ::new (static_cast<void*>(new_data+i)) T(std::move_if_noexcept(data[i]));
+        } catch (...) {
+            destroy_range(new_data, i);
+            new_data[n].~T();
+            alloc.deallocate(new_data, new_cap);
+            throw; }
+        destroy_range(data, n);
+        if (data) alloc.deallocate(data, cap);
+        data = new_data;
+        cap = new_cap;
+    }
+
+    public:
+
+    ArrayStack() {}
+
+    explicit ArrayStack(std::size_t initial_capacity) { reserve(initial_capacity); }
+
+    ~ArrayStack() {
+        clear();
+        if (data) alloc.deallocate(data, cap);
+    }
+
+    /* one allocation and one pass of copy constructions. The copy keeps the capacity of rhs, so that a push right after
+       copying (as in backtracking, where a copy of the state is extended) does not reallocate */
+    ArrayStack(const ArrayStack& rhs) {
+        if (rhs.cap == 0) return;
+        T* new_data = alloc.allocate(rhs.cap);
+        try {
+            std::uninitialized_copy(rhs.data, rhs.data+rhs.n, new_data); // destroys what it constructed if a copy throws
+        } catch (...) {
+            alloc.deallocate(new_data, rhs.cap);
+            throw; }
+        data = new_data;
+        n = rhs.n;
+        cap = rhs.cap;
+    }
+
+    ArrayStack(ArrayStack&& rhs) noexcept : data(rhs.data), n(rhs.n), cap(rhs.cap) {
+        rhs.data = nullptr; rhs.n = 0; rhs.cap = 0;
+    }
+
+    // copy-and-swap: rhs is copied (or moved) into the argument, and the old contents are destroyed with it
+    ArrayStack& operator=(ArrayStack rhs) noexcept {
+        swap(rhs);
+        return *this;
+    }
+
+    void swap(ArrayStack& other) noexcept {
+        std::swap(data, other.data);
+        std::swap(n, other.n);
+        std::swap(cap, other.cap);
+    }
+
+    std::size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    std::size_t capacity() const { return cap; }
+
+    // make room for at least new_cap elements, so that the next new_cap-size() pushes do not reallocate
+    void reserve(std::size_t new_cap) {
+        if (new_cap > cap) reallocate(new_cap);
+    }
+
+    // release the unused part of the array
+    void shrink_to_fit() {
+        if (n == 0) {
+            if (data) alloc.deallocate(data, cap);
+            data = nullptr; cap = 0;
+        } else if (n < cap) {
+            reallocate(n); }
+    }
+
+    void push(const T& x) { emplace(x); }
+
+    void push(T&& x) { emplace(std::move(x)); }
+
+    /* construct a new top element in place, from the arguments of one of T's constructors: the element is constructed
+       exactly once, directly in the array, e.g. s.emplace(id, name) rather than s.push(Record(id, name)) */
+    template <typename... Args>
+    T& emplace(Args&&... args) {
+        if (n == cap) {
+            emplace_grow(std::forward<Args>(args)...);
+        } else {
+            ::new (static_cast<void*>(data+n)) T(std::forward<Args>(args)...); }
+        return data[n++];
+    }
+
+    T& top() {
+        if (n == 0) throw std::runtime_error("error in top(): the ArrayStack is empty");
+        return data[n-1];
+    }
+
+    const T& top() const {
+        if (n == 0) throw std::runtime_error("error in top(): the ArrayStack is empty");
+        return data[n-1];
+    }
+
+    // remove the top element and return it (moved out of the array)
+    T pop() {
+        if (n == 0) throw std::runtime_error("error in pop(): the ArrayStack is empty");
+        T x(std::move(data[n-1]));
+        data[--n].~T();
+        return x;
+    }
+
+    // remove the top element without returning it
+    void discard() {
+        if (n == 0) throw std::runtime_error("error in discard(): the ArrayStack is empty");
+        data[--n].~T();
+    }
+
+    // destroy all of the elements, keeping the array for reuse
+    void clear() {
+        destroy_range(data, n);
+        n = 0;
+    }
+};
+
+#endif
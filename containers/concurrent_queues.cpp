@@ -0,0 +1,196 @@
+/*
+Throughput and latency of the queues of concurrent_queues.h, against a std::queue protected by a mutex
+
+P producer threads each enqueue N/P messages, and C consumer threads each dequeue N/C messages. Every message carries
+the time at which it was enqueued, so that the consumers can measure the LATENCY of the queue, i.e. how long a message
+waited between enqueue and dequeue (we keep every 16th latency and report the median and 99th percentile), and the
+THROUGHPUT is the total number of messages divided by the time until the last one has been dequeued. The consumers
+also add up the sequence numbers of the messages they receive, to check that every message arrived exactly once.
+The queues compared are
+    - LockedQueue: std::queue protected by a std::mutex, where a consumer that finds the queue empty waits on a
+      condition variable, the usual first implementation of a work queue between threads
+    - SpscQueue (1 producer, 1 consumer only), one message at a time and in batches of 64
+    - MpmcQueue, for several combinations of numbers of producers and consumers
+The lock-free queues are BOUNDED (here to 1024 messages), so a fast producer is held back until the consumers catch up,
+whereas the LockedQueue can grow without limit.
+
+NB with more threads than cores, a thread that spins waiting for a queue takes CPU time from the thread it is waiting
+for. The blocking operations therefore yield the CPU after a short spin, but the results with P+C greater than the
+number of cores still mostly measure the operating system's scheduler.
+
+Run with an optional number of messages, e.g. ./concurrent_queues 10000000 (rounded up to a multiple of 1024). The
+program exits with a non-zero status if any run loses messages.
+
+Compile with:
+g++ -std=c++17 -O2 -o concurrent_queues concurrent_queues.cpp -pthread
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include "concurrent_queues.h"
+
+using namespace std;
+
+struct Message {
+    uint64_t seq;
+    int64_t t_enqueue; // ns
+};
+
+int64_t now_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// std::queue with a mutex and a condition variable, with the same vocabulary as the lock-free queues
+template <typename T>
+class LockedQueue {
+    queue<T> q;
+    mutex m;
+    condition_variable not_empty;
+
+    public:
+
+    explicit LockedQueue(size_t) {}
+
+    void enqueue(const T& x) {
+        {
+        lock_guard<mutex> lock(m);
+        q.push(x);
+        }
+        not_empty.notify_one();
+    }
+
+    T dequeue() {
+        unique_lock<mutex> lock(m);
+        not_empty.wait(lock, [this]() { return !q.empty(); });
+        T x = q.front();
+        q.pop();
+        return x;
+    }
+
+    void enqueue_bulk(const T* first, size_t count) {
+        {
+        lock_guard<mutex> lock(m);
+        for (size_t i=0;i<count;i++) q.push(first[i]);
+        }
+        not_empty.notify_all();
+    }
+
+    void dequeue_bulk(T* out, size_t count) {
+        while (count > 0) {
+            unique_lock<mutex> lock(m);
+            not_empty.wait(lock, [this]() { return !q.empty(); });
+            while (count > 0 && !q.empty()) {
+                *out++ = q.front();
+                q.pop();
+                count--; } }
+    }
+};
+
+struct Result {
+    double messages_per_second, median_latency_us, p99_latency_us;
+    bool ok;
+};
+
+// run P producers and C consumers through a new queue of type Q, one message at a time or in batches of batch_size
+template <typename Q>
+Result run(int n_producers, int n_consumers, size_t n_messages, size_t batch_size) {
+    Q q(1024);
+    const size_t per_producer = n_messages/n_producers, per_consumer = n_messages/n_consumers;
+    vector<vector<double>> latencies(n_consumers);
+    vector<uint64_t> sums(n_consumers, 0);
+    atomic<int> ready{0};
+    vector<thread> threads;
+
+    for (int p=0;p<n_producers;p++) {
+        threads.emplace_back([&, p]() {
+            ready++;
+            while (ready.load() < n_producers + n_consumers) {} // start together
+            vector<Message> batch(batch_size);
+            for (size_t i=0;i<per_producer;i+=batch_size) {
+                if (batch_size == 1) {
+                    q.enqueue(Message{p*per_producer + i, now_ns()});
+                } else {
+                    int64_t t = now_ns();
+                    for (size_t j=0;j<batch_size;j++) batch[j] = Message{p*per_producer + i + j, t};
+                    q.enqueue_bulk(batch.data(), batch_size); } }
+        }); }
+
+    for (int c=0;c<n_consumers;c++) {
+        threads.emplace_back([&, c]() {
+            latencies[c].reserve(per_consumer/16 + 1);
+            ready++;
+            while (ready.load() < n_producers + n_consumers) {}
+            vector<Message> batch(batch_size);
+            uint64_t sum = 0;
+            for (size_t i=0;i<per_consumer;i+=batch_size) {
+                if (batch_size == 1) {
+                    batch[0] = q.dequeue();
+                } else {
+                    q.dequeue_bulk(batch.data(), batch_size); }
+                int64_t t = now_ns();
+                for (size_t j=0;j<batch_size;j++) {
+                    sum += batch[j].seq;
+                    if ((i+j) % 16 == 0) latencies[c].push_back(1.0e-3*double(t - batch[j].t_enqueue)); } }
+            sums[c] = sum;
+        }); }
+
+    while (ready.load() < n_producers + n_consumers) {}
+    auto t_start = chrono::steady_clock::now();
+    for (thread& t: threads) t.join();
+    double t = chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+
+    vector<double> all;
+    uint64_t sum = 0;
+    for (int c=0;c<n_consumers;c++) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        sum += sums[c]; }
+    sort(all.begin(), all.end());
+    const uint64_t n = uint64_t(per_producer)*n_producers;
+    return Result{double(n)/t, all[all.size()/2], all[size_t(0.99*(all.size()-1))], sum == n*(n-1)/2};
+}
+
+// print a row of the table, and return whether every message arrived
+bool print(const string& name, int n_producers, int n_consumers, size_t batch_size, const Result& r) {
+    cout << setw(14) << left << name << right << setw(4) << n_producers << setw(4) << n_consumers << setw(7) \
+         << batch_size << fixed << setprecision(2) << setw(14) << 1.0e-6*r.messages_per_second << setw(14) \
+         << r.median_latency_us << setw(14) << r.p99_latency_us << "   " << (r.ok ? "ok" : "LOST MESSAGES") << endl;
+    cout.unsetf(ios::fixed);
+    return r.ok;
+}
+
+int main (int argc, char* argv[]) {
+
+    // a non-zero multiple of 4 x 4 x 64, so that every thread gets whole batches (and records latencies)
+    size_t n_messages = 1 << 20;
+    if (argc > 1) n_messages = max<size_t>(1, (strtoull(argv[1], nullptr, 10) + 1023)/1024)*1024;
+
+    cout << "hardware threads: " << thread::hardware_concurrency() << ", messages: " << n_messages << "\n" << endl;
+    cout << setw(14) << left << "queue" << right << setw(4) << "P" << setw(4) << "C" << setw(7) << "batch" << setw(14) \
+         << "Mmsg/s" << setw(14) << "median (us)" << setw(14) << "p99 (us)" << endl;
+
+    bool all_ok = true;
+    all_ok = print("LockedQueue", 1, 1, 1, run<LockedQueue<Message>>(1, 1, n_messages, 1)) && all_ok;
+    all_ok = print("SpscQueue", 1, 1, 1, run<SpscQueue<Message>>(1, 1, n_messages, 1)) && all_ok;
+    all_ok = print("LockedQueue", 1, 1, 64, run<LockedQueue<Message>>(1, 1, n_messages, 64)) && all_ok;
+    all_ok = print("SpscQueue", 1, 1, 64, run<SpscQueue<Message>>(1, 1, n_messages, 64)) && all_ok;
+    all_ok = print("MpmcQueue", 1, 1, 64, run<MpmcQueue<Message>>(1, 1, n_messages, 64)) && all_ok;
+
+    const int pc[][2] = {{1, 1}, {2, 2}, {4, 4}, {1, 4}, {4, 1}};
+    for (const auto& config: pc) {
+        all_ok = print("LockedQueue", config[0], config[1], 1,
+                       run<LockedQueue<Message>>(config[0], config[1], n_messages, 1)) && all_ok;
+        all_ok = print("MpmcQueue", config[0], config[1], 1,
+                       run<MpmcQueue<Message>>(config[0], config[1], n_messages, 1)) && all_ok; }
+
+    return all_ok ? 0 : 1;
+}
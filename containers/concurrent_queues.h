@@ -0,0 +1,323 @@
+/*
+Bounded lock-free queues for passing work between threads: SpscQueue<T> and MpmcQueue<T>
+
+The Queue of brief_examples/stack_and_queue.cpp and the RingQueue of ring_queue.h may only be used by one thread at a
+time. The usual way to share a queue between threads is to protect a std::queue with a mutex, but then every enqueue
+and dequeue takes the lock, and with several threads the lock (and the cache line it lives in) becomes the bottleneck:
+the threads spend their time waiting for each other, and the lock's cache line bounces between their cores.
+Both queues here are rings of a fixed, power-of-two capacity, like RingQueue, but coordinate the threads with atomic
+operations rather than a lock. They have the same vocabulary as the single-threaded queues:
+    - try_enqueue(x) / try_dequeue(x): return false at once if the queue is full / empty
+    - enqueue(x) / dequeue(): BLOCK until there is room / an element, spinning with a backoff and then yielding the CPU
+    - try_enqueue_bulk(first, count) / try_dequeue_bulk(out, max_count): as many elements as possible of a span, and
+      return how many were transferred
+
+SpscQueue: ONE producer thread and ONE consumer thread. The producer is the only thread that writes the tail index and
+the consumer the only one that writes the head index, so no atomic read-modify-write operations are needed, and
+try_enqueue and try_dequeue complete in a bounded number of steps (they are WAIT-FREE). The remaining cost is that the
+producer must read the consumer's index (and vice versa) to know if the ring is full, and that cache line is being
+written by the other core. So each side keeps a CACHED copy of the other side's index, and only re-reads the real one
+when the cached value says that the ring is full (or empty). Most operations then touch only the thread's own cache
+lines. A batch publishes its new index once for the whole span.
+
+MpmcQueue: any number of producers and consumers, after Dmitry Vyukov's bounded MPMC queue. Each slot has a SEQUENCE
+number, which says whose turn it is to use the slot: a producer that has claimed position pos (with a compare-and-swap
+on the enqueue index) may write the slot when its sequence is pos, and then sets it to pos+1, which tells the consumer
+of position pos that the slot is full. The consumer sets it to pos+capacity when it has taken the element, which tells
+the producer of the next lap round the ring that the slot is free. Producers only contend with producers (on the
+enqueue index) and consumers with consumers, and a slow thread holds up only the slot it is working on. The queue is
+lock-free, but not wait-free: a compare-and-swap may have to be retried when another thread claimed the same position.
+
+The indices are 64-bit counters that are never wrapped (only masked), so they cannot overflow in practice. The indices
+and cached copies that are written by different threads are in separate cache lines (alignas(64)), to avoid FALSE
+SHARING between the producer and consumer.
+
+Requires C++17 (for the alignas(64) members of heap-allocated objects to be respected by new).
+*/
+
+#ifndef CONCURRENT_QUEUES_H
+#define CONCURRENT_QUEUES_H
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <utility>
+#include <stdexcept>
+#include <new>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// spin a few times (with a CPU pause hint), then start yielding the CPU to other threads
+class Backoff {
+    int count = 0;
+
+    public:
+
+    void pause() {
+        if (count < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+            _mm_pause();
+#endif
+            count++;
+        } else {
+            std::this_thread::yield(); }
+    }
+};
+
+inline std::size_t concurrent_queue_capacity(std::size_t min_capacity) {
+    if (min_capacity < 2) throw std::invalid_argument("error in concurrent queue: the capacity must be at least 2");
+    std::size_t cap = 2;
+    while (cap < min_capacity) cap *= 2;
+    return cap;
+}
+
+template <typename T>
+class SpscQueue {
+
+    const std::size_t cap, mask;
+    T* slots; // raw storage for cap elements
+
+    alignas(64) std::atomic<std::size_t> tail{0}; // written by the producer: the next position to enqueue
+    std::size_t cached_head = 0;                   // the producer's copy of head
+    alignas(64) std::atomic<std::size_t> head{0}; // written by the consumer: the next position to dequeue
+    std::size_t cached_tail = 0;                   // the consumer's copy of tail
+
+    // producer: the number of free slots, re-reading head only if the cached copy shows fewer than wanted
+    std::size_t free_slots(std::size_t t, std::size_t wanted) {
+        if (cap - (t - cached_head) < wanted) cached_head = head.load(std::memory_order_acquire);
+        return cap - (t - cached_head);
+    }
+
+    // consumer: the number of full slots, re-reading tail only if the cached copy shows fewer than wanted
+    std::size_t full_slots(std::size_t h, std::size_t wanted) {
+        if (cached_tail - h < wanted) cached_tail = tail.load(std::memory_order_acquire);
+        return cached_tail - h;
+    }
+
+    public:
+
+    explicit SpscQueue(std::size_t min_capacity) :
+        cap(concurrent_queue_capacity(min_capacity)), mask(cap-1),
+        slots(static_cast<T*>(::operator new(cap*sizeof(T), std::align_val_t(alignof(T))))) {}
+
+    ~SpscQueue() {
+        for (std::size_t i=head.load();i!=tail.load();i++) slots[i & mask].~T();
+        ::operator delete(slots, std::align_val_t(alignof(T)));
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    std::size_t capacity() const { return cap; }
+
+    // approximate when called while the other thread is working
+    std::size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+
+    template <typename U>
+    bool try_enqueue(U&& x) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (free_slots(t, 1) == 0) return false;
+        ::new (static_cast<void*>(slots + (t & mask))) T(std::forward<U>(x));
+        tail.store(t+1, std::memory_order_release); // publishes the element to the consumer
+        return true;
+    }
+
+    bool try_dequeue(T& out) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (full_slots(h, 1) == 0) return false;
+        T& slot = slots[h & mask];
+        out = std::move(slot);
+        slot.~T();
+        head.store(h+1, std::memory_order_release); // hands the slot back to the producer
+        return true;
+    }
+
+    template <typename U>
+    void enqueue(U&& x) {
+        Backoff backoff;
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        while (free_slots(t, 1) == 0) backoff.pause();
+        ::new (static_cast<void*>(slots + (t & mask))) T(std::forward<U>(x));
+        tail.store(t+1, std::memory_order_release);
+    }
+
+    T dequeue() {
+        Backoff backoff;
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        while (full_slots(h, 1) == 0) backoff.pause();
+        T& slot = slots[h & mask];
+        T x(std::move(slot));
+        slot.~T();
+        head.store(h+1, std::memory_order_release);
+        return x;
+    }
+
+    // enqueue copies of as many of the count elements at first as there is room for, with ONE update of tail
+    std::size_t try_enqueue_bulk(const T* first, std::size_t count) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        const std::size_t k = std::min(count, free_slots(t, count));
+        for (std::size_t i=0;i<k;i++) ::new (static_cast<void*>(slots + ((t+i) & mask))) T(first[i]);
+        if (k > 0) tail.store(t+k, std::memory_order_release);
+        return k;
+    }
+
+    // dequeue up to max_count elements into out, with ONE update of head
+    std::size_t try_dequeue_bulk(T* out, std::size_t max_count) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        const std::size_t k = std::min(max_count, full_slots(h, max_count));
+        for (std::size_t i=0;i<k;i++) {
+            T& slot = slots[(h+i) & mask];
+            out[i] = std::move(slot);
+            slot.~T(); }
+        if (k > 0) head.store(h+k, std::memory_order_release);
+        return k;
+    }
+
+    // blocking bulk operations: transfer all count elements, waiting for room / elements as needed
+    void enqueue_bulk(const T* first, std::size_t count) {
+        Backoff backoff;
+        while (count > 0) {
+            std::size_t k = try_enqueue_bulk(first, count);
+            if (k == 0) backoff.pause();
+            first += k; count -= k; }
+    }
+
+    void dequeue_bulk(T* out, std::size_t count) {
+        Backoff backoff;
+        while (count > 0) {
+            std::size_t k = try_dequeue_bulk(out, count);
+            if (k == 0) backoff.pause();
+            out += k; count -= k; }
+    }
+};
+
+template <typename T>
+class MpmcQueue {
+
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+        T* element() { return reinterpret_cast<T*>(storage); }
+    };
+
+    const std::size_t cap, mask;
+    std::unique_ptr<Cell[]> cells;
+
+    alignas(64) std::atomic<std::size_t> enqueue_pos{0};
+    alignas(64) std::atomic<std::size_t> dequeue_pos{0};
+
+    // claim the next position to enqueue at, or return nullptr if the queue is full
+    Cell* claim_enqueue(std::size_t& pos) {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell* cell = &cells[pos & mask];
+            const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const std::intptr_t dif = std::intptr_t(seq) - std::intptr_t(pos);
+            if (dif == 0) { // the slot is free for this lap: try to claim the position
+                if (enqueue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) return cell;
+            } else if (dif < 0) { // the slot still holds the element from the previous lap: the queue is full
+                return nullptr;
+            } else { // another producer claimed pos first
+                pos = enqueue_pos.load(std::memory_order_relaxed); } }
+    }
+
+    // claim the next position to dequeue from, or return nullptr if the queue is empty
+    Cell* claim_dequeue(std::size_t& pos) {
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell* cell = &cells[pos & mask];
+            const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const std::intptr_t dif = std::intptr_t(seq) - std::intptr_t(pos+1);
+            if (dif == 0) { // the slot has been filled for this lap
+                if (dequeue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) return cell;
+            } else if (dif < 0) { // not filled yet: the queue is empty
+                return nullptr;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed); } }
+    }
+
+    public:
+
+    explicit MpmcQueue(std::size_t min_capacity) :
+        cap(concurrent_queue_capacity(min_capacity)), mask(cap-1), cells(new Cell[cap]) {
+        for (std::size_t i=0;i<cap;i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~MpmcQueue() {
+        for (std::size_t pos=dequeue_pos.load();pos!=enqueue_pos.load();pos++) cells[pos & mask].element()->~T();
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    std::size_t capacity() const { return cap; }
+
+    template <typename U>
+    bool try_enqueue(U&& x) {
+        std::size_t pos;
+        Cell* cell = claim_enqueue(pos);
+        if (cell == nullptr) return false;
+        ::new (static_cast<void*>(cell->storage)) T(std::forward<U>(x));
+        cell->sequence.store(pos+1, std::memory_order_release); // publishes the element to the consumer of pos
+        return true;
+    }
+
+    bool try_dequeue(T& out) {
+        std::size_t pos;
+        Cell* cell = claim_dequeue(pos);
+        if (cell == nullptr) return false;
+        out = std::move(*cell->element());
+        cell->element()->~T();
+        cell->sequence.store(pos+cap, std::memory_order_release); // frees the slot for the producer of the next lap
+        return true;
+    }
+
+    template <typename U>
+    void enqueue(U&& x) {
+        Backoff backoff;
+        std::size_t pos;
+        Cell* cell;
+        while ((cell = claim_enqueue(pos)) == nullptr) backoff.pause();
+        ::new (static_cast<void*>(cell->storage)) T(std::forward<U>(x));
+        cell->sequence.store(pos+1, std::memory_order_release);
+    }
+
+    T dequeue() {
+        Backoff backoff;
+        std::size_t pos;
+        Cell* cell;
+        while ((cell = claim_dequeue(pos)) == nullptr) backoff.pause();
+        T x(std::move(*cell->element()));
+        cell->element()->~T();
+        cell->sequence.store(pos+cap, std::memory_order_release);
+        return x;
+    }
+
+    /* as many of the count elements at first as there is room for. Other producers may claim positions in between, so
+       (unlike SpscQueue) each element is claimed separately, and the elements of one batch need not be adjacent */
+    std::size_t try_enqueue_bulk(const T* first, std::size_t count) {
+        std::size_t k = 0;
+        while (k < count && try_enqueue(first[k])) k++;
+        return k;
+    }
+
+    std::size_t try_dequeue_bulk(T* out, std::size_t max_count) {
+        std::size_t k = 0;
+        while (k < max_count && try_dequeue(out[k])) k++;
+        return k;
+    }
+
+    void enqueue_bulk(const T* first, std::size_t count) {
+        for (std::size_t i=0;i<count;i++) enqueue(first[i]);
+    }
+
+    void dequeue_bulk(T* out, std::size_t count) {
+        for (std::size_t i=0;i<count;i++) out[i] = dequeue();
+    }
+};
+
+#endif
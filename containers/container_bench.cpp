@@ -0,0 +1,465 @@
+/*
+Benchmark suite of the stack and queue containers of this repository against the standard library
+
+The Stack and Queue of brief_examples/stack_and_queue.cpp are linked lists, and std::stack and std::queue (by default on
+a std::deque) are the obvious alternatives; the containers/ directory adds array-based, unrolled, pooled, persistent and
+concurrent variants. This program measures all of them on the same workloads, with int elements, at sizes n = 10, 100,
+... up to 10^8 (or the maximum size given on the command line):
+    - PUSH:    push n elements into an empty container
+    - ITERATE: walk along the n elements (summing them), for the containers that can be iterated
+    - COPY:    copy-construct a container of n elements, for the containers that can be copied
+    - POP:     pop the n elements, checking that they come out in LIFO (stacks) or FIFO (queues) order
+    - MIXED:   on a container of n elements, alternate random bursts of 1 to 64 pushes with as many pops, for 2n
+               operations in all. A stack only works at its top; a queue cycles through all of its elements
+For every workload we report, per operation (per element for ITERATE and COPY):
+    - the time, in ns
+    - the number of heap allocations (calls to operator new, counted by replacing it: see profiling/alloc_counter.h)
+    - the number of last level cache misses, from the hardware counters via PerfScope (profiling/perf_scope.h), or n/a
+      if the counters are not available (see perf_scope.h)
+and the peak resident set size (RSS) of the process during the workload, in MB, together with its GROWTH over the RSS
+at the start of the workload. The peak includes everything else the process holds at that point: the containers that
+already exist (e.g. during COPY, the original), and memory that is free but not given back to the operating system, such
+as the node pools (the shared pool of CachedPoolAllocator lives until the end of the program). The growth is the memory
+that the workload itself added: for PUSH, the footprint of the containers. The peak is reset before each workload by
+writing 5 to /proc/self/clear_refs (Linux 4.0 and later), and read from VmHWM in /proc/self/status. This and the reading
+of the RSS happen before the clock and the counters start. The memory that malloc keeps for reuse is given back to the
+operating system once per container and size, before its first workload, not before each workload: that would make
+every PUSH pay for page faults on fresh memory, which is not what the containers cost in a running program.
+Small sizes are measured on up to 1000 containers at once, and the whole cycle is repeated, so that each measurement
+covers about a million operations.
+
+The containers:
+    stacks (LIFO)
+    - LinkedStack: the Stack of stack_and_queue.cpp (push and pop at the head of a singly linked list), with its nodes
+      from std::allocator (new/delete), a PoolAllocator (a NodePool per list) and a CachedPoolAllocator (a shared pool
+      with per-thread caches), see node_pool.h
+    - std::stack on a std::deque (the default) and on a std::vector
+    - ArrayStack (array_stack.h)
+    - UnrolledList (unrolled_list.h), pushing and popping at the back
+    - PersistentStack (persistent_stack.h), where each push and pop makes a new version. A copy shares all of the
+      nodes, so COPY costs O(1) however large the stack
+    - WorkStealingDeque (work_stealing_deque.h), used by its owner only (push and pop at the bottom)
+    queues (FIFO)
+    - LinkedQueue: the Queue of stack_and_queue.cpp (enqueue at the tail, dequeue at the head), with the same three
+      allocators
+    - std::queue on a std::deque (the default) and on a std::list
+    - RingQueue (ring_queue.h)
+    - UnrolledList, pushing at the back and popping at the front
+    - SpscQueue and MpmcQueue (concurrent_queues.h), used by a single thread, to show the cost of their atomic
+      operations when there is no contention. They are bounded, and are created with room for the largest occupancy
+The two linked containers are minimal copies of those of stack_and_queue.cpp (which is a program of its own, with a
+main function), with the same node layout and the same allocator parameter.
+
+At n = 10^8, the linked containers need 3 GB or more (and twice as much during COPY): pass a smaller maximum size on the
+command line on machines with less memory.
+
+Compile with:
+g++ -std=c++17 -O2 -o container_bench container_bench.cpp -pthread
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <stack>
+#include <queue>
+#include <memory>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include "../profiling/alloc_counter.h"
+#include "../profiling/perf_scope.h"
+#include "array_stack.h"
+#include "ring_queue.h"
+#include "node_pool.h"
+#include "unrolled_list.h"
+#include "persistent_stack.h"
+#include "work_stealing_deque.h"
+#include "concurrent_queues.h"
+
+using namespace std;
+
+/* memory freed by the containers measured earlier is kept by malloc for reuse, and would still count in the RSS: ask
+   malloc (glibc's) to give it back to the operating system */
+void trim_heap() {
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+}
+
+// reset the peak RSS of the process to its current RSS. Returns false if the kernel does not support it
+bool reset_peak_rss() {
+    ofstream f("/proc/self/clear_refs");
+    f << "5";
+    f.close();
+    return bool(f);
+}
+
+// a field of /proc/self/status, in MB (0 if unknown): VmHWM is the peak RSS since the last reset, VmRSS the current RSS
+double status_mb(const char* field) {
+    ifstream f("/proc/self/status");
+    const size_t length = strlen(field);
+    string line;
+    while (getline(f, line)) {
+        if (line.compare(0, length, field) == 0 && line.size() > length && line[length] == ':') {
+            istringstream fields(line.substr(length+1));
+            double kb = 0;
+            fields >> kb;
+            return kb/1024.0; } }
+    return 0;
+}
+
+enum Workload { push_workload, iterate_workload, copy_workload, pop_workload, mixed_workload, n_workloads };
+const char* workload_names[n_workloads] = {"PUSH", "ITERATE", "COPY", "POP", "MIXED"};
+
+// the totals of a workload, over all the containers and repetitions
+struct Measurement {
+    bool done = false;
+    double seconds = 0, ops = 0, allocations = 0, llc_misses = 0, peak_rss = 0, rss_growth = 0;
+    bool llc_valid = false;
+};
+
+// resets the peak RSS, and returns the current RSS
+double start_rss() {
+    reset_peak_rss();
+    return status_mb("VmRSS");
+}
+
+/* measures one timed region, from its construction to stop(). The members are initialized in the order of their
+   declarations, so the clock and the counters of perf start last, after the work on the RSS */
+class Meter {
+    double rss_before;
+    size_t allocations_before;
+    PerfScope perf;
+
+    public:
+
+    Meter() : rss_before(start_rss()), allocations_before(n_allocations), perf("", 0, false) {}
+
+    void stop(Measurement& m, double ops) {
+        const PerfCounts& counts = perf.stop();
+        m.done = true;
+        m.seconds += counts.seconds;
+        m.ops += ops;
+        m.allocations += double(n_allocations - allocations_before);
+        if (counts.valid[perf_llc_misses]) {
+            m.llc_valid = true;
+            m.llc_misses += counts.value[perf_llc_misses]; }
+        const double peak = status_mb("VmHWM");
+        m.peak_rss = max(m.peak_rss, peak);
+        m.rss_growth = max(m.rss_growth, peak - rss_before);
+    }
+};
+
+// ----- minimal copies of the List, Stack and Queue of brief_examples/stack_and_queue.cpp -----
+
+template <typename T>
+struct Node {
+    T data;
+    Node *next_node;
+};
+
+template <typename T, typename Alloc = allocator<Node<T>>>
+class LinkedList {
+
+    typedef allocator_traits<Alloc> alloc_traits;
+
+    Alloc alloc;
+
+    Node<T>* newnode(const T& x, Node<T>* next) {
+        Node<T>* node = alloc_traits::allocate(alloc, 1);
+        alloc_traits::construct(alloc, node, Node<T>{x, next});
+        return node;
+    }
+
+    public:
+
+    Node<T> *head = nullptr, *tail = nullptr;
+
+    LinkedList() {}
+    LinkedList(const LinkedList& rhs) : alloc(rhs.alloc) {
+        for (Node<T>* node = rhs.head; node != nullptr; node = node->next_node) insertnode(node->data); }
+    LinkedList& operator=(const LinkedList&) = delete;
+    ~LinkedList() { while (head != nullptr) removenode_athead(); }
+
+    void insertnode(const T& x) {
+        Node<T>* node = newnode(x, nullptr);
+        if (tail) { tail->next_node = node; } else { head = node; }
+        tail = node;
+    }
+
+    void insertnode_athead(const T& x) {
+        head = newnode(x, head);
+        if (tail == nullptr) tail = head;
+    }
+
+    T removenode_athead() {
+        Node<T>* node = head;
+        head = head->next_node;
+        if (head == nullptr) tail = nullptr;
+        T x = node->data;
+        alloc_traits::destroy(alloc, node);
+        alloc_traits::deallocate(alloc, node, 1);
+        return x;
+    }
+
+    long long sum() const {
+        long long s = 0;
+        for (Node<T>* node = head; node != nullptr; node = node->next_node) s += node->data;
+        return s;
+    }
+};
+
+// ----- the adapters: every container behind push(x), pop(), and if possible sum() (iteration) and copying -----
+
+template <typename Alloc>
+struct LinkedStack {
+    static constexpr bool lifo = true, iterable = true, copyable = true;
+    LinkedList<int, Alloc> c;
+    explicit LinkedStack(size_t) {}
+    void push(int x) { c.insertnode_athead(x); }
+    int pop() { return c.removenode_athead(); }
+    long long sum() const { return c.sum(); }
+};
+
+template <typename Alloc>
+struct LinkedQueue {
+    static constexpr bool lifo = false, iterable = true, copyable = true;
+    LinkedList<int, Alloc> c;
+    explicit LinkedQueue(size_t) {}
+    void push(int x) { c.insertnode(x); }
+    int pop() { return c.removenode_athead(); }
+    long long sum() const { return c.sum(); }
+};
+
+// std::stack and std::queue hide their underlying container in a protected member c: expose it, to iterate over it
+template <typename Container>
+struct StdStack : stack<int, Container> {
+    static constexpr bool lifo = true, iterable = true, copyable = true;
+    explicit StdStack(size_t) {}
+    int pop() { int x = this->top(); stack<int, Container>::pop(); return x; }
+    long long sum() const { long long s = 0; for (int x: this->c) s += x; return s; }
+};
+
+template <typename Container>
+struct StdQueue : queue<int, Container> {
+    static constexpr bool lifo = false, iterable = true, copyable = true;
+    explicit StdQueue(size_t) {}
+    int pop() { int x = this->front(); queue<int, Container>::pop(); return x; }
+    long long sum() const { long long s = 0; for (int x: this->c) s += x; return s; }
+};
+
+struct ArrayStackAdapter {
+    static constexpr bool lifo = true, iterable = false, copyable = true;
+    ArrayStack<int> c;
+    explicit ArrayStackAdapter(size_t) {}
+    void push(int x) { c.push(x); }
+    int pop() { return c.pop(); }
+    long long sum() const { return 0; }
+};
+
+struct RingQueueAdapter {
+    static constexpr bool lifo = false, iterable = false, copyable = true;
+    RingQueue<int> c;
+    explicit RingQueueAdapter(size_t) {}
+    void push(int x) { c.enqueue(x); }
+    int pop() { return c.dequeue(); }
+    long long sum() const { return 0; }
+};
+
+template <bool Lifo>
+struct UnrolledAdapter {
+    static constexpr bool lifo = Lifo, iterable = true, copyable = true;
+    UnrolledList<int> c;
+    explicit UnrolledAdapter(size_t) {}
+    void push(int x) { c.push_back(x); }
+    int pop() { return Lifo ? c.pop_back() : c.pop_front(); }
+    long long sum() const { long long s = 0; for (int x: c) s += x; return s; }
+};
+
+struct PersistentStackAdapter {
+    static constexpr bool lifo = true, iterable = true, copyable = true;
+    PersistentStack<int> c;
+    explicit PersistentStackAdapter(size_t) {}
+    void push(int x) { c = c.push(x); }
+    int pop() { int x = c.top(); c = c.pop(); return x; }
+    long long sum() const { long long s = 0; for (int x: c) s += x; return s; }
+};
+
+// the operations of the next two can fail (pop on an empty container, push on a full bounded queue): they count failures
+struct WorkStealingAdapter {
+    static constexpr bool lifo = true, iterable = false, copyable = false;
+    WorkStealingDeque<int> c;
+    long long failures = 0;
+    explicit WorkStealingAdapter(size_t) {}
+    void push(int x) { c.push(x); }
+    int pop() { int x = 0; if (!c.pop(x)) failures++; return x; }
+    long long sum() const { return 0; }
+};
+
+template <typename Queue>
+struct ConcurrentQueueAdapter {
+    static constexpr bool lifo = false, iterable = false, copyable = false;
+    Queue c;
+    long long failures = 0;
+    explicit ConcurrentQueueAdapter(size_t capacity) : c(capacity) {}
+    void push(int x) { if (!c.try_enqueue(x)) failures++; }
+    int pop() { int x = 0; if (!c.try_dequeue(x)) failures++; return x; }
+    long long sum() const { return 0; }
+};
+
+// the failed operations of a container that counts them, 0 for the others (whose operations cannot fail)
+template <typename A>
+auto failures(const A& c, int) -> decltype(c.failures) { return c.failures; }
+template <typename A>
+long long failures(const A&, long) { return 0; }
+
+// ----- the workloads -----
+
+struct Result {
+    string name;
+    Measurement m[n_workloads];
+    long long mixed_sum = 0; // of the elements popped in MIXED: the same for all the stacks, and for all the queues
+    long long errors = 0;    // elements out of order, wrong sums in ITERATE, and failed pushes and pops
+};
+
+// a small, fast random number generator for the burst lengths of MIXED
+struct XorShift {
+    unsigned x = 2463534242u;
+    unsigned next() { x ^= x << 13; x ^= x >> 17; x ^= x << 5; return x; }
+};
+
+template <typename A>
+Result run(const char* name, size_t n) {
+    Result r;
+    r.name = name;
+    const size_t n_containers = max<size_t>(1, min<size_t>(1000, 1000000/n));
+    const size_t n_rounds = max<size_t>(1, 1000000/(n*n_containers));
+    trim_heap();
+    for (size_t round=0;round<n_rounds;round++) {
+        vector<unique_ptr<A>> containers;
+        for (size_t k=0;k<n_containers;k++) containers.emplace_back(new A(n+64)); // room for MIXED's bursts
+
+        {
+        Meter meter;
+        for (auto& c: containers) {
+            for (size_t i=0;i<n;i++) c->push(int(i)); }
+        meter.stop(r.m[push_workload], double(n*n_containers));
+        }
+
+        if constexpr (A::iterable) {
+            long long s = 0;
+            Meter meter;
+            for (auto& c: containers) s += c->sum();
+            meter.stop(r.m[iterate_workload], double(n*n_containers));
+            r.errors += s != (long long)(n_containers)*(long long)(n)*(long long)(n-1)/2; }
+
+        if constexpr (A::copyable) {
+            vector<unique_ptr<A>> copies;
+            copies.reserve(n_containers);
+            {
+            Meter meter;
+            for (auto& c: containers) copies.emplace_back(new A(*c));
+            meter.stop(r.m[copy_workload], double(n*n_containers));
+            }
+            for (auto& c: copies) r.errors += c->pop() != (A::lifo ? int(n-1) : 0); }
+
+        {
+        Meter meter;
+        for (auto& c: containers) {
+            for (size_t i=0;i<n;i++) {
+                const int x = c->pop();
+                r.errors += x != int(A::lifo ? n-1-i : i); } }
+        meter.stop(r.m[pop_workload], double(n*n_containers));
+        }
+
+        for (auto& c: containers) {
+            for (size_t i=0;i<n;i++) c->push(int(i)); }
+        {
+        XorShift rng;
+        size_t ops = 0;
+        long long s = 0;
+        int next_value = int(n);
+        Meter meter;
+        for (auto& c: containers) {
+            for (size_t done=0;done<2*n;) {
+                const size_t burst = 1 + rng.next() % 64;
+                for (size_t b=0;b<burst;b++) c->push(next_value++);
+                for (size_t b=0;b<burst;b++) s += c->pop();
+                done += 2*burst; ops += 2*burst; } }
+        meter.stop(r.m[mixed_workload], double(ops));
+        r.mixed_sum += s;
+        }
+
+        for (auto& c: containers) r.errors += failures(*c, 0);
+    }
+    return r;
+}
+
+void print_results(const vector<Result>& results, size_t n) {
+    cout << "\n================ n = " << n << " ================" << endl;
+    for (int w=0;w<n_workloads;w++) {
+        cout << "\n" << workload_names[w] << setw(30-int(string(workload_names[w]).size())) << "" << setw(10) << "ns/op" \
+             << setw(12) << "allocs/op" << setw(14) << "LLC miss/op" << setw(16) << "peak RSS (MB)" << setw(12) << "growth" \
+             << endl;
+        for (const Result& r: results) {
+            const Measurement& m = r.m[w];
+            cout << "  " << left << setw(28) << r.name << right;
+            if (!m.done) {
+                cout << setw(10) << "-" << endl;
+                continue; }
+            cout << fixed << setprecision(2) << setw(10) << 1.0e9*m.seconds/m.ops << setprecision(4) << setw(12) \
+                 << m.allocations/m.ops;
+            if (m.llc_valid) { cout << setw(14) << m.llc_misses/m.ops; } else { cout << setw(14) << "n/a"; }
+            cout << setprecision(1) << setw(16) << m.peak_rss << setw(12) << m.rss_growth << endl;
+            cout.unsetf(ios::fixed); } }
+}
+
+int main (int argc, char *argv[]) {
+
+    size_t max_size = 100000000;
+    if (argc > 1) max_size = strtoull(argv[1], nullptr, 10);
+    trim_heap();
+    if (!reset_peak_rss()) cout << "(the peak RSS cannot be reset on this system: it is the peak since the start)" << endl;
+
+    bool all_ok = true;
+    for (size_t n=10;n<=max_size;n*=10) {
+        vector<Result> stacks, queues;
+        stacks.push_back(run<LinkedStack<allocator<Node<int>>>>("LinkedStack (new/delete)", n));
+        stacks.push_back(run<LinkedStack<PoolAllocator<Node<int>>>>("LinkedStack (PoolAllocator)", n));
+        stacks.push_back(run<LinkedStack<CachedPoolAllocator<Node<int>>>>("LinkedStack (CachedPool)", n));
+        stacks.push_back(run<StdStack<deque<int>>>("std::stack (deque)", n));
+        stacks.push_back(run<StdStack<vector<int>>>("std::stack (vector)", n));
+        stacks.push_back(run<ArrayStackAdapter>("ArrayStack", n));
+        stacks.push_back(run<UnrolledAdapter<true>>("UnrolledList (back)", n));
+        stacks.push_back(run<PersistentStackAdapter>("PersistentStack", n));
+        stacks.push_back(run<WorkStealingAdapter>("WorkStealingDeque (owner)", n));
+        queues.push_back(run<LinkedQueue<allocator<Node<int>>>>("LinkedQueue (new/delete)", n));
+        queues.push_back(run<LinkedQueue<PoolAllocator<Node<int>>>>("LinkedQueue (PoolAllocator)", n));
+        queues.push_back(run<LinkedQueue<CachedPoolAllocator<Node<int>>>>("LinkedQueue (CachedPool)", n));
+        queues.push_back(run<StdQueue<deque<int>>>("std::queue (deque)", n));
+        queues.push_back(run<StdQueue<list<int>>>("std::queue (list)", n));
+        queues.push_back(run<RingQueueAdapter>("RingQueue", n));
+        queues.push_back(run<UnrolledAdapter<false>>("UnrolledList (back/front)", n));
+        queues.push_back(run<ConcurrentQueueAdapter<SpscQueue<int>>>("SpscQueue (1 thread)", n));
+        queues.push_back(run<ConcurrentQueueAdapter<MpmcQueue<int>>>("MpmcQueue (1 thread)", n));
+
+        for (vector<Result>* group: {&stacks, &queues}) {
+            for (const Result& r: *group) {
+                if (r.errors != 0 || r.mixed_sum != group->front().mixed_sum) {
+                    cout << "error: " << r.name << " returned wrong elements" << endl;
+                    all_ok = false; } } }
+
+        vector<Result> all(stacks);
+        all.insert(all.end(), queues.begin(), queues.end());
+        print_results(all, n); }
+
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+/*
+DenseMatrix (dense_matrix.h) against the array of row pointers of random_examples/2darr_member.cpp
+
+    1. ALLOCATION: create, fill and destroy many small (8 x 8) matrices. The array of row pointers needs m+1 allocations
+       per matrix, a DenseMatrix one
+    2. TRAVERSAL: sum the elements of an n x n matrix of doubles row by row and column by column, for the array of row
+       pointers, a row-major and a column-major DenseMatrix. Walking a matrix along its lines (the rows of a row-major
+       matrix) reads memory sequentially, and the loop vectorizes; walking across them reads one element per cache line
+    3. LEADING DIMENSION: sum a row-major n x n matrix column by column, with ld = n (a power of two) and ld = n + 8.
+       Summing column j reads one cache line per row, and column j+1 reuses the same lines, if they are still in the
+       cache: n lines of 64 bytes fit in the L2 cache, but when they are ld*8 = 2^k bytes apart they all map to the same
+       few cache sets, which only hold a few lines each
+    4. LAYOUT CONVERSION: copy a row-major matrix into a column-major one (a transposition), element by element in the
+       order of the destination, and with copy(), which works in 32 x 32 tiles
+All the sums and copies are checked.
+
+Compile with:
+g++ -std=c++17 -O2 -march=native -o dense_matrices dense_matrices.cpp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstddef>
+#include "dense_matrix.h"
+
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point t_start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+// the matrix of 2darr_member.cpp: an array of pointers to separately allocated rows
+template <typename T>
+class RowPointerMatrix {
+    T** rows;
+    size_t m, n;
+    public:
+    RowPointerMatrix(size_t m, size_t n) : m(m), n(n) {
+        rows = new T*[m];
+        for (size_t i=0;i<m;i++) rows[i] = new T[n](); }
+    ~RowPointerMatrix() {
+        for (size_t i=0;i<m;i++) delete [] rows[i];
+        delete [] rows; }
+    RowPointerMatrix(const RowPointerMatrix&) = delete;
+    RowPointerMatrix& operator=(const RowPointerMatrix&) = delete;
+    T& operator()(size_t i, size_t j) { return rows[i][j]; }
+    const T& operator()(size_t i, size_t j) const { return rows[i][j]; }
+};
+
+// small integers, so that the sums are exact in any order
+double value(size_t i, size_t j) { return double((3*i + j) % 7); }
+
+template <typename M>
+void fill(M& a, size_t n) {
+    for (size_t i=0;i<n;i++) {
+        for (size_t j=0;j<n;j++) a(i, j) = value(i, j); }
+}
+
+template <typename M>
+double sum_by_rows(const M& a, size_t n) {
+    double s = 0.;
+    for (size_t i=0;i<n;i++) {
+        for (size_t j=0;j<n;j++) s += a(i, j); }
+    return s;
+}
+
+template <typename M>
+double sum_by_cols(const M& a, size_t n) {
+    double s = 0.;
+    for (size_t j=0;j<n;j++) {
+        for (size_t i=0;i<n;i++) s += a(i, j); }
+    return s;
+}
+
+int main () {
+
+    bool all_ok = true;
+
+    // 1. allocation
+    {
+    const size_t n_matrices = 200000, m = 8;
+    long check_rows = 0, check_dense = 0;
+    auto t_start = chrono::steady_clock::now();
+    for (size_t k=0;k<n_matrices;k++) {
+        RowPointerMatrix<int> a(m, m);
+        for (size_t i=0;i<m;i++) {
+            for (size_t j=0;j<m;j++) a(i, j) = int(j + i*m); }
+        check_rows += a(k % m, (k/m) % m); }
+    const double t_rows = seconds_since(t_start);
+    t_start = chrono::steady_clock::now();
+    for (size_t k=0;k<n_matrices;k++) {
+        DenseMatrix<int> a(m, m);
+        for (size_t i=0;i<m;i++) {
+            for (size_t j=0;j<m;j++) a(i, j) = int(j + i*m); }
+        check_dense += a(k % m, (k/m) % m); }
+    const double t_dense = seconds_since(t_start);
+    all_ok = all_ok && check_rows == check_dense;
+    cout << "ALLOCATION: " << n_matrices << " matrices of " << m << " x " << m << " ints (ns per matrix)" << endl;
+    cout << fixed << setprecision(1) << setw(24) << "row pointers" << setw(10) << 1.0e9*t_rows/n_matrices \
+         << "   (" << m + 1 << " allocations each)" << endl;
+    cout << setw(24) << "DenseMatrix" << setw(10) << 1.0e9*t_dense/n_matrices << "   (1 allocation each)" << endl;
+    cout.unsetf(ios::fixed);
+    }
+
+    // 2. traversal
+    cout << "\nTRAVERSAL: sum of an n x n matrix of doubles (ns per element)" << endl;
+    cout << setw(8) << "n" << setw(24) << "" << setw(12) << "by rows" << setw(12) << "by cols" << endl;
+    for (size_t n: {256, 1024, 4096}) {
+        RowPointerMatrix<double> a(n, n);
+        DenseMatrix<double, Layout::RowMajor> b(n, n);
+        DenseMatrix<double, Layout::ColMajor> c(n, n);
+        fill(a, n);
+        fill(b, n);
+        fill(c, n);
+        const double expected = sum_by_rows(a, n);
+        const double scale = 1.0e9/double(n*n);
+        auto measure = [&](const char* name, auto& matrix) {
+            auto t_start = chrono::steady_clock::now();
+            const double s_rows = sum_by_rows(matrix, n);
+            const double t_rows = seconds_since(t_start);
+            t_start = chrono::steady_clock::now();
+            const double s_cols = sum_by_cols(matrix, n);
+            const double t_cols = seconds_since(t_start);
+            const bool ok = s_rows == expected && s_cols == expected;
+            all_ok = all_ok && ok;
+            cout << setw(8) << n << setw(24) << name << fixed << setprecision(2) << setw(12) << t_rows*scale \
+                 << setw(12) << t_cols*scale << (ok ? "" : "   WRONG SUM") << endl;
+            cout.unsetf(ios::fixed); };
+        measure("row pointers", a);
+        measure("DenseMatrix row-major", b);
+        measure("DenseMatrix col-major", c); }
+
+    // 3. leading dimension
+    cout << "\nLEADING DIMENSION: column by column sum of a row-major n x n matrix of doubles (ns per element)" << endl;
+    cout << setw(8) << "n" << setw(14) << "ld = n" << setw(14) << "ld = n + 8" << endl;
+    for (size_t n: {512, 1024, 2048, 4096}) {
+        DenseMatrix<double> a(n, n, n), b(n, n, n + 8);
+        fill(a, n);
+        fill(b, n);
+        const double scale = 1.0e9/double(n*n);
+        auto t_start = chrono::steady_clock::now();
+        const double s_a = sum_by_cols(a, n);
+        const double t_a = seconds_since(t_start);
+        t_start = chrono::steady_clock::now();
+        const double s_b = sum_by_cols(b, n);
+        const double t_b = seconds_since(t_start);
+        const bool ok = s_a == s_b && s_a == sum_by_rows(a, n);
+        all_ok = all_ok && ok;
+        cout << setw(8) << n << fixed << setprecision(2) << setw(14) << t_a*scale << setw(14) << t_b*scale \
+             << (ok ? "" : "   WRONG SUM") << endl;
+        cout.unsetf(ios::fixed); }
+
+    // 4. layout conversion
+    cout << "\nLAYOUT CONVERSION: row-major to column-major copy of an n x n matrix of doubles (ns per element)" << endl;
+    cout << setw(8) << "n" << setw(18) << "element loop" << setw(18) << "tiled copy()" << endl;
+    for (size_t n: {1000, 4096}) {
+        DenseMatrix<double> a(n, n);
+        fill(a, n);
+        DenseMatrix<double, Layout::ColMajor> b(n, n);
+        const double scale = 1.0e9/double(n*n);
+        auto t_start = chrono::steady_clock::now();
+        for (size_t j=0;j<n;j++) {
+            for (size_t i=0;i<n;i++) b(i, j) = a(i, j); }
+        const double t_loop = seconds_since(t_start);
+        b.fill(0.);
+        t_start = chrono::steady_clock::now();
+        copy(a.view(), b.view());
+        const double t_copy = seconds_since(t_start);
+        bool ok = sum_by_cols(b, n) == sum_by_rows(a, n);
+        for (size_t i=0;i<n && ok;i+=7) {
+            for (size_t j=0;j<n && ok;j+=3) ok = b(i, j) == value(i, j); }
+        // and back, through the converting constructor, and a block of it
+        const DenseMatrix<double> c(b);
+        ok = ok && c == a;
+        const DenseMatrix<double> d(a.block(n/4, n/3, n/2, n/5));
+        ok = ok && d.rows() == n/2 && d.cols() == n/5 && d(1, 2) == value(n/4 + 1, n/3 + 2);
+        all_ok = all_ok && ok;
+        cout << setw(8) << n << fixed << setprecision(2) << setw(18) << t_loop*scale << setw(18) << t_copy*scale \
+             << (ok ? "" : "   WRONG COPY") << endl;
+        cout.unsetf(ios::fixed); }
+
+    cout << "\nresults " << (all_ok ? "correct" : "WRONG") << endl;
+    return all_ok ? 0 : 1;
+}
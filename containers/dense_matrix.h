@@ -0,0 +1,323 @@
+/*
+DenseMatrix<T, Layout>: a matrix in ONE contiguous, aligned allocation, with an explicit leading dimension
+
+The Matrice of random_examples/2darr_member.cpp (and the "non-contiguous 2D array" of brief_examples/copy_2dpointer.cpp)
+is an array of m pointers to m separately allocated rows. That costs m+1 allocations (and m+1 deletes, which are easy to
+get wrong), an extra pointer per row, and two dependent loads per element (first the row pointer, then the element).
+The rows are wherever the allocator put them, so the matrix cannot be copied with one memcpy or handed to a numeric
+library, and walking from the end of one row to the start of the next is a jump the hardware prefetcher cannot follow.
+A DenseMatrix stores all the elements in a single block. In ROW-MAJOR layout (the layout of the built-in T[m][n])
+element (i,j) is at data()[i*ld + j]; in COLUMN-MAJOR layout (Fortran's, BLAS's and LAPACK's) it is at data()[i + j*ld].
+The LEADING DIMENSION ld is the distance between the starts of two consecutive rows (row-major) or columns (col-major),
+at least the length of a row (or column). By default it is rounded up so that every row (column) starts on a 64-byte
+boundary, i.e. on a cache line and at the alignment of AVX-512 loads; the padding elements at the end of each row
+(column) are value-initialized, and never read or written by the matrix's own operations. A leading dimension can also
+be given explicitly: when it is a large power of two, the elements of a column of a row-major matrix (which are ld
+elements apart) all fall into the same few sets of the cache, and walking down a column then misses the cache every
+time even for a small matrix; a slightly larger ld (e.g. 2056 instead of 2048 doubles) spreads them out again
+(dense_matrices.cpp measures it).
+A MatrixView is a non-owning (pointer, rows, cols, ld) reference to a matrix or to a BLOCK of one: a block has the same
+leading dimension as its matrix, so it needs no copy, which is how the blocked algorithms (and the BLAS, with its lda)
+work on submatrices. For raw access, row(i) and col(j) are StridedSpans of the elements of a row and of a column, and
+line(k) is the k-th row (row-major) or column (column-major) as a contiguous Span, which is what the compiler
+vectorizes; storage() spans all the elements, padding included.
+copy() copies between views of any layouts; between layouts it is a transposition, done in square tiles so that both
+the reads and the writes stay within a few cache lines at a time.
+
+Requires C++17 (for the aligned allocation).
+*/
+
+#ifndef DENSE_MATRIX_H
+#define DENSE_MATRIX_H
+
+#include <new>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <cstddef>
+
+enum class Layout { RowMajor, ColMajor };
+
+// the offset of element (i,j) from the start of a matrix of leading dimension ld
+template <Layout L>
+inline std::size_t element_offset(std::size_t i, std::size_t j, std::size_t ld) {
+    return L == Layout::RowMajor ? i*ld + j : i + j*ld;
+}
+
+// a contiguous range of elements
+template <typename T>
+class Span {
+
+    T* ptr;
+    std::size_t n;
+
+    public:
+
+    Span(T* ptr, std::size_t n) : ptr(ptr), n(n) {}
+
+    T* data() const { return ptr; }
+    std::size_t size() const { return n; }
+    T& operator[](std::size_t i) const { return ptr[i]; }
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + n; }
+};
+
+// a range of elements at a constant distance (stride) from each other, e.g. a column of a row-major matrix
+template <typename T>
+class StridedSpan {
+
+    T* ptr;
+    std::size_t n, step;
+
+    public:
+
+    class iterator {
+        T* p;
+        std::size_t step;
+        public:
+        iterator(T* p, std::size_t step) : p(p), step(step) {}
+        T& operator*() const { return *p; }
+        iterator& operator++() { p += step; return *this; }
+        bool operator==(const iterator& rhs) const { return p == rhs.p; }
+        bool operator!=(const iterator& rhs) const { return p != rhs.p; }
+    };
+
+    StridedSpan(T* ptr, std::size_t n, std::size_t step) : ptr(ptr), n(n), step(step) {}
+
+    T* data() const { return ptr; }
+    std::size_t size() const { return n; }
+    std::size_t stride() const { return step; }
+    T& operator[](std::size_t i) const { return ptr[i*step]; }
+    iterator begin() const { return iterator(ptr, step); }
+    iterator end() const { return iterator(ptr + n*step, step); }
+};
+
+// a non-owning reference to a matrix, or to a block of one (T is const for a read-only view)
+template <typename T, Layout L = Layout::RowMajor>
+class MatrixView {
+
+    T* ptr;
+    std::size_t n_rows, n_cols, ld;
+
+    public:
+
+    static constexpr Layout layout = L;
+
+    MatrixView(T* ptr, std::size_t n_rows, std::size_t n_cols, std::size_t ld) :
+        ptr(ptr), n_rows(n_rows), n_cols(n_cols), ld(ld) {}
+
+    // a read-only view of the same elements
+    operator MatrixView<const T, L>() const { return MatrixView<const T, L>(ptr, n_rows, n_cols, ld); }
+
+    std::size_t rows() const { return n_rows; }
+    std::size_t cols() const { return n_cols; }
+    std::size_t leading_dimension() const { return ld; }
+    T* data() const { return ptr; }
+
+    T& operator()(std::size_t i, std::size_t j) const { return ptr[element_offset<L>(i, j, ld)]; }
+
+    // the number of contiguous lines (rows in row-major layout, columns in column-major layout), and the k-th one
+    std::size_t lines() const { return L == Layout::RowMajor ? n_rows : n_cols; }
+    Span<T> line(std::size_t k) const { return Span<T>(ptr + k*ld, L == Layout::RowMajor ? n_cols : n_rows); }
+
+    StridedSpan<T> row(std::size_t i) const {
+        return StridedSpan<T>(ptr + element_offset<L>(i, 0, ld), n_cols, L == Layout::RowMajor ? 1 : ld);
+    }
+
+    StridedSpan<T> col(std::size_t j) const {
+        return StridedSpan<T>(ptr + element_offset<L>(0, j, ld), n_rows, L == Layout::RowMajor ? ld : 1);
+    }
+
+    // the block of n_block_rows x n_block_cols elements whose top left element is (i,j)
+    MatrixView block(std::size_t i, std::size_t j, std::size_t n_block_rows, std::size_t n_block_cols) const {
+        if (i + n_block_rows > n_rows || j + n_block_cols > n_cols)
+            throw std::runtime_error("error in MatrixView::block(): the block is not inside the matrix");
+        return MatrixView(ptr + element_offset<L>(i, j, ld), n_block_rows, n_block_cols, ld);
+    }
+};
+
+// copy the elements of src into dst (of the same size), converting the layout if necessary
+template <typename T1, Layout L1, typename T2, Layout L2>
+void copy(MatrixView<T1, L1> src, MatrixView<T2, L2> dst) {
+    if (src.rows() != dst.rows() || src.cols() != dst.cols())
+        throw std::runtime_error("error in copy(): the matrices have different sizes");
+    if (L1 == L2) {
+        for (std::size_t k=0;k<src.lines();k++) {
+            const Span<T1> line = src.line(k);
+            std::copy(line.begin(), line.end(), dst.line(k).begin()); }
+        return; }
+    // a transposition: in tiles, so that the lines read and the lines written all stay in the cache, and within a
+    // tile along the lines of dst, so that the writes are sequential
+    const std::size_t tile = 32;
+    for (std::size_t i0=0;i0<src.rows();i0+=tile) {
+        const std::size_t i1 = std::min(i0 + tile, src.rows());
+        for (std::size_t j0=0;j0<src.cols();j0+=tile) {
+            const std::size_t j1 = std::min(j0 + tile, src.cols());
+            if (L2 == Layout::RowMajor) {
+                for (std::size_t i=i0;i<i1;i++) {
+                    for (std::size_t j=j0;j<j1;j++) dst(i, j) = src(i, j); }
+            } else {
+                for (std::size_t j=j0;j<j1;j++) {
+                    for (std::size_t i=i0;i<i1;i++) dst(i, j) = src(i, j); } } } }
+}
+
+template <typename T, Layout L = Layout::RowMajor, std::size_t Alignment = 64>
+class DenseMatrix {
+
+    static_assert(Alignment > 0 && (Alignment & (Alignment - 1)) == 0, "error in DenseMatrix: the alignment must be a power of 2");
+
+    T* ptr = nullptr;
+    std::size_t n_rows = 0, n_cols = 0, ld = 0;
+
+    // the length of a line (row in row-major layout, column in column-major layout)
+    static std::size_t line_length(std::size_t n_rows, std::size_t n_cols) {
+        return L == Layout::RowMajor ? n_cols : n_rows;
+    }
+
+    // the default leading dimension: the line length, rounded up so that every line starts on an aligned address
+    static std::size_t padded(std::size_t length) {
+        const std::size_t k = Alignment % sizeof(T) == 0 ? Alignment/sizeof(T) : 1;
+        return (length + k - 1)/k*k;
+    }
+
+    std::size_t storage_size() const { return (L == Layout::RowMajor ? n_rows : n_cols)*ld; }
+
+    void allocate(std::size_t rows, std::size_t cols, std::size_t leading_dimension) {
+        if (leading_dimension < line_length(rows, cols))
+            throw std::runtime_error("error in DenseMatrix(): the leading dimension is smaller than a line");
+        const std::size_t n_lines = L == Layout::RowMajor ? rows : cols;
+        if (leading_dimension > 0 && n_lines > std::numeric_limits<std::size_t>::max()/sizeof(T)/leading_dimension)
+            throw std::runtime_error("error in DenseMatrix(): the matrix is too large");
+        n_rows = rows;
+        n_cols = cols;
+        ld = leading_dimension;
+        const std::size_t n = storage_size();
+        if (n == 0) return;
+        ptr = static_cast<T*>(::operator new(n*sizeof(T), std::align_val_t(Alignment)));
+        try {
+            std::uninitialized_value_construct_n(ptr, n);
+        } catch (...) {
+            ::operator delete(ptr, std::align_val_t(Alignment));
+            ptr = nullptr;
+            throw; }
+    }
+
+    void release() {
+        if (ptr == nullptr) return;
+        std::destroy_n(ptr, storage_size());
+        ::operator delete(ptr, std::align_val_t(Alignment));
+        ptr = nullptr;
+    }
+
+    public:
+
+    static constexpr Layout layout = L;
+    static constexpr std::size_t alignment = Alignment;
+
+    DenseMatrix() {}
+
+    // an n_rows x n_cols matrix of value-initialized elements (0 for numbers)
+    DenseMatrix(std::size_t n_rows, std::size_t n_cols) { allocate(n_rows, n_cols, padded(line_length(n_rows, n_cols))); }
+
+    // the same, with an explicit leading dimension (at least the line length)
+    DenseMatrix(std::size_t n_rows, std::size_t n_cols, std::size_t leading_dimension) {
+        allocate(n_rows, n_cols, leading_dimension);
+    }
+
+    // a copy of a matrix (or block) of any layout
+    template <typename U, Layout L2>
+    explicit DenseMatrix(MatrixView<U, L2> other) {
+        allocate(other.rows(), other.cols(), padded(line_length(other.rows(), other.cols())));
+        copy(other, view());
+    }
+
+    template <Layout L2, std::size_t A2>
+    explicit DenseMatrix(const DenseMatrix<T, L2, A2>& other) : DenseMatrix(other.view()) {}
+
+    DenseMatrix(const DenseMatrix& other) {
+        allocate(other.n_rows, other.n_cols, other.ld);
+        std::copy(other.ptr, other.ptr + storage_size(), ptr);
+    }
+
+    DenseMatrix(DenseMatrix&& other) noexcept :
+        ptr(other.ptr), n_rows(other.n_rows), n_cols(other.n_cols), ld(other.ld) {
+        other.ptr = nullptr;
+        other.n_rows = other.n_cols = other.ld = 0;
+    }
+
+    DenseMatrix& operator=(DenseMatrix other) noexcept { swap(other); return *this; }
+
+    ~DenseMatrix() { release(); }
+
+    void swap(DenseMatrix& other) noexcept {
+        std::swap(ptr, other.ptr);
+        std::swap(n_rows, other.n_rows);
+        std::swap(n_cols, other.n_cols);
+        std::swap(ld, other.ld);
+    }
+
+    std::size_t rows() const { return n_rows; }
+    std::size_t cols() const { return n_cols; }
+    std::size_t size() const { return n_rows*n_cols; }
+    bool empty() const { return size() == 0; }
+    std::size_t leading_dimension() const { return ld; }
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+
+    T& operator()(std::size_t i, std::size_t j) { return ptr[element_offset<L>(i, j, ld)]; }
+    const T& operator()(std::size_t i, std::size_t j) const { return ptr[element_offset<L>(i, j, ld)]; }
+
+    T& at(std::size_t i, std::size_t j) {
+        if (i >= n_rows || j >= n_cols) throw std::runtime_error("error in DenseMatrix::at(): index out of range");
+        return (*this)(i, j);
+    }
+
+    const T& at(std::size_t i, std::size_t j) const {
+        if (i >= n_rows || j >= n_cols) throw std::runtime_error("error in DenseMatrix::at(): index out of range");
+        return (*this)(i, j);
+    }
+
+    MatrixView<T, L> view() { return MatrixView<T, L>(ptr, n_rows, n_cols, ld); }
+    MatrixView<const T, L> view() const { return MatrixView<const T, L>(ptr, n_rows, n_cols, ld); }
+
+    MatrixView<T, L> block(std::size_t i, std::size_t j, std::size_t n_block_rows, std::size_t n_block_cols) {
+        return view().block(i, j, n_block_rows, n_block_cols);
+    }
+
+    MatrixView<const T, L> block(std::size_t i, std::size_t j, std::size_t n_block_rows, std::size_t n_block_cols) const {
+        return view().block(i, j, n_block_rows, n_block_cols);
+    }
+
+    std::size_t lines() const { return L == Layout::RowMajor ? n_rows : n_cols; }
+    Span<T> line(std::size_t k) { return view().line(k); }
+    Span<const T> line(std::size_t k) const { return view().line(k); }
+    StridedSpan<T> row(std::size_t i) { return view().row(i); }
+    StridedSpan<const T> row(std::size_t i) const { return view().row(i); }
+    StridedSpan<T> col(std::size_t j) { return view().col(j); }
+    StridedSpan<const T> col(std::size_t j) const { return view().col(j); }
+
+    // all the elements in memory order, including the padding at the end of each line
+    Span<T> storage() { return Span<T>(ptr, storage_size()); }
+    Span<const T> storage() const { return Span<const T>(ptr, storage_size()); }
+
+    // set every element (but not the padding) to value
+    void fill(const T& value) {
+        for (std::size_t k=0;k<lines();k++) {
+            const Span<T> l = line(k);
+            std::fill(l.begin(), l.end(), value); }
+    }
+
+    // equal sizes and elements, whatever the leading dimensions
+    bool operator==(const DenseMatrix& rhs) const {
+        if (n_rows != rhs.n_rows || n_cols != rhs.n_cols) return false;
+        for (std::size_t k=0;k<lines();k++) {
+            if (!std::equal(line(k).begin(), line(k).end(), rhs.line(k).begin())) return false; }
+        return true;
+    }
+
+    bool operator!=(const DenseMatrix& rhs) const { return !(*this == rhs); }
+};
+
+#endif
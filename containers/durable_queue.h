@@ -0,0 +1,432 @@
+/*
+DurableQueue: a FIFO queue of byte records that survives process crashes and restarts, in memory-mapped segment files
+
+The Queue of brief_examples/stack_and_queue.cpp lives in memory, and is lost when the process exits. A DurableQueue
+keeps its records in files, in a directory of its own, so that a work queue survives a crash or a restart of the
+program, without the overhead of a database: enqueueing a record is a memcpy into a memory-mapped file, and making it
+durable is one msync() for a whole group of records.
+
+Layout
+    - the records are appended to SEGMENT files (64 MiB by default), numbered segment_00000000000000000001.log, 2, ...
+      Each segment is created at its full size (so it reads as zeros) and mapped into memory with mmap(MAP_SHARED), so
+      writing a record into the mapping writes it into the file (via the page cache)
+    - a record is a header of two 32-bit words, the LENGTH of the record and a CHECKSUM (CRC-32C) of the length and the
+      data, followed by the data, padded to a multiple of 8 bytes. A record that does not fit in the rest of a segment
+      goes at the start of the next one, and the writer marks the end of the old segment with a length of 0xFFFFFFFF
+    - a small CHECKPOINT file holds the positions (segment and offset) of the HEAD (the next record to dequeue) and of
+      the TAIL (where the next record will go), and the number of records in between. It has two slots, written
+      alternately with an increasing sequence number and their own checksum, so that a crash in the middle of writing
+      one slot leaves the other one intact
+    - when the head moves on from a segment, that segment has been fully consumed, and its file is deleted at the next
+      checkpoint (ROLLOVER): the files on disk hold only the unconsumed records, plus the rest of the current segment
+
+Group commit
+Writing into the mapping is not durable by itself: the data sits in the page cache until the kernel writes it back.
+sync() makes everything durable: msync(MS_SYNC) of the range of the segments written since the last sync, then the new
+checkpoint, written and flushed with fdatasync(). A sync costs about the same for one record as for thousands, so
+enqueue() syncs automatically only once sync_every_records records or sync_every_bytes bytes have been written since the
+last sync, or sync_interval has passed (the GROUP COMMIT policy of databases and message brokers). Options with
+sync_every_records = 1 give a sync per record: nothing acknowledged is ever lost, at the price of a disk flush per
+record. After a crash of the PROCESS (rather than of the machine), the page cache still holds everything written to the
+mappings, so even the records written after the last sync are recovered; after a power failure, the records since the
+last sync may be lost, but never the ones before it.
+Dequeued records are acknowledged (their space released) at the next sync as well: after a crash, the records dequeued
+since the last sync are delivered again (AT-LEAST-ONCE delivery), so consumers should tolerate duplicates.
+
+Recovery
+On opening, the queue reads the newest valid checkpoint, and then SCANS forward from the checkpointed tail, accepting
+records as long as their checksums are valid: these are the records written after the last sync. The first invalid
+header (a zero-filled or partly written record) is the end of the queue. Any garbage after it (parts of records written
+out of order before a crash) is zeroed, so that it can never be mistaken for a record later. Since the scan starts at
+the last checkpoint rather than at the head, restarting takes time proportional to the records written since the last
+sync, not to the length of the queue.
+
+A DurableQueue is not thread-safe (like the Queue of stack_and_queue.cpp): threads sharing one must lock around it. Only
+one process at a time can open a directory: the checkpoint file is locked with flock(), and a second open throws.
+Errors (a file that cannot be created or mapped, a record larger than a segment...) throw std::runtime_error.
+
+Requires C++17 (std::filesystem) and a POSIX system. With -msse4.2 (or -march=native on x86), the checksums use the CRC32
+instruction of the CPU.
+*/
+
+#ifndef DURABLE_QUEUE_H
+#define DURABLE_QUEUE_H
+
+#include <string>
+#include <map>
+#include <set>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <unistd.h>
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+class DurableQueue {
+
+    public:
+
+    struct Options {
+        std::size_t segment_size = 64 << 20;              // bytes per segment file (a multiple of the page size)
+        std::size_t sync_every_records = 1000;            // group commit: sync after this many records...
+        std::size_t sync_every_bytes = 4 << 20;           // ...or this many bytes...
+        std::chrono::milliseconds sync_interval{10};      // ...or this long since the last sync (0: no time limit)
+    };
+
+    private:
+
+    static const std::uint32_t end_of_segment = 0xFFFFFFFFu;
+    static const std::uint64_t checkpoint_magic = 0x4B50434551445551ull;
+    static const std::size_t header_size = 8;
+
+    struct Position {
+        std::uint64_t segment, offset;
+        bool operator==(const Position& rhs) const { return segment == rhs.segment && offset == rhs.offset; }
+    };
+
+    struct Segment {
+        int fd;
+        char* base;
+        std::size_t size;
+    };
+
+    struct Checkpoint {
+        std::uint64_t magic, sequence, head_segment, head_offset, tail_segment, tail_offset, n_records;
+        std::uint32_t checksum, unused;
+    };
+
+    std::string directory;
+    Options options;
+    int directory_fd = -1, checkpoint_fd = -1;
+    std::map<std::uint64_t, Segment> segments; // the mapped segments, from the head's to the tail's
+    Position head{1, 0}, tail{1, 0};
+    Position synced{1, 0};                      // the records before this position are known to be on disk
+    std::size_t n = 0;
+    std::uint64_t checkpoint_sequence = 0;
+    std::size_t pending_records = 0, pending_bytes = 0;
+    bool head_moved = false, directory_changed = false;
+    std::chrono::steady_clock::time_point last_sync;
+    std::size_t n_recovered = 0, n_syncs = 0;
+
+    // ----- checksums: CRC-32C (Castagnoli), with the CPU's CRC32 instruction if available -----
+
+    static std::uint32_t crc32c_update(std::uint32_t crc, const void* data, std::size_t length) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+#if defined(__SSE4_2__)
+        std::uint64_t crc64 = crc;
+        for (;length>=8;length-=8,p+=8) {
+            std::uint64_t word;
+            std::memcpy(&word, p, 8);
+            crc64 = _mm_crc32_u64(crc64, word); }
+        crc = std::uint32_t(crc64);
+        for (;length>0;length--,p++) crc = _mm_crc32_u8(crc, *p);
+#else
+        static const struct Table {
+            std::uint32_t entry[256];
+            Table() {
+                for (std::uint32_t i=0;i<256;i++) {
+                    std::uint32_t c = i;
+                    for (int k=0;k<8;k++) c = c & 1 ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+                    entry[i] = c; } }
+        } table;
+        for (;length>0;length--,p++) crc = table.entry[(crc ^ *p) & 0xFF] ^ (crc >> 8);
+#endif
+        return crc;
+    }
+
+    static std::uint32_t record_checksum(std::uint32_t length, const void* data) {
+        return ~crc32c_update(crc32c_update(~0u, &length, 4), data, length);
+    }
+
+    static std::uint32_t checkpoint_checksum(const Checkpoint& c) {
+        return ~crc32c_update(~0u, &c, offsetof(Checkpoint, checksum));
+    }
+
+    // ----- files -----
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("error in DurableQueue (" + directory + "): " + what + ": " + std::strerror(errno));
+    }
+
+    std::string segment_path(std::uint64_t id) const {
+        char name[48];
+        std::snprintf(name, sizeof(name), "/segment_%020llu.log", static_cast<unsigned long long>(id));
+        return directory + name;
+    }
+
+    // the ids of the segment files in the directory
+    std::set<std::uint64_t> list_segments() const {
+        std::set<std::uint64_t> ids;
+        for (const auto& entry: std::filesystem::directory_iterator(directory)) {
+            const std::string name = entry.path().filename().string();
+            unsigned long long id;
+            if (name.size() == 32 && std::sscanf(name.c_str(), "segment_%20llu.log", &id) == 1) ids.insert(id); }
+        return ids;
+    }
+
+    // map a segment file, creating it (zero-filled, of options.segment_size bytes) if create is true
+    Segment& open_segment(std::uint64_t id, bool create) {
+        const std::string path = segment_path(id);
+        const int fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+        if (fd < 0) fail("cannot open " + path);
+        std::size_t size = options.segment_size;
+        if (create) {
+            if (::ftruncate(fd, off_t(size)) != 0) { ::close(fd); fail("cannot size " + path); }
+            directory_changed = true; }
+        else {
+            struct stat st;
+            if (::fstat(fd, &st) != 0) { ::close(fd); fail("cannot stat " + path); }
+            size = std::size_t(st.st_size) & ~std::size_t(7); }
+        void* base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) { ::close(fd); fail("cannot map " + path); }
+        return segments[id] = Segment{fd, static_cast<char*>(base), size};
+    }
+
+    void close_segment(std::uint64_t id, bool remove) {
+        auto it = segments.find(id);
+        ::munmap(it->second.base, it->second.size);
+        ::close(it->second.fd);
+        segments.erase(it);
+        if (remove) {
+            ::unlink(segment_path(id).c_str());
+            directory_changed = true; }
+    }
+
+    static std::size_t record_size(std::size_t length) { return (header_size + length + 7) & ~std::size_t(7); }
+
+    // the length field of the header at p, and whether the header is a valid record
+    static bool valid_record(const char* p, std::size_t space, std::uint32_t& length) {
+        std::uint32_t checksum;
+        std::memcpy(&length, p, 4);
+        std::memcpy(&checksum, p + 4, 4);
+        if (length == end_of_segment || record_size(length) > space) return false;
+        return checksum == record_checksum(length, p + header_size);
+    }
+
+    bool read_checkpoint(Checkpoint& newest) const {
+        bool found = false;
+        for (int slot=0;slot<2;slot++) {
+            Checkpoint c;
+            if (::pread(checkpoint_fd, &c, sizeof(c), off_t(slot*sizeof(c))) != ssize_t(sizeof(c))) continue;
+            if (c.magic != checkpoint_magic || c.checksum != checkpoint_checksum(c)) continue;
+            if (!found || c.sequence > newest.sequence) { newest = c; found = true; } }
+        return found;
+    }
+
+    void write_checkpoint() {
+        Checkpoint c;
+        std::memset(&c, 0, sizeof(c));
+        c.magic = checkpoint_magic;
+        c.sequence = ++checkpoint_sequence;
+        c.head_segment = head.segment; c.head_offset = head.offset;
+        c.tail_segment = tail.segment; c.tail_offset = tail.offset;
+        c.n_records = n;
+        c.checksum = checkpoint_checksum(c);
+        const off_t slot = off_t((c.sequence % 2)*sizeof(c)); // never overwrite the newest valid checkpoint
+        if (::pwrite(checkpoint_fd, &c, sizeof(c), slot) != ssize_t(sizeof(c))) fail("cannot write the checkpoint");
+        if (::fdatasync(checkpoint_fd) != 0) fail("cannot flush the checkpoint");
+    }
+
+    // msync [from, to) of a segment, from the start of the page containing from
+    void flush_range(const Segment& s, std::size_t from, std::size_t to) const {
+        static const std::size_t page = std::size_t(::sysconf(_SC_PAGESIZE));
+        from -= from % page;
+        if (to > from && ::msync(s.base + from, to - from, MS_SYNC) != 0) fail("cannot msync a segment");
+    }
+
+    // the writer moves on to a new segment
+    void roll_tail() {
+        Segment& s = segments.at(tail.segment);
+        if (tail.offset + header_size <= s.size) {
+            const std::uint32_t marker[2] = {end_of_segment, 0};
+            std::memcpy(s.base + tail.offset, marker, sizeof(marker)); }
+        tail = Position{tail.segment+1, 0};
+        open_segment(tail.segment, true);
+    }
+
+    // is the space [from, size) of a segment all zeros?
+    static bool all_zero(const Segment& s, std::size_t from) {
+        for (std::size_t i=from;i<s.size;i+=8) {
+            std::uint64_t word;
+            std::memcpy(&word, s.base + i, 8);
+            if (word != 0) return false; }
+        return true;
+    }
+
+    void recover() {
+        std::filesystem::create_directories(directory);
+        directory_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (directory_fd < 0) fail("cannot open the directory");
+        const std::string checkpoint_path = directory + "/checkpoint";
+        checkpoint_fd = ::open(checkpoint_path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (checkpoint_fd < 0) fail("cannot open " + checkpoint_path);
+        if (::flock(checkpoint_fd, LOCK_EX | LOCK_NB) != 0) fail("the queue is in use by another process");
+
+        std::set<std::uint64_t> ids = list_segments();
+        Checkpoint c{};
+        if (read_checkpoint(c)) {
+            head = Position{c.head_segment, c.head_offset};
+            tail = Position{c.tail_segment, c.tail_offset};
+            n = c.n_records;
+            checkpoint_sequence = c.sequence; }
+        else { // a new queue, or a crash before the first checkpoint: scan whatever segments there are
+            const std::uint64_t first = ids.empty() ? 1 : *ids.begin();
+            head = tail = Position{first, 0}; }
+        synced = tail;
+
+        // the consumed segments may not have been deleted before the crash; the others must follow on from the head's
+        for (std::uint64_t id: ids) {
+            if (id < head.segment) { ::unlink(segment_path(id).c_str()); directory_changed = true; } }
+        for (std::uint64_t id=head.segment;ids.count(id);id++) open_segment(id, false);
+        if (segments.empty() || segments.rbegin()->first < tail.segment) {
+            if (tail.offset != 0 || ids.count(tail.segment) || head.segment != tail.segment)
+                throw std::runtime_error("error in DurableQueue (" + directory + "): segment files are missing");
+            open_segment(tail.segment, true); }
+
+        // the records written after the checkpoint: as far as the checksums are valid
+        while (true) {
+            const Segment& s = segments.at(tail.segment);
+            std::uint32_t length = 0;
+            if (tail.offset + header_size <= s.size) std::memcpy(&length, s.base + tail.offset, 4);
+            if (tail.offset + header_size > s.size || length == end_of_segment) { // on to the next segment, if any
+                if (!segments.count(tail.segment+1)) break;
+                tail = Position{tail.segment+1, 0};
+                continue; }
+            if (!valid_record(s.base + tail.offset, s.size - tail.offset, length)) break;
+            tail.offset += record_size(length);
+            n++;
+            n_recovered++; }
+
+        // segments after the tail's were never checkpointed, and any garbage after the tail must go
+        while (segments.rbegin()->first > tail.segment) close_segment(segments.rbegin()->first, true);
+        const Segment& s = segments.at(tail.segment);
+        if (!all_zero(s, tail.offset)) {
+            std::memset(s.base + tail.offset, 0, s.size - tail.offset);
+            flush_range(s, tail.offset, s.size); }
+
+        head_moved = true; // so that sync() writes a checkpoint of the recovered state
+        sync();
+    }
+
+    public:
+
+    explicit DurableQueue(const std::string& directory) : DurableQueue(directory, Options()) {}
+
+    DurableQueue(const std::string& directory, const Options& options) : directory(directory), options(options) {
+        if (options.segment_size < 4096 || options.segment_size % 4096 != 0)
+            throw std::runtime_error("error in DurableQueue(): the segment size must be a multiple of 4096");
+        last_sync = std::chrono::steady_clock::now();
+        try {
+            recover();
+        } catch (...) {
+            release();
+            throw; }
+    }
+
+    DurableQueue(const DurableQueue&) = delete;
+    DurableQueue& operator=(const DurableQueue&) = delete;
+
+    ~DurableQueue() {
+        try { sync(); } catch (...) {}
+        release();
+    }
+
+    std::size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+
+    // the number of records found after the checkpoint when the queue was opened, and the number of syncs so far
+    std::size_t recovered_records() const { return n_recovered; }
+    std::size_t syncs() const { return n_syncs; }
+
+    // append a record; it is durable after the next sync, which the group commit policy may do right away
+    void enqueue(const void* data, std::size_t length) {
+        const std::size_t needed = record_size(length);
+        if (needed > options.segment_size) throw std::runtime_error("error in enqueue(): the record is larger than a segment");
+        if (tail.offset + needed > segments.at(tail.segment).size) roll_tail();
+        char* p = segments.at(tail.segment).base + tail.offset;
+        std::memcpy(p + header_size, data, length);
+        const std::uint32_t header[2] = {std::uint32_t(length), record_checksum(std::uint32_t(length), data)};
+        std::memcpy(p, header, header_size);
+        tail.offset += needed;
+        n++;
+        pending_records++;
+        pending_bytes += needed;
+        if (pending_records >= options.sync_every_records || pending_bytes >= options.sync_every_bytes ||
+            (options.sync_interval.count() > 0 && std::chrono::steady_clock::now() - last_sync >= options.sync_interval))
+            sync();
+    }
+
+    void enqueue(const std::string& record) { enqueue(record.data(), record.size()); }
+
+    /* remove the record at the head, and call f(data, length) on it, without copying it. The data stays valid until
+       the next call to a member function. Returns false if the queue is empty */
+    template <typename F>
+    bool try_consume(F f) {
+        while (!(head == tail)) {
+            const Segment& s = segments.at(head.segment);
+            std::uint32_t length = end_of_segment;
+            if (head.offset + header_size <= s.size) std::memcpy(&length, s.base + head.offset, 4);
+            if (length == end_of_segment) { // the rest of this segment is unused: it is fully consumed
+                head = Position{head.segment+1, 0};
+                head_moved = true;
+                continue; }
+            const char* data = s.base + head.offset + header_size;
+            head.offset += record_size(length);
+            head_moved = true;
+            n--;
+            f(data, std::size_t(length));
+            return true; }
+        return false;
+    }
+
+    bool try_dequeue(std::string& out) {
+        return try_consume([&out](const char* data, std::size_t length) { out.assign(data, length); });
+    }
+
+    std::string dequeue() {
+        std::string record;
+        if (!try_dequeue(record)) throw std::runtime_error("error in dequeue(): the DurableQueue is empty");
+        return record;
+    }
+
+    // make every record enqueued so far durable, and acknowledge every record dequeued so far
+    void sync() {
+        if (pending_records == 0 && !head_moved && !directory_changed) return;
+        for (auto it=segments.find(synced.segment);it!=segments.end() && it->first<=tail.segment;++it) {
+            const std::size_t from = it->first == synced.segment ? synced.offset : 0;
+            const std::size_t to = it->first == tail.segment ? tail.offset : it->second.size;
+            flush_range(it->second, from, to); }
+        if (directory_changed && ::fsync(directory_fd) != 0) fail("cannot flush the directory");
+        directory_changed = false;
+        write_checkpoint();
+        synced = tail;
+        // the checkpoint now says that the segments before the head's are consumed: delete them (rollover)
+        while (segments.begin()->first < head.segment) close_segment(segments.begin()->first, true);
+        pending_records = 0;
+        pending_bytes = 0;
+        head_moved = false;
+        last_sync = std::chrono::steady_clock::now();
+        n_syncs++;
+    }
+
+    private:
+
+    void release() {
+        while (!segments.empty()) close_segment(segments.begin()->first, false);
+        if (checkpoint_fd >= 0) ::close(checkpoint_fd); // also releases the lock
+        if (directory_fd >= 0) ::close(directory_fd);
+        checkpoint_fd = directory_fd = -1;
+    }
+};
+
+#endif
@@ -0,0 +1,213 @@
+/*
+DurableQueue (durable_queue.h): throughput of the group commit policies, restarts, and recovery after a crash
+
+    1. THROUGHPUT: enqueue n records of 100 bytes, then dequeue them all, with different group commit policies:
+        - a sync (msync + checkpoint) after every record: nothing acknowledged is ever lost, but every record waits for
+          the disk. This is what a database does for every committed transaction, unless it batches commits too
+        - a sync every 100 records, and every 10000 records or 10 ms (the defaults are 1000 records or 10 ms)
+        - no sync until the end: the speed of the memory-mapped files alone
+       and, for comparison, a std::queue<std::string> in memory
+    2. RESTART: enqueue records into small (64 KiB) segments, dequeue some of them, close the queue and open it again:
+       the remaining records must come back in order, and the fully consumed segment files must have been deleted
+    3. CRASH: a child process enqueues records, and reports through a pipe how many have been acknowledged by a sync;
+       then it kills itself with SIGKILL in the middle of its work, without any destructor running. The parent then
+       opens the queue: every acknowledged record must be there, in order and intact, and since the page cache survives
+       the crash of a process, so must the records written after the last sync, which the recovery scan finds
+The queue directory is created in the current directory (or in the directory given on the command line), and deleted at
+the end. The times depend very much on the file system and the disk: msync on tmpfs is free, and on a disk without a
+write cache every sync costs milliseconds.
+
+Compile with:
+g++ -std=c++17 -O2 -msse4.2 -o durable_queues durable_queues.cpp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <queue>
+#include <chrono>
+#include <filesystem>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "durable_queue.h"
+
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point t_start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+// a record of `size` bytes that starts with its sequence number
+string make_record(long i, size_t size) {
+    string record(size, 'a' + char(i % 26));
+    char number[24];
+    const int length = snprintf(number, sizeof(number), "%ld:", i);
+    record.replace(0, size_t(length) < size ? size_t(length) : size, number, size_t(length) < size ? length : size);
+    return record;
+}
+
+// the sequence number at the start of a record, or -1 if the record is not intact
+long check_record(const char* data, size_t length, size_t expected_size) {
+    if (length != expected_size) return -1;
+    long i = -1;
+    if (sscanf(string(data, length < 24 ? length : 24).c_str(), "%ld:", &i) != 1) return -1;
+    return string(data, length) == make_record(i, expected_size) ? i : -1;
+}
+
+void throughput(const string& dir, const char* name, long n, DurableQueue::Options options) {
+    filesystem::remove_all(dir);
+    const size_t record_size = 100;
+    string record = make_record(0, record_size);
+    double t_enqueue, t_dequeue;
+    size_t n_syncs;
+    bool ok = true;
+    {
+    DurableQueue q(dir, options);
+    auto t_start = chrono::steady_clock::now();
+    for (long i=0;i<n;i++) {
+        record = make_record(i, record_size);
+        q.enqueue(record); }
+    q.sync();
+    t_enqueue = seconds_since(t_start);
+    n_syncs = q.syncs();
+
+    t_start = chrono::steady_clock::now();
+    long expected = 0;
+    while (q.try_consume([&](const char* data, size_t length) {
+        ok = ok && check_record(data, length, record_size) == expected++; })) {}
+    q.sync();
+    t_dequeue = seconds_since(t_start);
+    ok = ok && expected == n;
+    }
+    cout << setw(28) << name << setw(10) << n << fixed << setprecision(0) << setw(14) << n/t_enqueue \
+         << setprecision(1) << setw(12) << n*record_size/t_enqueue/1.0e6 << setprecision(0) << setw(14) \
+         << n/t_dequeue << setw(10) << n_syncs << (ok ? "" : "   WRONG RECORDS") << endl;
+    cout.unsetf(ios::fixed);
+}
+
+size_t count_segment_files(const string& dir) {
+    size_t count = 0;
+    for (const auto& entry: filesystem::directory_iterator(dir)) {
+        if (entry.path().filename().string().compare(0, 8, "segment_") == 0) count++; }
+    return count;
+}
+
+int main (int argc, char *argv[]) {
+
+    const string base = argc > 1 ? argv[1] : ".";
+    const string dir = base + "/durable_queue_data";
+    bool all_ok = true;
+
+    // 1. throughput
+    cout << "THROUGHPUT (100-byte records)" << endl;
+    cout << setw(28) << "policy" << setw(10) << "records" << setw(14) << "enqueue/s" << setw(12) << "MB/s" \
+         << setw(14) << "dequeue/s" << setw(10) << "syncs" << endl;
+    DurableQueue::Options every_record, every_100, grouped, at_end;
+    every_record.sync_every_records = 1;
+    every_100.sync_every_records = 100;
+    grouped.sync_every_records = 10000;
+    at_end.sync_every_records = SIZE_MAX;
+    at_end.sync_every_bytes = SIZE_MAX;
+    at_end.sync_interval = chrono::milliseconds(0);
+    throughput(dir, "sync every record", 2000, every_record);
+    throughput(dir, "sync every 100 records", 200000, every_100);
+    throughput(dir, "every 10000 records / 10 ms", 2000000, grouped);
+    throughput(dir, "sync at the end only", 2000000, at_end);
+    {
+    queue<string> q;
+    auto t_start = chrono::steady_clock::now();
+    const long n = 2000000;
+    for (long i=0;i<n;i++) q.push(make_record(i, 100));
+    const double t_enqueue = seconds_since(t_start);
+    t_start = chrono::steady_clock::now();
+    long expected = 0;
+    while (!q.empty()) {
+        all_ok = all_ok && check_record(q.front().data(), q.front().size(), 100) == expected++;
+        q.pop(); }
+    const double t_dequeue = seconds_since(t_start);
+    cout << setw(28) << "std::queue<string> (memory)" << setw(10) << n << fixed << setprecision(0) << setw(14) \
+         << n/t_enqueue << setprecision(1) << setw(12) << n*100/t_enqueue/1.0e6 << setprecision(0) << setw(14) \
+         << n/t_dequeue << setw(10) << "-" << endl;
+    cout.unsetf(ios::fixed);
+    }
+
+    // 2. restart, with rollover of the consumed segments
+    cout << "\nRESTART" << endl;
+    filesystem::remove_all(dir);
+    DurableQueue::Options small_segments;
+    small_segments.segment_size = 65536;
+    const long n_restart = 20000, n_consumed = 15000;
+    size_t files_before, files_after;
+    {
+    DurableQueue q(dir, small_segments);
+    for (long i=0;i<n_restart;i++) q.enqueue(make_record(i, 200));
+    q.sync();
+    files_before = count_segment_files(dir);
+    for (long i=0;i<n_consumed;i++) all_ok = all_ok && check_record(q.dequeue().data(), 200, 200) == i;
+    } // the destructor syncs: the consumed segments are deleted
+    files_after = count_segment_files(dir);
+    {
+    DurableQueue q(dir, small_segments);
+    bool ok = q.size() == size_t(n_restart - n_consumed);
+    for (long i=n_consumed;i<n_restart && ok;i++) ok = check_record(q.dequeue().data(), 200, 200) == i;
+    ok = ok && q.empty();
+    all_ok = all_ok && ok;
+    cout << "enqueued " << n_restart << " records in " << files_before << " segment files, dequeued " << n_consumed \
+         << ": " << files_after << " files left; after the restart, the other " << n_restart - n_consumed \
+         << " records are " << (ok ? "all there, in order" : "WRONG") << endl;
+    }
+
+    // 3. crash
+    cout << "\nCRASH" << endl;
+    filesystem::remove_all(dir);
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) { perror("pipe"); return 1; }
+    const long n_before_crash = 123456;
+    const pid_t child = fork();
+    if (child == 0) {
+        close(pipe_fds[0]);
+        DurableQueue::Options options;
+        options.segment_size = 1 << 20;
+        options.sync_every_records = 1000;
+        options.sync_interval = chrono::milliseconds(0);
+        DurableQueue q(dir, options);
+        size_t syncs = q.syncs();
+        for (long i=0;;i++) {
+            if (i == n_before_crash) kill(getpid(), SIGKILL); // no destructor, no final sync
+            q.enqueue(make_record(i, 100));
+            if (q.syncs() != syncs) { // records 0..i are durable
+                syncs = q.syncs();
+                const long acknowledged = i + 1;
+                if (write(pipe_fds[1], &acknowledged, sizeof(acknowledged)) != sizeof(acknowledged)) _exit(2); } } }
+    close(pipe_fds[1]);
+    long acknowledged = 0, value;
+    while (read(pipe_fds[0], &value, sizeof(value)) == sizeof(value)) acknowledged = value;
+    close(pipe_fds[0]);
+    int status;
+    waitpid(child, &status, 0);
+    {
+    auto t_start = chrono::steady_clock::now();
+    DurableQueue q(dir);
+    const double t_open = seconds_since(t_start);
+    const size_t recovered = q.recovered_records(), size = q.size();
+    long expected = 0;
+    bool ok = true;
+    while (q.try_consume([&](const char* data, size_t length) { ok = ok && check_record(data, length, 100) == expected++; })) {}
+    // a process crash keeps the page cache, so ALL the records must be there, not only the acknowledged ones
+    ok = ok && expected == n_before_crash && long(size) == n_before_crash && acknowledged > 0;
+    all_ok = all_ok && ok;
+    cout << "the child was killed by signal " << (WIFSIGNALED(status) ? WTERMSIG(status) : 0) << " after " \
+         << n_before_crash << " records, " << acknowledged << " of them acknowledged by a sync" << endl;
+    cout << "reopened in " << fixed << setprecision(2) << 1.0e3*t_open << " ms: " << size << " records (" << recovered \
+         << " found by the recovery scan after the checkpoint), " << (ok ? "all intact and in order" : "WRONG") << endl;
+    cout.unsetf(ios::fixed);
+    }
+
+    filesystem::remove_all(dir);
+    cout << "\nresults " << (all_ok ? "correct" : "WRONG") << endl;
+    return all_ok ? 0 : 1;
+}
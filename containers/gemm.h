@@ -0,0 +1,332 @@
+/*
+gemm(): C = alpha*A*B + beta*C for float, double and int matrices, cache-blocked and vectorized
+
+The textbook triple loop, C(i,j) += A(i,k)*B(k,j), reaches only a few percent of what a core can compute: every
+multiply-add needs two loads (for a row-major B, one of them walks down a column, one cache line per element), and
+nothing read is kept in registers or cache long enough to be reused. A fast GEMM is organised around the memory
+hierarchy instead (this is the structure of GotoBLAS, OpenBLAS and BLIS):
+    - the MICRO-KERNEL computes an mr x nr block of C held entirely in vector REGISTERS (e.g. 6 x 16 floats in 12 AVX2
+      registers). At each step k it loads nr elements of B (a few vectors), and for each of the mr rows broadcasts one
+      element of A and does one vector FMA per vector of B: mr*nr/width FMAs for mr + nr/width loads, which keeps the
+      FMA units busy instead of the load ports
+    - CACHE TILING: the k dimension is cut into slices of kc, so that an nr x kc micro-panel of B stays in the L1 cache
+      while the kernel walks over the A block; an mc x kc block of A is sized for the L2 cache, and a kc x nc panel of
+      B for the L3 cache
+    - PACKING: before use, the block of A is copied into micro-panels of mr rows, and the panel of B into micro-panels
+      of nr columns, both in the exact order the micro-kernel reads them (so its loads are sequential and aligned,
+      whatever the layout and the leading dimension of A and B), zero-padded at the edges so the kernel never needs a
+      special case. Packing costs O(mc*kc) copies for O(mc*kc*nc) multiply-adds
+    - OPENMP: the panel of B is packed by all the threads together, then the blocks of C (mc rows, and all or part of
+      the nc columns) are computed in parallel, each thread packing its own block of A
+The micro-kernels use AVX2 + FMA (16 registers of 256 bits: 6 x 2 vectors of C) or AVX-512 (32 registers of 512 bits:
+12 x 2 vectors of C) intrinsics, compiled with GCC/Clang target attributes, so that the header does not require
+-mavx2 or -march=native: the best kernel the CPU supports is chosen at run time (best_simd_level()), and it can also be
+chosen explicitly, e.g. to compare them. Without these (or for other element types) a portable kernel with plain loops
+is used. For int there is no FMA: the kernel multiplies (vpmulld) and adds, and the results wrap around on overflow as
+with the vector instructions.
+A, B and C are MatrixViews (dense_matrix.h) of any layout, so blocks of larger matrices can be multiplied in place; a
+fixed size std::array<std::array<T, n>, m> (MultiDimArray of random_examples/multidim_arr_alias.cpp, or the
+Matrix<T, m, n>::type of random_examples/metafunction_type.cpp) is contiguous too, and is seen as
+MatrixView<T>(&a[0][0], m, n, n).
+
+Requires C++17. Compile with -fopenmp for the threads.
+*/
+
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <algorithm>
+#include <type_traits>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include "dense_matrix.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+enum class SimdLevel { Generic, Avx2, Avx512 };
+
+// the best instruction set of this CPU for the micro-kernels
+inline SimdLevel best_simd_level() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx512f")) return SimdLevel::Avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdLevel::Avx2;
+#endif
+    return SimdLevel::Generic;
+}
+
+inline const char* simd_level_name(SimdLevel level) {
+    return level == SimdLevel::Avx512 ? "AVX-512" : level == SimdLevel::Avx2 ? "AVX2" : "generic";
+}
+
+// the portable micro-kernel: c[mr][nr] = sum over k of a[k][mr] (outer product) b[k][nr]
+template <typename T, int MR, int NR>
+void gemm_kernel_generic(std::size_t kc, const T* a, const T* b, T* c) {
+    T acc[MR][NR] = {};
+    for (std::size_t k=0;k<kc;k++) {
+        for (int i=0;i<MR;i++) {
+            for (int j=0;j<NR;j++) acc[i][j] += a[i]*b[j]; }
+        a += MR;
+        b += NR; }
+    for (int i=0;i<MR;i++) {
+        for (int j=0;j<NR;j++) c[i*NR + j] = acc[i][j]; }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define GEMM_AVX2 __attribute__((target("avx2,fma")))
+#define GEMM_AVX512 __attribute__((target("avx512f,avx2,fma")))
+
+// the vector operations of the micro-kernels, for each element type
+template <typename T> struct Avx2Ops;
+template <typename T> struct Avx512Ops;
+
+template <> struct Avx2Ops<float> {
+    typedef __m256 vec;
+    static const int width = 8;
+    GEMM_AVX2 static vec zero() { return _mm256_setzero_ps(); }
+    GEMM_AVX2 static vec load(const float* p) { return _mm256_load_ps(p); }
+    GEMM_AVX2 static vec broadcast(const float* p) { return _mm256_broadcast_ss(p); }
+    GEMM_AVX2 static vec multiply_add(vec a, vec b, vec c) { return _mm256_fmadd_ps(a, b, c); }
+    GEMM_AVX2 static void store(float* p, vec v) { _mm256_store_ps(p, v); }
+};
+
+template <> struct Avx2Ops<double> {
+    typedef __m256d vec;
+    static const int width = 4;
+    GEMM_AVX2 static vec zero() { return _mm256_setzero_pd(); }
+    GEMM_AVX2 static vec load(const double* p) { return _mm256_load_pd(p); }
+    GEMM_AVX2 static vec broadcast(const double* p) { return _mm256_broadcast_sd(p); }
+    GEMM_AVX2 static vec multiply_add(vec a, vec b, vec c) { return _mm256_fmadd_pd(a, b, c); }
+    GEMM_AVX2 static void store(double* p, vec v) { _mm256_store_pd(p, v); }
+};
+
+template <> struct Avx2Ops<std::int32_t> {
+    typedef __m256i vec;
+    static const int width = 8;
+    GEMM_AVX2 static vec zero() { return _mm256_setzero_si256(); }
+    GEMM_AVX2 static vec load(const std::int32_t* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+    GEMM_AVX2 static vec broadcast(const std::int32_t* p) { return _mm256_set1_epi32(*p); }
+    GEMM_AVX2 static vec multiply_add(vec a, vec b, vec c) { return _mm256_add_epi32(_mm256_mullo_epi32(a, b), c); }
+    GEMM_AVX2 static void store(std::int32_t* p, vec v) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+};
+
+template <> struct Avx512Ops<float> {
+    typedef __m512 vec;
+    static const int width = 16;
+    GEMM_AVX512 static vec zero() { return _mm512_setzero_ps(); }
+    GEMM_AVX512 static vec load(const float* p) { return _mm512_load_ps(p); }
+    GEMM_AVX512 static vec broadcast(const float* p) { return _mm512_set1_ps(*p); }
+    GEMM_AVX512 static vec multiply_add(vec a, vec b, vec c) { return _mm512_fmadd_ps(a, b, c); }
+    GEMM_AVX512 static void store(float* p, vec v) { _mm512_store_ps(p, v); }
+};
+
+template <> struct Avx512Ops<double> {
+    typedef __m512d vec;
+    static const int width = 8;
+    GEMM_AVX512 static vec zero() { return _mm512_setzero_pd(); }
+    GEMM_AVX512 static vec load(const double* p) { return _mm512_load_pd(p); }
+    GEMM_AVX512 static vec broadcast(const double* p) { return _mm512_set1_pd(*p); }
+    GEMM_AVX512 static vec multiply_add(vec a, vec b, vec c) { return _mm512_fmadd_pd(a, b, c); }
+    GEMM_AVX512 static void store(double* p, vec v) { _mm512_store_pd(p, v); }
+};
+
+template <> struct Avx512Ops<std::int32_t> {
+    typedef __m512i vec;
+    static const int width = 16;
+    GEMM_AVX512 static vec zero() { return _mm512_setzero_si512(); }
+    GEMM_AVX512 static vec load(const std::int32_t* p) { return _mm512_load_si512(p); }
+    GEMM_AVX512 static vec broadcast(const std::int32_t* p) { return _mm512_set1_epi32(*p); }
+    GEMM_AVX512 static vec multiply_add(vec a, vec b, vec c) { return _mm512_add_epi32(_mm512_mullo_epi32(a, b), c); }
+    GEMM_AVX512 static void store(std::int32_t* p, vec v) { _mm512_store_si512(p, v); }
+};
+
+// the vectorized micro-kernels: MR rows of NV vectors of C in registers (the loops are fully unrolled)
+template <typename T, int MR, int NV>
+GEMM_AVX2 void gemm_kernel_avx2(std::size_t kc, const T* a, const T* b, T* c) {
+    typedef Avx2Ops<T> V;
+    typename V::vec acc[MR][NV];
+    #pragma GCC unroll 32
+    for (int i=0;i<MR;i++) {
+        #pragma GCC unroll 4
+        for (int v=0;v<NV;v++) acc[i][v] = V::zero(); }
+    for (std::size_t k=0;k<kc;k++) {
+        typename V::vec bk[NV];
+        #pragma GCC unroll 4
+        for (int v=0;v<NV;v++) bk[v] = V::load(b + v*V::width);
+        #pragma GCC unroll 32
+        for (int i=0;i<MR;i++) {
+            const typename V::vec aik = V::broadcast(a + i);
+            #pragma GCC unroll 4
+            for (int v=0;v<NV;v++) acc[i][v] = V::multiply_add(aik, bk[v], acc[i][v]); }
+        a += MR;
+        b += NV*V::width; }
+    #pragma GCC unroll 32
+    for (int i=0;i<MR;i++) {
+        #pragma GCC unroll 4
+        for (int v=0;v<NV;v++) V::store(c + (i*NV + v)*V::width, acc[i][v]); }
+}
+
+template <typename T, int MR, int NV>
+GEMM_AVX512 void gemm_kernel_avx512(std::size_t kc, const T* a, const T* b, T* c) {
+    typedef Avx512Ops<T> V;
+    typename V::vec acc[MR][NV];
+    #pragma GCC unroll 32
+    for (int i=0;i<MR;i++) {
+        #pragma GCC unroll 4
+        for (int v=0;v<NV;v++) acc[i][v] = V::zero(); }
+    for (std::size_t k=0;k<kc;k++) {
+        typename V::vec bk[NV];
+        #pragma GCC unroll 4
+        for (int v=0;v<NV;v++) bk[v] = V::load(b + v*V::width);
+        #pragma GCC unroll 32
+        for (int i=0;i<MR;i++) {
+            const typename V::vec aik = V::broadcast(a + i);
+            #pragma GCC unroll 4
+            for (int v=0;v<NV;v++) acc[i][v] = V::multiply_add(aik, bk[v], acc[i][v]); }
+        a += MR;
+        b += NV*V::width; }
+    #pragma GCC unroll 32
+    for (int i=0;i<MR;i++) {
+        #pragma GCC unroll 4
+        for (int v=0;v<NV;v++) V::store(c + (i*NV + v)*V::width, acc[i][v]); }
+}
+
+#endif
+
+// a micro-kernel and the size of the block of C it computes
+template <typename T>
+struct GemmKernel {
+    int mr, nr;
+    void (*compute)(std::size_t kc, const T* a, const T* b, T* c);
+};
+
+// the micro-kernel for T at the given level (the generic one if the level, or T, has no vectorized kernel)
+template <typename T>
+GemmKernel<T> gemm_kernel(SimdLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+    if constexpr (std::is_same<T, float>::value || std::is_same<T, double>::value || std::is_same<T, std::int32_t>::value) {
+        if (level > best_simd_level()) throw std::runtime_error("error in gemm(): this CPU does not support the SIMD level");
+        if (level == SimdLevel::Avx512) return GemmKernel<T>{12, 2*Avx512Ops<T>::width, gemm_kernel_avx512<T, 12, 2>};
+        if (level == SimdLevel::Avx2) return GemmKernel<T>{6, 2*Avx2Ops<T>::width, gemm_kernel_avx2<T, 6, 2>}; }
+#endif
+    (void)level;
+    return GemmKernel<T>{4, 8, gemm_kernel_generic<T, 4, 8>};
+}
+
+// copy rows [i0, i0+mc) x columns [k0, k0+kc) of A into micro-panels of mr rows, each stored k by k
+template <typename T, typename TA, Layout LA>
+void gemm_pack_a(MatrixView<TA, LA> a, std::size_t i0, std::size_t mc, std::size_t k0, std::size_t kc, int mr, T* dst) {
+    for (std::size_t ir=0;ir<mc;ir+=mr) {
+        const std::size_t m = std::min<std::size_t>(mr, mc - ir);
+        for (std::size_t k=0;k<kc;k++) {
+            std::size_t i = 0;
+            for (;i<m;i++) dst[i] = a(i0 + ir + i, k0 + k);
+            for (;i<std::size_t(mr);i++) dst[i] = T();
+            dst += mr; } }
+}
+
+// copy rows [k0, k0+kc) x columns [j0, j0+nc) of B into micro-panels of nr columns, each stored k by k
+template <typename T, typename TB, Layout LB>
+void gemm_pack_b(MatrixView<TB, LB> b, std::size_t k0, std::size_t kc, std::size_t j0, std::size_t nc, int nr, T* dst) {
+    for (std::size_t jr=0;jr<nc;jr+=nr) {
+        const std::size_t n = std::min<std::size_t>(nr, nc - jr);
+        for (std::size_t k=0;k<kc;k++) {
+            std::size_t j = 0;
+            for (;j<n;j++) dst[j] = b(k0 + k, j0 + jr + j);
+            for (;j<std::size_t(nr);j++) dst[j] = T();
+            dst += nr; } }
+}
+
+// C = alpha*A*B + beta*C (if beta is 0, C is not read: it may hold anything, even NaNs)
+template <typename TA, Layout LA, typename TB, Layout LB, typename T, Layout LC>
+void gemm(typename std::common_type<T>::type alpha, MatrixView<TA, LA> a, MatrixView<TB, LB> b,
+          typename std::common_type<T>::type beta, MatrixView<T, LC> c, SimdLevel level = best_simd_level()) {
+    static_assert(std::is_same<typename std::remove_const<TA>::type, T>::value &&
+                  std::is_same<typename std::remove_const<TB>::type, T>::value,
+                  "error in gemm(): A, B and C must have the same element type");
+    const std::size_t m = c.rows(), n = c.cols(), depth = a.cols();
+    if (a.rows() != m || b.rows() != depth || b.cols() != n)
+        throw std::runtime_error("error in gemm(): the sizes of the matrices do not match");
+    if (m == 0 || n == 0) return;
+    if (depth == 0 || alpha == T(0)) {
+        for (std::size_t i=0;i<m;i++) {
+            for (std::size_t j=0;j<n;j++) c(i, j) = beta == T(0) ? T(0) : beta*c(i, j); }
+        return; }
+
+    const GemmKernel<T> kernel = gemm_kernel<T>(level);
+    const std::size_t mr = kernel.mr, nr = kernel.nr;
+    // the block sizes: an nr x kc micro-panel of B in 16 KiB (of the L1 cache), an mc x kc block of A in 256 KiB (of
+    // the L2 cache), and a kc x nc panel of B in 4 MiB (of the L3 cache), but no larger than the matrices
+    const std::size_t kc_max = std::max<std::size_t>(64, 16384/(nr*sizeof(T)));
+    const std::size_t kc = std::min(kc_max, depth);
+    const std::size_t mc = std::min(std::max(mr, 262144/(kc_max*sizeof(T))/mr*mr), (m + mr - 1)/mr*mr);
+    const std::size_t nc = std::min(std::max(nr, 4194304/(kc_max*sizeof(T))/nr*nr), (n + nr - 1)/nr*nr);
+
+#ifdef _OPENMP
+    const int n_threads = omp_get_max_threads();
+#else
+    const int n_threads = 1;
+#endif
+    // the packed panel of B, shared by the threads, and a packed block of A and a tile of C per thread
+    DenseMatrix<T> b_packed(1, kc*nc), a_packed(n_threads, mc*kc), c_tiles(n_threads, mr*nr);
+
+    for (std::size_t jc=0;jc<n;jc+=nc) {
+        const std::size_t n_cur = std::min(nc, n - jc);
+        const long n_panels = long((n_cur + nr - 1)/nr);
+        // split the columns of the panel if there are too few blocks of rows to keep all the threads busy
+        const long m_blocks = long((m + mc - 1)/mc);
+        long n_split = 1;
+        while (n_threads > 1 && m_blocks*n_split < 2*n_threads && n_panels >= 8*n_split) n_split *= 2;
+
+        for (std::size_t pc=0;pc<depth;pc+=kc) {
+            const std::size_t k_cur = std::min(kc, depth - pc);
+            const T beta_cur = pc == 0 ? T(beta) : T(1); // the first slice of k scales C, the next ones add to it
+
+            #pragma omp parallel num_threads(n_threads)
+            {
+#ifdef _OPENMP
+            const int thread = omp_get_thread_num();
+#else
+            const int thread = 0;
+#endif
+            T* a_pack = a_packed.line(thread).data();
+            T* c_tile = c_tiles.line(thread).data();
+
+            #pragma omp for schedule(static)
+            for (long p=0;p<n_panels;p++) {
+                const std::size_t j0 = std::size_t(p)*nr;
+                gemm_pack_b(b, pc, k_cur, jc + j0, std::min(nr, n_cur - j0), int(nr), b_packed.data() + j0*k_cur); }
+
+            #pragma omp for collapse(2) schedule(dynamic)
+            for (long ib=0;ib<m_blocks;ib++) {
+                for (long s=0;s<n_split;s++) {
+                    const std::size_t ic = std::size_t(ib)*mc, m_cur = std::min(mc, m - ic);
+                    gemm_pack_a(a, ic, m_cur, pc, k_cur, int(mr), a_pack);
+                    const long p0 = n_panels*s/n_split, p1 = n_panels*(s + 1)/n_split;
+                    for (long p=p0;p<p1;p++) {
+                        const std::size_t jr = std::size_t(p)*nr, n_tile = std::min(nr, n_cur - jr);
+                        for (std::size_t ir=0;ir<m_cur;ir+=mr) {
+                            const std::size_t m_tile = std::min(mr, m_cur - ir);
+                            kernel.compute(k_cur, a_pack + ir*k_cur, b_packed.data() + jr*k_cur, c_tile);
+                            for (std::size_t i=0;i<m_tile;i++) {
+                                for (std::size_t j=0;j<n_tile;j++) {
+                                    T& cij = c(ic + ir + i, jc + jr + j);
+                                    cij = beta_cur == T(0) ? alpha*c_tile[i*nr + j] : alpha*c_tile[i*nr + j] + beta_cur*cij; } } } } } }
+            } } }
+}
+
+// the product of two matrices, as a new row-major matrix
+template <typename T, Layout LA, std::size_t AA, Layout LB, std::size_t AB>
+DenseMatrix<T> matrix_product(const DenseMatrix<T, LA, AA>& a, const DenseMatrix<T, LB, AB>& b,
+                              SimdLevel level = best_simd_level()) {
+    DenseMatrix<T> c(a.rows(), b.cols());
+    gemm(T(1), a.view(), b.view(), T(0), c.view(), level);
+    return c;
+}
+
+#endif
@@ -0,0 +1,209 @@
+/*
+gemm() (gemm.h) against the naive triple loop, for float, double and int
+
+    1. CORRECTNESS: for every element type and every micro-kernel the CPU supports, C = alpha*A*B + beta*C for sizes from
+       1 x 1 to sizes that cross the block sizes mc, nc and kc (so that the edges and the accumulation over the slices
+       of k are exercised), with A, B and C of different layouts, and as blocks of larger matrices (leading dimension
+       larger than the block). The result is compared with the triple loop computed in a wider type (long double for
+       float and double, long long for int, which must then match exactly), within the error bound of floating point
+       dot products, |error| <= 2*k*eps*sum(|A(i,l)*B(l,j)|)
+    2. PERFORMANCE: GFLOP/s (a multiply-add counts as 2 operations; for int, billions of integer operations per second)
+       of n x n x n products, for the triple loop (i, j, k order, C(i,j) += A(i,k)*B(k,j), all row-major) and gemm()
+       with each micro-kernel. The triple loop is only run up to n = 1024 (or the n given on the command line), as it
+       takes minutes beyond
+    3. THREADS: gemm() on 1, 2, 4, ... threads, up to the number of OpenMP threads, for n = 2048
+The program exits with a non-zero status if any check fails.
+
+Compile with:
+g++ -std=c++17 -O3 -fopenmp -o gemm_bench gemm_bench.cpp
+(no -march flag is needed: the AVX2 and AVX-512 kernels are compiled for their instruction sets in any case, and chosen
+at run time)
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <type_traits>
+#include "gemm.h"
+
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point t_start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+vector<SimdLevel> supported_levels() {
+    vector<SimdLevel> levels = {SimdLevel::Generic};
+    if (best_simd_level() >= SimdLevel::Avx2) levels.push_back(SimdLevel::Avx2);
+    if (best_simd_level() >= SimdLevel::Avx512) levels.push_back(SimdLevel::Avx512);
+    return levels;
+}
+
+// small values, so that the int products cannot overflow
+template <typename T, Layout L>
+void randomize(MatrixView<T, L> a, mt19937& rng) {
+    uniform_int_distribution<int> dist(-8, 8);
+    for (size_t i=0;i<a.rows();i++) {
+        for (size_t j=0;j<a.cols();j++) a(i, j) = is_integral<T>::value ? T(dist(rng)) : T(dist(rng))/T(8) + T(0.01); }
+}
+
+// the naive triple loop
+template <typename T>
+void naive_multiply(const DenseMatrix<T>& a, const DenseMatrix<T>& b, DenseMatrix<T>& c) {
+    const size_t m = a.rows(), n = b.cols(), depth = a.cols();
+    for (size_t i=0;i<m;i++) {
+        for (size_t j=0;j<n;j++) {
+            T s = T(0);
+            for (size_t k=0;k<depth;k++) s += a(i, k)*b(k, j);
+            c(i, j) = s; } }
+}
+
+template <typename T, Layout LA, Layout LB, Layout LC>
+bool check_case(size_t m, size_t n, size_t depth, SimdLevel level, mt19937& rng) {
+    typedef typename conditional<is_integral<T>::value, long long, long double>::type Wide;
+    // A, B and C are blocks of larger matrices, at an offset
+    DenseMatrix<T, LA> a_full(m + 3, depth + 5);
+    DenseMatrix<T, LB> b_full(depth + 2, n + 7);
+    DenseMatrix<T, LC> c_full(m + 4, n + 1);
+    const MatrixView<T, LA> a = a_full.block(1, 2, m, depth);
+    const MatrixView<T, LB> b = b_full.block(2, 3, depth, n);
+    const MatrixView<T, LC> c = c_full.block(3, 1, m, n);
+    randomize(a, rng);
+    randomize(b, rng);
+    randomize(c_full.view(), rng);
+    const DenseMatrix<T, LC> c_before(c_full);
+    const T alpha = T(2), beta = is_integral<T>::value ? T(-3) : T(0.5);
+    gemm(alpha, a, b, beta, c, level);
+
+    const Wide eps = is_integral<T>::value ? Wide(0) : Wide(numeric_limits<T>::epsilon());
+    for (size_t i=0;i<m+4;i++) {
+        for (size_t j=0;j<n+1;j++) {
+            const bool inside = i >= 3 && i < 3 + m && j >= 1 && j < 1 + n;
+            if (!inside) { // the elements around the block are unchanged
+                if (c_full(i, j) != c_before(i, j)) return false;
+                continue; }
+            Wide exact = Wide(beta)*Wide(c_before(i, j)), magnitude = fabsl((long double)(exact));
+            for (size_t k=0;k<depth;k++) {
+                const Wide p = Wide(alpha)*Wide(a(i - 3, k))*Wide(b(k, j - 1));
+                exact += p;
+                magnitude += fabsl((long double)(p)); }
+            const long double error = fabsl((long double)(Wide(c_full(i, j)) - exact));
+            if (error > (long double)(2*(depth + 2)*eps)*magnitude) return false; } }
+    return true;
+}
+
+template <typename T>
+bool check_type(const char* name, mt19937& rng) {
+    const size_t sizes[][3] = {{1, 1, 1}, {7, 5, 3}, {37, 53, 71}, {130, 257, 300}, {13, 2100, 20}, {300, 40, 600}};
+    bool all_ok = true;
+    for (SimdLevel level: supported_levels()) {
+        bool ok = true;
+        for (const auto& s: sizes) {
+            ok = ok && check_case<T, Layout::RowMajor, Layout::RowMajor, Layout::RowMajor>(s[0], s[1], s[2], level, rng);
+            ok = ok && check_case<T, Layout::ColMajor, Layout::RowMajor, Layout::ColMajor>(s[0], s[1], s[2], level, rng);
+            ok = ok && check_case<T, Layout::RowMajor, Layout::ColMajor, Layout::RowMajor>(s[0], s[1], s[2], level, rng); }
+        cout << setw(8) << name << setw(10) << simd_level_name(level) << "   " << (ok ? "correct" : "WRONG") << endl;
+        all_ok = all_ok && ok; }
+    return all_ok;
+}
+
+// seconds per call of f, repeated for at least 0.2 s
+template <typename F>
+double time_per_call(F f) {
+    int reps = 0;
+    auto t_start = chrono::steady_clock::now();
+    do {
+        f();
+        reps++;
+    } while (seconds_since(t_start) < 0.2);
+    return seconds_since(t_start)/reps;
+}
+
+template <typename T>
+bool benchmark_type(const char* name, size_t naive_max, mt19937& rng) {
+    const vector<SimdLevel> levels = supported_levels();
+    cout << "\n" << name << " (GFLOP/s)" << endl;
+    cout << setw(8) << "n" << setw(12) << "naive";
+    for (SimdLevel level: levels) cout << setw(12) << simd_level_name(level);
+    cout << setw(16) << "best/naive" << endl;
+    bool all_ok = true;
+    for (size_t n: {64, 128, 256, 512, 1024, 2048}) {
+        DenseMatrix<T> a(n, n), b(n, n), c(n, n), c_naive(n, n);
+        randomize(a.view(), rng);
+        randomize(b.view(), rng);
+        const double flops = 2.0*double(n)*double(n)*double(n);
+        double t_naive = 0.;
+        cout << setw(8) << n << fixed << setprecision(2);
+        if (n <= naive_max) {
+            t_naive = time_per_call([&] { naive_multiply(a, b, c_naive); });
+            cout << setw(12) << flops/t_naive/1.0e9;
+        } else {
+            cout << setw(12) << "-"; }
+        double t_best = numeric_limits<double>::max();
+        for (SimdLevel level: levels) {
+            const double t = time_per_call([&] { gemm(T(1), a.view(), b.view(), T(0), c.view(), level); });
+            t_best = min(t_best, t);
+            cout << setw(12) << flops/t/1.0e9;
+            if (n <= naive_max) { // the same sums in a different order: exact for int, close for float and double
+                for (size_t i=0;i<n;i+=n/16) {
+                    for (size_t j=0;j<n;j+=n/16) {
+                        const double d = fabs(double(c(i, j)) - double(c_naive(i, j)));
+                        if (d > 1.0e-3*(1.0 + fabs(double(c_naive(i, j))))) all_ok = false; } } } }
+        if (n <= naive_max) { cout << setw(15) << setprecision(1) << t_naive/t_best << "x"; }
+        cout << endl;
+        cout.unsetf(ios::fixed); }
+    return all_ok;
+}
+
+int main (int argc, char *argv[]) {
+
+    const size_t naive_max = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1024;
+    mt19937 rng(42);
+    bool all_ok = true;
+
+    cout << "best SIMD level of this CPU: " << simd_level_name(best_simd_level()) << endl;
+    cout << "\nCORRECTNESS" << endl;
+    all_ok = check_type<float>("float", rng) && all_ok;
+    all_ok = check_type<double>("double", rng) && all_ok;
+    all_ok = check_type<int32_t>("int", rng) && all_ok;
+
+    cout << "\nPERFORMANCE (1 thread)" << endl;
+#ifdef _OPENMP
+    const int max_threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+#endif
+    all_ok = benchmark_type<float>("float", naive_max, rng) && all_ok;
+    all_ok = benchmark_type<double>("double", naive_max, rng) && all_ok;
+    all_ok = benchmark_type<int32_t>("int", naive_max, rng) && all_ok;
+
+#ifdef _OPENMP
+    cout << "\nTHREADS: double, n = 2048, " << simd_level_name(best_simd_level()) << " kernel" << endl;
+    cout << setw(8) << "threads" << setw(12) << "GFLOP/s" << setw(14) << "efficiency" << endl;
+    {
+    const size_t n = 2048;
+    DenseMatrix<double> a(n, n), b(n, n), c(n, n);
+    randomize(a.view(), rng);
+    randomize(b.view(), rng);
+    const double flops = 2.0*double(n)*double(n)*double(n);
+    double gflops_1 = 0.;
+    for (int threads=1;threads<=max_threads;threads*=2) {
+        omp_set_num_threads(threads);
+        const double gflops = flops/time_per_call([&] { gemm(1.0, a.view(), b.view(), 0.0, c.view()); })/1.0e9;
+        if (threads == 1) gflops_1 = gflops;
+        cout << setw(8) << threads << fixed << setprecision(2) << setw(12) << gflops << setprecision(0) << setw(13) \
+             << 100.0*gflops/(threads*gflops_1) << "%" << endl;
+        cout.unsetf(ios::fixed); }
+    omp_set_num_threads(max_threads);
+    }
+#endif
+
+    cout << "\nresults " << (all_ok ? "correct" : "WRONG") << endl;
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,284 @@
+/*
+NodePool: a slab allocator for the fixed-size nodes of linked data structures, and allocators that use it
+
+A linked list allocates one node per element with new (i.e. malloc), and frees it with delete. malloc must handle
+requests of any size from any thread, so it is a lot of work for what is always the same small request, and the nodes
+end up scattered over the heap. A NODE POOL exploits the fact that all of the nodes have the same size:
+    - nodes are carved out of large BLOCKS (slabs) of memory, obtained from operator new one block at a time, so there
+      is one malloc call per (by default) 1024 nodes, and consecutive nodes are next to each other in memory
+    - a freed node is pushed onto a FREE LIST, and the next allocation pops it again: both are a couple of pointer
+      moves. The free list is INTRUSIVE: the "next" pointer of a free node is stored in the node's own (unused) memory,
+      so the free list costs no extra memory
+    - the blocks are released all at once when the pool is destroyed (or release() is called), rather than one node at
+      a time
+Nodes are only ever returned to the pool, not to the operating system, so the pool's memory is the peak number of
+nodes in use.
+
+A NodePool is not thread-safe, and is meant to be owned by one data structure (or shared by several used by the same
+thread). For data structures shared between threads, or nodes allocated on one thread and freed on another, the
+SharedNodePool keeps a CACHE of free nodes per thread, so that most allocations and deallocations do not need a lock,
+and moves nodes between the thread caches and a central pool protected by a mutex in batches.
+
+PoolAllocator<T> and CachedPoolAllocator<T> make the pools usable wherever a standard allocator is expected, e.g. as
+the Alloc parameter of the List, Stack and Queue of brief_examples/stack_and_queue.cpp, or of std::list:
+    - PoolAllocator<T>: each allocator constructed from scratch creates its own PoolGroup, which is shared (reference
+      counted) by its copies, and destroyed together with the last of them. So a List<PoolAllocator<Node>> allocates its
+      nodes from its own pool, which is released in bulk when the List is destroyed. The group holds one NodePool per
+      node size, created on first use, so that REBOUND copies (std::list<T, PoolAllocator<T>> rebinds its allocator to
+      its node type) share the group too: PoolAllocator<T>(PoolAllocator<U>(a)) == a, as the standard requires. Moving
+      an allocator copies it, so that a moved-from container can still allocate, from the same pools
+    - CachedPoolAllocator<T>: all allocators for the same node size share one SharedNodePool, via the calling thread's
+      cache
+Requests for more than one object at a time (which linked structures never make) are passed on to operator new.
+*/
+
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <new>
+#include <cstddef>
+
+template <std::size_t NodeSize, std::size_t Align = alignof(std::max_align_t)>
+class NodePool {
+
+    static_assert(Align <= alignof(std::max_align_t), "error in NodePool: over-aligned nodes are not supported");
+
+    // a node slot holds either a node, or (while the slot is free) the pointer to the next free slot
+    union Slot {
+        Slot* next;
+        alignas(Align) unsigned char storage[NodeSize];
+    };
+
+    // the blocks are themselves kept in an intrusive list, through their first slot
+    Slot* blocks = nullptr;
+    Slot* free_list = nullptr;
+    Slot* bump = nullptr;     // the next never-used slot of the newest block
+    Slot* bump_end = nullptr;
+    std::size_t nodes_per_block;
+    std::size_t n_blocks = 0;
+
+    void new_block() {
+        Slot* block = static_cast<Slot*>(::operator new((nodes_per_block+1)*sizeof(Slot)));
+        block->next = blocks;
+        blocks = block;
+        bump = block + 1;
+        bump_end = block + 1 + nodes_per_block;
+        n_blocks++;
+    }
+
+    public:
+
+    explicit NodePool(std::size_t nodes_per_block=1024) : nodes_per_block(nodes_per_block) {}
+
+    ~NodePool() { release(); }
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    static constexpr std::size_t node_size() { return sizeof(Slot); }
+
+    void* allocate() {
+        if (free_list != nullptr) {
+            Slot* slot = free_list;
+            free_list = slot->next;
+            return slot; }
+        if (bump == bump_end) new_block();
+        return bump++;
+    }
+
+    void deallocate(void* p) {
+        Slot* slot = static_cast<Slot*>(p);
+        slot->next = free_list;
+        free_list = slot;
+    }
+
+    /* give the memory of ALL nodes back to the operating system, in one operator delete per block. Any nodes still in
+       use become invalid, and their destructors are not run */
+    void release() {
+        while (blocks != nullptr) {
+            Slot* next = blocks->next;
+            ::operator delete(blocks);
+            blocks = next; }
+        free_list = nullptr;
+        bump = nullptr;
+        bump_end = nullptr;
+        n_blocks = 0;
+    }
+
+    std::size_t bytes_reserved() const { return n_blocks*(nodes_per_block+1)*sizeof(Slot); }
+};
+
+template <std::size_t NodeSize, std::size_t Align = alignof(std::max_align_t)>
+class SharedNodePool {
+
+    static const std::size_t batch_size = 64; // nodes moved between a thread's cache and the central pool at a time
+
+    struct FreeNode { FreeNode* next; };
+
+    std::mutex m;
+    NodePool<(NodeSize > sizeof(FreeNode) ? NodeSize : sizeof(FreeNode)), Align> central;
+
+    // the free nodes cached by one thread. When the thread exits, they go back to the central pool
+    struct ThreadCache {
+        FreeNode* list = nullptr;
+        std::size_t count = 0;
+        ~ThreadCache() {
+            SharedNodePool& pool = instance();
+            std::lock_guard<std::mutex> lock(pool.m);
+            while (list != nullptr) {
+                FreeNode* next = list->next;
+                pool.central.deallocate(list);
+                list = next; }
+        }
+    };
+
+    static ThreadCache& cache() {
+        static thread_local ThreadCache c;
+        return c;
+    }
+
+    SharedNodePool() {}
+
+    public:
+
+    // one pool per node size and alignment, for the whole program. It is never destroyed, because thread caches may
+    // still return their nodes to it during program exit
+    static SharedNodePool& instance() {
+        static SharedNodePool* pool = new SharedNodePool;
+        return *pool;
+    }
+
+    void* allocate() {
+        ThreadCache& c = cache();
+        if (c.list == nullptr) { // refill the cache with a batch from the central pool
+            std::lock_guard<std::mutex> lock(m);
+            for (std::size_t i=0;i<batch_size;i++) {
+                FreeNode* node = static_cast<FreeNode*>(central.allocate());
+                node->next = c.list;
+                c.list = node; }
+            c.count = batch_size; }
+        FreeNode* node = c.list;
+        c.list = node->next;
+        c.count--;
+        return node;
+    }
+
+    void deallocate(void* p) {
+        ThreadCache& c = cache();
+        FreeNode* node = static_cast<FreeNode*>(p);
+        node->next = c.list;
+        c.list = node;
+        c.count++;
+        if (c.count >= 2*batch_size) { // the cache is too big: return a batch to the central pool
+            std::lock_guard<std::mutex> lock(m);
+            for (std::size_t i=0;i<batch_size;i++) {
+                FreeNode* returned = c.list;
+                c.list = returned->next;
+                central.deallocate(returned); }
+            c.count -= batch_size; }
+    }
+};
+
+// the pools of a PoolAllocator and of its copies, one per node size and alignment. Not thread-safe, like NodePool
+class PoolGroup {
+
+    struct Entry {
+        std::size_t size;
+        std::size_t align;
+        std::shared_ptr<void> pool;
+    };
+
+    std::vector<Entry> entries;
+    std::size_t nodes_per_block;
+
+    public:
+
+    explicit PoolGroup(std::size_t nodes_per_block) : nodes_per_block(nodes_per_block) {}
+
+    PoolGroup(const PoolGroup&) = delete;
+    PoolGroup& operator=(const PoolGroup&) = delete;
+
+    template <std::size_t NodeSize, std::size_t Align>
+    NodePool<NodeSize, Align>* get() {
+        for (const Entry& e: entries) {
+            if (e.size == NodeSize && e.align == Align) return static_cast<NodePool<NodeSize, Align>*>(e.pool.get()); }
+        std::shared_ptr<NodePool<NodeSize, Align>> pool = std::make_shared<NodePool<NodeSize, Align>>(nodes_per_block);
+        entries.push_back(Entry{NodeSize, Align, pool});
+        return pool.get();
+    }
+};
+
+template <typename T>
+class PoolAllocator {
+
+    template <typename U> friend class PoolAllocator;
+
+    typedef NodePool<sizeof(T), alignof(T)> Pool;
+    std::shared_ptr<PoolGroup> group;
+    Pool* pool; // owned by the group
+
+    public:
+
+    typedef T value_type;
+
+    explicit PoolAllocator(std::size_t nodes_per_block=1024)
+        : group(std::make_shared<PoolGroup>(nodes_per_block)), pool(group->get<sizeof(T), alignof(T)>()) {}
+
+    // a rebound copy (e.g. std::list<T> allocates its own node type rather than T) uses the group's pool of its node size
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : group(other.group), pool(group->get<sizeof(T), alignof(T)>()) {}
+
+    /* user-declared copy operations, so that there are no implicit move operations: a move would leave the source with
+       a null group, and a moved-from container would crash on its next allocation */
+    PoolAllocator(const PoolAllocator&) = default;
+    PoolAllocator& operator=(const PoolAllocator&) = default;
+
+    T* allocate(std::size_t n) {
+        if (n == 1) return static_cast<T*>(pool->allocate());
+        return static_cast<T*>(::operator new(n*sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        if (n == 1) { pool->deallocate(p); } else { ::operator delete(p); }
+    }
+
+    std::size_t bytes_reserved() const { return pool->bytes_reserved(); }
+
+    // memory from one allocator can be freed by another (after rebinding) only if they share the group
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& rhs) const { return group == rhs.group; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& rhs) const { return group != rhs.group; }
+};
+
+template <typename T>
+class CachedPoolAllocator {
+
+    typedef SharedNodePool<sizeof(T), alignof(T)> Pool;
+
+    public:
+
+    typedef T value_type;
+
+    CachedPoolAllocator() {}
+
+    template <typename U>
+    CachedPoolAllocator(const CachedPoolAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        if (n == 1) return static_cast<T*>(Pool::instance().allocate());
+        return static_cast<T*>(::operator new(n*sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        if (n == 1) { Pool::instance().deallocate(p); } else { ::operator delete(p); }
+    }
+
+    bool operator==(const CachedPoolAllocator&) const { return true; }
+    bool operator!=(const CachedPoolAllocator&) const { return false; }
+};
+
+#endif
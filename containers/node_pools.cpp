@@ -0,0 +1,141 @@
+/*
+Benchmark of linked lists with node pools (node_pool.h) against the default allocator (new/delete, i.e. malloc/free)
+
+Three patterns, for std::list<int> with std::allocator, PoolAllocator (a NodePool owned by the list) and
+CachedPoolAllocator (a SharedNodePool shared by all lists, with a per-thread cache):
+    - BUILD, TRAVERSE, DESTROY: push_back n nodes, sum them by walking the list, and destroy the list. With the pools, the
+      nodes are next to each other in memory, so the walk runs at cache speed; with malloc, the nodes end up wherever
+      malloc finds room, which (after a while) is all over the heap
+    - CHURN: a list that stays at the same length while nodes are removed at random places and new nodes are added,
+      as in an LRU cache or an order book. Every step is one deallocation and one allocation
+    - THREADS: the build/destroy pattern on several threads at once, each with its own lists. malloc must be thread-safe
+      (glibc's uses per-thread arenas), the NodePools are private to their lists, and the SharedNodePool goes to its
+      mutex only once per 64 nodes
+To make the comparison with malloc fair, the heap is first fragmented by allocating and freeing many small objects in a
+random order, as happens in a long-running program.
+
+Compile with:
+g++ -std=c++11 -O2 -o node_pools node_pools.cpp -pthread
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <list>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include "node_pool.h"
+
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point t_start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+// allocate many small objects and free them in random order, so that malloc's free lists are shuffled
+void fragment_heap(size_t n) {
+    vector<int*> ptrs(n);
+    for (size_t i=0;i<n;i++) ptrs[i] = new int[1 + i%8];
+    shuffle(ptrs.begin(), ptrs.end(), mt19937(1));
+    for (int* p: ptrs) delete[] p;
+}
+
+template <typename ListType>
+double build_traverse_destroy(size_t n, int n_repeats, long long& checksum) {
+    auto t_start = chrono::steady_clock::now();
+    checksum = 0;
+    for (int r=0;r<n_repeats;r++) {
+        ListType l;
+        for (size_t i=0;i<n;i++) l.push_back(int(i));
+        for (int x: l) checksum += x;
+    } // the list and (for PoolAllocator) its pool are destroyed here
+    return seconds_since(t_start);
+}
+
+template <typename ListType>
+double churn(size_t length, size_t n_steps, long long& checksum) {
+    ListType l;
+    for (size_t i=0;i<length;i++) l.push_back(int(i));
+    vector<typename ListType::iterator> its;
+    for (auto it=l.begin();it!=l.end();++it) its.push_back(it);
+    mt19937 rng(7);
+    uniform_int_distribution<size_t> pick(0, length-1);
+    auto t_start = chrono::steady_clock::now();
+    for (size_t s=0;s<n_steps;s++) {
+        size_t k = pick(rng);
+        auto next = l.erase(its[k]);
+        its[k] = l.insert(next, int(s)); } // a new node in the same place
+    double t = seconds_since(t_start);
+    checksum = 0;
+    for (int x: l) checksum += x;
+    return t;
+}
+
+template <typename ListType>
+double threads_build_destroy(int n_threads, size_t n, int n_repeats) {
+    auto t_start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int t=0;t<n_threads;t++) {
+        threads.emplace_back([=]() {
+            long long checksum;
+            build_traverse_destroy<ListType>(n, n_repeats, checksum);
+        }); }
+    for (thread& t: threads) t.join();
+    return seconds_since(t_start);
+}
+
+int main () {
+
+    typedef list<int> DefaultList;
+    typedef list<int, PoolAllocator<int>> PoolList;
+    typedef list<int, CachedPoolAllocator<int>> CachedPoolList;
+
+    fragment_heap(4000000);
+
+    cout << "build, traverse and destroy a list (ns per node):" << endl;
+    cout << setw(12) << "n" << setw(16) << "std::allocator" << setw(16) << "PoolAllocator" << setw(22) \
+         << "CachedPoolAllocator" << endl;
+    for (size_t n: {1000, 100000, 10000000}) {
+        int n_repeats = int(max<size_t>(1, 10000000/n));
+        long long c1, c2, c3;
+        double t1 = build_traverse_destroy<DefaultList>(n, n_repeats, c1);
+        double t2 = build_traverse_destroy<PoolList>(n, n_repeats, c2);
+        double t3 = build_traverse_destroy<CachedPoolList>(n, n_repeats, c3);
+        if (c1 != c2 || c1 != c3) cout << "error: the lists have different contents" << endl;
+        const double scale = 1.0e9/(double(n)*n_repeats);
+        cout << setw(12) << n << fixed << setprecision(1) << setw(16) << t1*scale << setw(16) << t2*scale << setw(22) \
+             << t3*scale << endl;
+        cout.unsetf(ios::fixed); }
+
+    cout << "\nchurn: erase and insert at random places in a list of fixed length (ns per step):" << endl;
+    cout << setw(12) << "length" << setw(16) << "std::allocator" << setw(16) << "PoolAllocator" << setw(22) \
+         << "CachedPoolAllocator" << endl;
+    for (size_t length: {1000, 1000000}) {
+        const size_t n_steps = 5000000;
+        long long c1, c2, c3;
+        double t1 = churn<DefaultList>(length, n_steps, c1);
+        double t2 = churn<PoolList>(length, n_steps, c2);
+        double t3 = churn<CachedPoolList>(length, n_steps, c3);
+        if (c1 != c2 || c1 != c3) cout << "error: the lists have different contents" << endl;
+        const double scale = 1.0e9/double(n_steps);
+        cout << setw(12) << length << fixed << setprecision(1) << setw(16) << t1*scale << setw(16) << t2*scale \
+             << setw(22) << t3*scale << endl;
+        cout.unsetf(ios::fixed); }
+
+    cout << "\nbuild and destroy lists of 100000 nodes on several threads at once (total time, ms):" << endl;
+    cout << setw(12) << "threads" << setw(16) << "std::allocator" << setw(16) << "PoolAllocator" << setw(22) \
+         << "CachedPoolAllocator" << endl;
+    const int max_threads = max(2u, thread::hardware_concurrency());
+    for (int n_threads=1;n_threads<=max_threads;n_threads*=2) {
+        double t1 = threads_build_destroy<DefaultList>(n_threads, 100000, 50);
+        double t2 = threads_build_destroy<PoolList>(n_threads, 100000, 50);
+        double t3 = threads_build_destroy<CachedPoolList>(n_threads, 100000, 50);
+        cout << setw(12) << n_threads << fixed << setprecision(1) << setw(16) << 1.0e3*t1 << setw(16) << 1.0e3*t2 \
+             << setw(22) << 1.0e3*t3 << endl;
+        cout.unsetf(ios::fixed); }
+
+    return 0;
+}
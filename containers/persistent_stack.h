@@ -0,0 +1,141 @@
+/*
+PersistentStack<T>: an immutable stack whose versions share their nodes
+
+The Stack of brief_examples/stack_and_queue.cpp is MUTABLE: push and pop change the stack in place, so keeping an
+earlier version of the stack around (a SNAPSHOT, e.g. to return to in a backtracking search) needs a deep copy, which
+costs O(n) time and memory. A PERSISTENT data structure never changes: every operation returns a NEW VERSION, and
+leaves the old version intact. For a stack this is cheap, because push and pop only touch the top:
+    - push(x) creates one node holding x, whose next pointer is the top node of the old version. The new version SHARES
+      all of the old version's nodes (STRUCTURAL SHARING), so push is O(1)
+    - pop() returns the version that starts at the next node: O(1), and no node is changed or freed
+    - a copy of a version is just another pointer to its top node: O(1)
+The versions form a tree of nodes, in which every node may be the next node of several others, so a node must be freed
+exactly when the last version (or node) that refers to it goes away. Each node has a REFERENCE COUNT: the number of
+stack objects and nodes pointing to it. Copying a version increments the count of its top node, destroying one
+decrements it, and when a count reaches zero the node is freed and the count of its next node is decremented in turn.
+This is done in a loop rather than recursively, so that dropping the last version of a stack of millions of elements
+cannot overflow the call stack (as a chain of std::shared_ptr destructors would).
+
+The reference counts are atomic, so different threads may hold versions that share nodes (e.g. snapshots handed to
+other threads); the nodes themselves are never modified after construction, so reading them needs no synchronisation.
+*/
+
+#ifndef PERSISTENT_STACK_H
+#define PERSISTENT_STACK_H
+
+#include <atomic>
+#include <utility>
+#include <iterator>
+#include <stdexcept>
+#include <cstddef>
+
+template <typename T>
+class PersistentStack {
+
+    struct Node {
+        T value;
+        const Node* next;
+        std::size_t size; // the number of elements from this node down
+        mutable std::atomic<std::size_t> refcount;
+
+        template <typename... Args>
+        Node(const Node* next, Args&&... args) :
+            value(std::forward<Args>(args)...), next(next), size(next ? next->size+1 : 1), refcount(1) {}
+    };
+
+    const Node* top_node = nullptr;
+
+    explicit PersistentStack(const Node* node) : top_node(node) {}
+
+    static const Node* acquire(const Node* node) {
+        if (node) node->refcount.fetch_add(1, std::memory_order_relaxed);
+        return node;
+    }
+
+    // drop one reference to node, freeing it and then (iteratively) every node below that is no longer referred to
+    static void release(const Node* node) {
+        while (node && node->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            const Node* next = node->next;
+            delete node;
+            node = next; }
+    }
+
+    public:
+
+    class const_iterator {
+        const Node* node;
+
+        public:
+
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        explicit const_iterator(const Node* node=nullptr) : node(node) {}
+        const T& operator*() const { return node->value; }
+        const T* operator->() const { return &node->value; }
+        const_iterator& operator++() { node = node->next; return *this; }
+        const_iterator operator++(int) { const_iterator old = *this; node = node->next; return old; }
+        bool operator==(const const_iterator& rhs) const { return node == rhs.node; }
+        bool operator!=(const const_iterator& rhs) const { return node != rhs.node; }
+    };
+
+    PersistentStack() {}
+
+    ~PersistentStack() { release(top_node); }
+
+    PersistentStack(const PersistentStack& rhs) : top_node(acquire(rhs.top_node)) {}
+
+    PersistentStack(PersistentStack&& rhs) noexcept : top_node(rhs.top_node) { rhs.top_node = nullptr; }
+
+    PersistentStack& operator=(const PersistentStack& rhs) {
+        const Node* old = top_node;
+        top_node = acquire(rhs.top_node); // acquire before release, in case of self-assignment
+        release(old);
+        return *this;
+    }
+
+    PersistentStack& operator=(PersistentStack&& rhs) noexcept {
+        if (this != &rhs) {
+            release(top_node);
+            top_node = rhs.top_node;
+            rhs.top_node = nullptr; }
+        return *this;
+    }
+
+    bool empty() const { return top_node == nullptr; }
+    std::size_t size() const { return top_node ? top_node->size : 0; }
+
+    // the new version with an element constructed from args on top. This version is unchanged
+    template <typename... Args>
+    PersistentStack push(Args&&... args) const {
+        const Node* next = acquire(top_node); // the new node refers to our top node
+        try {
+            return PersistentStack(new Node(next, std::forward<Args>(args)...));
+        } catch (...) {
+            release(next);
+            throw; }
+    }
+
+    // the version below the top element. This version is unchanged
+    PersistentStack pop() const {
+        if (top_node == nullptr) throw std::runtime_error("error in pop(): the PersistentStack is empty");
+        return PersistentStack(acquire(top_node->next));
+    }
+
+    const T& top() const {
+        if (top_node == nullptr) throw std::runtime_error("error in top(): the PersistentStack is empty");
+        return top_node->value;
+    }
+
+    // true if the two versions are the same (share their top node), which is much cheaper than comparing the elements
+    bool same_version(const PersistentStack& rhs) const { return top_node == rhs.top_node; }
+
+    // from the top element down
+    const_iterator begin() const { return const_iterator(top_node); }
+    const_iterator end() const { return const_iterator(); }
+};
+
+#endif
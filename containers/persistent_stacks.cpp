@@ -0,0 +1,142 @@
+/*
+Snapshots of a stack in a backtracking search: PersistentStack (persistent_stack.h) against deep copies
+
+A backtracking search keeps its current state in a stack (the choices made so far), and must be able to go back to the
+state at any earlier decision point. The simplest correct way is to take a SNAPSHOT (a copy) of the state at each
+decision point, and to explore each choice from its own copy. With a mutable stack, each snapshot is a deep copy, whose
+cost grows with the length of the stack, including any long history underneath the search (e.g. the moves of the game
+so far). With a PersistentStack, a snapshot is a new version that shares all of its nodes with the previous one, at a
+cost of O(1).
+We count the solutions of the N-queens problem (place N queens on an N x N board so that no two attack each other),
+where the stack holds the column of the queen in each row so far, on top of a "history" of h earlier entries, and
+compare
+    - std::vector<int>, copied for every choice (O(h + depth) per snapshot)
+    - ArrayStack<int> (array_stack.h), copied for every choice
+    - PersistentStack<int>, a new version for every choice (O(1) per snapshot)
+We also check that the versions of a PersistentStack are independent, and that every node is freed when the last version
+that uses it is dropped, even for a stack of 10 million elements.
+
+Compile with:
+g++ -std=c++11 -O2 -o persistent_stacks persistent_stacks.cpp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include "persistent_stack.h"
+#include "array_stack.h"
+
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point t_start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+// counts its live objects, to check that the PersistentStack frees every node
+struct Counted {
+    static long long n_live;
+    int value;
+    Counted(int value) : value(value) { n_live++; }
+    Counted(const Counted& rhs) : value(rhs.value) { n_live++; }
+    ~Counted() { n_live--; }
+};
+long long Counted::n_live = 0;
+
+// can a queen go in column col of the next row, given the columns of the queens in the rows so far (the top `rows`
+// elements of the stack, from the most recent row)?
+template <typename Iterator>
+bool safe(Iterator it, int rows, int col) {
+    for (int d=1;d<=rows;d++,++it) {
+        int c = *it;
+        if (c == col || abs(c - col) == d) return false; }
+    return true;
+}
+
+long long solve_vector(vector<int> placed, int row, int n) {
+    if (row == n) return 1;
+    long long count = 0;
+    for (int col=0;col<n;col++) {
+        if (!safe(placed.rbegin(), row, col)) continue;
+        vector<int> snapshot = placed; // the state for this choice: a deep copy
+        snapshot.push_back(col);
+        count += solve_vector(snapshot, row+1, n); }
+    return count;
+}
+
+// ArrayStack has no iterators: look at the top rows elements through a copy of them
+long long solve_array_stack(const ArrayStack<int>& placed, const vector<int>& rows_so_far, int row, int n) {
+    if (row == n) return 1;
+    long long count = 0;
+    for (int col=0;col<n;col++) {
+        if (!safe(rows_so_far.rbegin(), row, col)) continue;
+        ArrayStack<int> snapshot = placed; // a deep copy
+        snapshot.push(col);
+        vector<int> rows = rows_so_far;
+        rows.push_back(col);
+        count += solve_array_stack(snapshot, rows, row+1, n); }
+    return count;
+}
+
+long long solve_persistent(const PersistentStack<int>& placed, int row, int n) {
+    if (row == n) return 1;
+    long long count = 0;
+    for (int col=0;col<n;col++) {
+        if (!safe(placed.begin(), row, col)) continue;
+        count += solve_persistent(placed.push(col), row+1, n); } // the new version shares all of placed's nodes
+    return count;
+}
+
+int main () {
+
+    // the versions of a PersistentStack are independent
+    {
+    PersistentStack<Counted> v0;
+    PersistentStack<Counted> v1 = v0.push(1);
+    PersistentStack<Counted> v2 = v1.push(2);
+    PersistentStack<Counted> v3 = v1.push(3); // a branch: v2 and v3 share the node of 1
+    PersistentStack<Counted> v4 = v2.pop();   // the same version as v1
+    cout << "v2: top " << v2.top().value << ", size " << v2.size() << "; v3: top " << v3.top().value << ", size " \
+         << v3.size() << "; v4 same version as v1: " << (v4.same_version(v1) ? "yes" : "no") << "; live nodes: " \
+         << Counted::n_live << endl;
+    }
+    cout << "live nodes after the versions are dropped: " << Counted::n_live << endl;
+
+    // dropping a very long stack frees its nodes iteratively, without a deep recursion
+    {
+    PersistentStack<Counted> s;
+    for (int i=0;i<10000000;i++) s = s.push(i);
+    PersistentStack<Counted> snapshot = s.pop().pop();
+    cout << "long stack: " << s.size() << " elements, snapshot of " << snapshot.size() << ", live nodes: " \
+         << Counted::n_live << endl;
+    }
+    cout << "live nodes after the long stack is dropped: " << Counted::n_live << endl;
+
+    // the N-queens search with snapshots
+    const int n = 10;
+    cout << "\n" << n << "-queens: time to count the solutions (s), with h history entries under the search" << endl;
+    cout << setw(10) << "h" << setw(12) << "solutions" << setw(16) << "vector copy" << setw(18) << "ArrayStack copy" \
+         << setw(18) << "PersistentStack" << endl;
+    for (int h: {0, 100, 10000}) {
+        vector<int> history(h, -1000); // far from every column, so never attacks
+        ArrayStack<int> history_stack;
+        PersistentStack<int> history_persistent;
+        for (int i=0;i<h;i++) { history_stack.push(-1000); history_persistent = history_persistent.push(-1000); }
+
+        auto t_start = chrono::steady_clock::now();
+        long long s1 = solve_vector(history, 0, n);
+        double t1 = seconds_since(t_start);
+        t_start = chrono::steady_clock::now();
+        long long s2 = solve_array_stack(history_stack, vector<int>(), 0, n);
+        double t2 = seconds_since(t_start);
+        t_start = chrono::steady_clock::now();
+        long long s3 = solve_persistent(history_persistent, 0, n);
+        double t3 = seconds_since(t_start);
+        if (s1 != s2 || s1 != s3) cout << "error: different numbers of solutions" << endl;
+        cout << setw(10) << h << setw(12) << s1 << fixed << setprecision(4) << setw(16) << t1 << setw(18) << t2 \
+             << setw(18) << t3 << endl;
+        cout.unsetf(ios::fixed); }
+
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*
+Benchmark of the priority queues of priority_queues.h against std::priority_queue
+
+Three workloads:
+    1. push n random ints, then pop them all (a heap sort), for std::priority_queue (a binary heap), DaryHeap with
+       D = 2, 4 and 8, IndexedHeap, and PairingHeap with new/delete and with a CachedPoolAllocator (node_pool.h) for its
+       nodes. We check that the elements come out in order
+    2. Dijkstra's shortest paths on a random graph of V vertices and 8V edges, which is dominated by the priority queue:
+        - with std::priority_queue and DaryHeap<4>, which have no decrease-key, a vertex whose distance improves is pushed
+          again, and the stale copies are skipped when they are popped ("lazy deletion")
+        - with IndexedHeap (D = 2 and 4) and PairingHeap (both allocators), each vertex is in the queue at most once, and
+          its element is updated with decrease_key
+       We check that all the versions find the same distances
+    3. merging: start from k heaps of m elements each, and repeatedly merge them two by two until one is left (timed),
+       then pop everything (timed separately). A DaryHeap merge costs O(size of the smaller heap) at least, a PairingHeap
+       merge O(1), but the PairingHeap then has to do the work of sorting out the merged trees in its pops
+
+Compile with:
+g++ -std=c++11 -O2 -o priority_queues priority_queues.cpp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <random>
+#include <chrono>
+#include <limits>
+#include "priority_queues.h"
+#include "node_pool.h"
+
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point t_start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+// std::priority_queue is a max-heap with top() and a void pop(): adapt it to the interface of priority_queues.h
+template <typename T>
+struct StdHeap {
+    priority_queue<T, vector<T>, greater<T>> q;
+    size_t size() const { return q.size(); }
+    bool empty() const { return q.empty(); }
+    void push(T x) { q.push(x); }
+    const T& top() const { return q.top(); }
+    T pop() { T x = q.top(); q.pop(); return x; }
+};
+
+// 1. heap sort
+template <typename Heap>
+double time_sort(const vector<int>& values, bool& ok) {
+    Heap heap;
+    auto t_start = chrono::steady_clock::now();
+    for (int x: values) heap.push(x);
+    int previous = numeric_limits<int>::min();
+    ok = true;
+    while (!heap.empty()) {
+        int x = heap.pop();
+        if (x < previous) ok = false;
+        previous = x; }
+    return seconds_since(t_start);
+}
+
+// 2. Dijkstra's algorithm
+struct Graph {
+    vector<size_t> first_edge; // the edges of vertex v are [first_edge[v], first_edge[v+1])
+    vector<int> target;
+    vector<long long> weight;
+};
+
+Graph random_graph(int n_vertices, int degree, mt19937& rng) {
+    Graph g;
+    uniform_int_distribution<int> vertex(0, n_vertices-1);
+    uniform_int_distribution<long long> weight(1, 1000000);
+    for (int v=0;v<n_vertices;v++) {
+        g.first_edge.push_back(g.target.size());
+        if (v+1 < n_vertices) { g.target.push_back(v+1); g.weight.push_back(weight(rng)); } // a path, so all are reached
+        for (int e=1;e<degree;e++) { g.target.push_back(vertex(rng)); g.weight.push_back(weight(rng)); } }
+    g.first_edge.push_back(g.target.size());
+    return g;
+}
+
+const long long infinity = numeric_limits<long long>::max();
+typedef pair<long long, int> DistVertex; // compared by distance first
+
+template <typename T>
+using PooledPairingHeap = PairingHeap<T, less<T>, CachedPoolAllocator<T>>;
+
+template <typename Heap>
+vector<long long> dijkstra_lazy(const Graph& g, int source, size_t& max_size) {
+    const int n = int(g.first_edge.size()) - 1;
+    vector<long long> dist(n, infinity);
+    vector<char> done(n, 0);
+    Heap heap;
+    dist[source] = 0;
+    heap.push(DistVertex(0, source));
+    max_size = 1;
+    while (!heap.empty()) {
+        const int u = heap.pop().second;
+        if (done[u]) continue; // a stale copy
+        done[u] = 1;
+        for (size_t e=g.first_edge[u];e<g.first_edge[u+1];e++) {
+            const int v = g.target[e];
+            const long long d = dist[u] + g.weight[e];
+            if (d < dist[v]) {
+                dist[v] = d;
+                heap.push(DistVertex(d, v));
+                max_size = max(max_size, heap.size()); } } }
+    return dist;
+}
+
+template <typename Heap>
+vector<long long> dijkstra_decrease_key(const Graph& g, int source, size_t& max_size) {
+    const int n = int(g.first_edge.size()) - 1;
+    vector<long long> dist(n, infinity);
+    vector<typename Heap::handle> handle(n);
+    vector<char> queued(n, 0);
+    Heap heap;
+    dist[source] = 0;
+    handle[source] = heap.push(DistVertex(0, source));
+    queued[source] = 1;
+    max_size = 1;
+    while (!heap.empty()) {
+        const int u = heap.pop().second;
+        for (size_t e=g.first_edge[u];e<g.first_edge[u+1];e++) {
+            const int v = g.target[e];
+            const long long d = dist[u] + g.weight[e];
+            if (d < dist[v]) { // never true for a vertex already popped, so its handle is never used again
+                dist[v] = d;
+                if (queued[v]) {
+                    heap.decrease_key(handle[v], DistVertex(d, v)); }
+                else {
+                    handle[v] = heap.push(DistVertex(d, v));
+                    queued[v] = 1;
+                    max_size = max(max_size, heap.size()); } } } }
+    return dist;
+}
+
+// 3. merging k heaps of m elements
+template <typename Heap>
+void time_merge(int k, int m, mt19937& rng, double& t_merge, double& t_pop, bool& ok) {
+    vector<Heap> heaps(k);
+    for (Heap& h: heaps) {
+        for (int i=0;i<m;i++) h.push(int(rng())); }
+    auto t_start = chrono::steady_clock::now();
+    for (int step=1;step<k;step*=2) {
+        for (int i=0;i+step<k;i+=2*step) heaps[i].merge(heaps[i+step]); }
+    t_merge = seconds_since(t_start);
+    ok = heaps[0].size() == size_t(k)*m;
+    t_start = chrono::steady_clock::now();
+    int previous = numeric_limits<int>::min();
+    while (!heaps[0].empty()) {
+        int x = heaps[0].pop();
+        if (x < previous) ok = false;
+        previous = x; }
+    t_pop = seconds_since(t_start);
+}
+
+int main () {
+
+    mt19937 rng(11);
+    bool all_ok = true;
+
+    cout << "push n random ints, then pop them all (ns per element)" << endl;
+    cout << setw(10) << "n" << setw(16) << "priority_queue" << setw(10) << "Dary<2>" << setw(10) << "Dary<4>" \
+         << setw(10) << "Dary<8>" << setw(10) << "Indexed" << setw(10) << "Pairing" << setw(16) << "Pairing (pool)" \
+         << endl;
+    for (size_t n: {1000, 100000, 3000000}) {
+        vector<int> values(n);
+        for (int& x: values) x = int(rng());
+        const int n_reps = int(max<size_t>(1, 1000000/n));
+        double t[7] = {0, 0, 0, 0, 0, 0, 0};
+        bool ok[7];
+        for (int r=0;r<n_reps;r++) {
+            t[0] += time_sort<StdHeap<int>>(values, ok[0]);
+            t[1] += time_sort<DaryHeap<int, 2>>(values, ok[1]);
+            t[2] += time_sort<DaryHeap<int, 4>>(values, ok[2]);
+            t[3] += time_sort<DaryHeap<int, 8>>(values, ok[3]);
+            t[4] += time_sort<IndexedHeap<int>>(values, ok[4]);
+            t[5] += time_sort<PairingHeap<int>>(values, ok[5]);
+            t[6] += time_sort<PooledPairingHeap<int>>(values, ok[6]); }
+        cout << setw(10) << n << fixed << setprecision(1);
+        for (int i=0;i<7;i++) {
+            cout << setw(i == 0 || i == 6 ? 16 : 10) << t[i]/n_reps*1.0e9/n;
+            all_ok = all_ok && ok[i]; }
+        cout << endl;
+        cout.unsetf(ios::fixed); }
+
+    cout << "\nDijkstra on a random graph with 8 edges per vertex (time in s, and the largest queue size)" << endl;
+    cout << setw(10) << "V" << setw(30) << "algorithm" << setw(10) << "time" << setw(12) << "max size" << endl;
+    for (int n_vertices: {10000, 1000000}) {
+        Graph g = random_graph(n_vertices, 8, rng);
+        vector<long long> reference;
+        auto report = [&](const char* name, vector<long long> (*algorithm)(const Graph&, int, size_t&)) {
+            size_t max_size;
+            auto t_start = chrono::steady_clock::now();
+            vector<long long> dist = algorithm(g, 0, max_size);
+            double t = seconds_since(t_start);
+            if (reference.empty()) reference = dist;
+            const bool same = dist == reference;
+            all_ok = all_ok && same;
+            cout << setw(10) << n_vertices << setw(30) << name << fixed << setprecision(4) << setw(10) << t \
+                 << setw(12) << max_size << (same ? "" : "   WRONG DISTANCES") << endl;
+            cout.unsetf(ios::fixed); };
+        report("priority_queue, lazy", dijkstra_lazy<StdHeap<DistVertex>>);
+        report("Dary<4>, lazy", dijkstra_lazy<DaryHeap<DistVertex, 4>>);
+        report("Indexed<2>, decrease-key", dijkstra_decrease_key<IndexedHeap<DistVertex, 2>>);
+        report("Indexed<4>, decrease-key", dijkstra_decrease_key<IndexedHeap<DistVertex, 4>>);
+        report("Pairing, decrease-key", dijkstra_decrease_key<PairingHeap<DistVertex>>);
+        report("Pairing (pool), decrease-key", dijkstra_decrease_key<PooledPairingHeap<DistVertex>>); }
+
+    cout << "\nmerge k heaps of m elements two by two, then pop everything (time in s)" << endl;
+    cout << setw(8) << "k" << setw(8) << "m" << setw(16) << "Dary<4> merge" << setw(10) << "pop" << setw(16) \
+         << "Pairing merge" << setw(10) << "pop" << endl;
+    for (int k: {16, 4096, 262144}) {
+        const int m = 1048576/k;
+        double t_merge[2], t_pop[2];
+        bool ok[2];
+        time_merge<DaryHeap<int, 4>>(k, m, rng, t_merge[0], t_pop[0], ok[0]);
+        time_merge<PooledPairingHeap<int>>(k, m, rng, t_merge[1], t_pop[1], ok[1]);
+        all_ok = all_ok && ok[0] && ok[1];
+        cout << setw(8) << k << setw(8) << m << fixed << setprecision(4) << setw(16) << t_merge[0] << setw(10) \
+             << t_pop[0] << setw(16) << t_merge[1] << setw(10) << t_pop[1] << endl;
+        cout.unsetf(ios::fixed); }
+
+    cout << "\nresults " << (all_ok ? "correct" : "WRONG") << endl;
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,440 @@
+/*
+Priority queues: DaryHeap<T, D>, IndexedHeap<T, D> and PairingHeap<T>
+
+A priority queue keeps a set of elements, and gives quick access to the BEST one (by default the smallest, according to
+Compare) and lets us remove it. All three classes here share the interface
+    push(x), top(), pop() (which removes the best element and returns it), size(), empty(), clear()
+and differ in what else they support and in how they are laid out in memory:
+
+    - DaryHeap<T, D>: an implicit heap in a vector, as std::priority_queue, but where every node has D children (at
+      positions D*i+1 ... D*i+D) instead of 2. With D = 4 the tree is half as deep as a binary heap, so push (which
+      moves up the tree) does half as many steps, and pop (which moves down, comparing the D children at each level)
+      does half as many steps of 4 comparisons each, on children that are next to each other in memory, usually in the
+      same cache line. Since the steps down are the cache misses in a large heap, a 4-ary heap is usually faster than a
+      binary heap. D = 2 gives a binary heap. merge(other) moves the elements of other into this heap.
+
+    - IndexedHeap<T, D>: a D-ary heap (binary by default) that also supports DECREASE-KEY: push returns a HANDLE to the
+      element, and decrease_key(h, x) replaces the element of handle h by the better element x, in O(log n), by moving it
+      up the tree. This is what Dijkstra's and Prim's algorithms need (a vertex's distance improves while it is in the
+      queue), and, with Compare = std::greater (the best element is the largest), the "maximum adjacency" ordering of
+      the Stoer-Wagner min-cut algorithm. Without decrease-key (e.g. with std::priority_queue), such algorithms push a
+      second copy of the element and skip the stale copy when it comes out, so the queue holds up to one element per
+      EDGE instead of one per vertex. The handles are indexes into a table of heap positions, which is updated at every
+      move: they stay valid until their element is popped, after which they may be reused by a later push.
+
+    - PairingHeap<T>: a heap-ordered tree of individually allocated nodes, each of which has any number of children.
+      push and merge (of two whole heaps) just LINK two trees, making the root with the worse element the first child of
+      the other root: O(1). pop removes the root and links its children in pairs, left to right, then links the pairs
+      right to left, which costs O(log n) amortized. decrease_key(h, x) cuts the subtree of h off its parent and links it
+      to the root: O(1), and o(log n) amortized in theory. The handles are pointers to the nodes, valid until their
+      element is popped. A pairing heap wins when merges are frequent (a DaryHeap merge costs O(size of the other heap)),
+      and often when decrease-keys are, but each of its pops follows pointers across the heap, so for plain push/pop
+      workloads the implicit heaps are faster. Like the List of brief_examples/stack_and_queue.cpp it takes an allocator
+      for its nodes, e.g. a CachedPoolAllocator of node_pool.h, which keeps the nodes of all the heaps of a thread close
+      together and makes push and pop cheaper.
+
+top and pop throw std::runtime_error if the heap is empty, like the containers of brief_examples/stack_and_queue.cpp, and
+so do the operations of an IndexedHeap on a handle whose element has been popped. decrease_key throws if the new element
+is worse than the old one.
+*/
+
+#ifndef PRIORITY_QUEUES_H
+#define PRIORITY_QUEUES_H
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <utility>
+#include <string>
+#include <stdexcept>
+#include <cstddef>
+
+template <typename T, std::size_t D = 4, typename Compare = std::less<T>>
+class DaryHeap {
+
+    static_assert(D >= 2, "error in DaryHeap: D must be at least 2");
+
+    std::vector<T> heap;
+    Compare before; // before(a, b): a is better than b, so a must be nearer the top
+
+    // move x up from the hole at position i
+    void sift_up(std::size_t i, T x) {
+        while (i > 0) {
+            const std::size_t parent = (i-1)/D;
+            if (!before(x, heap[parent])) break;
+            heap[i] = std::move(heap[parent]);
+            i = parent; }
+        heap[i] = std::move(x);
+    }
+
+    // move x down from the hole at position i
+    void sift_down(std::size_t i, T x) {
+        const std::size_t n = heap.size();
+        while (true) {
+            const std::size_t first_child = D*i+1;
+            if (first_child >= n) break;
+            const std::size_t last_child = first_child+D < n ? first_child+D : n;
+            std::size_t best = first_child;
+            for (std::size_t c=first_child+1;c<last_child;c++) {
+                if (before(heap[c], heap[best])) best = c; }
+            if (!before(heap[best], x)) break;
+            heap[i] = std::move(heap[best]);
+            i = best; }
+        heap[i] = std::move(x);
+    }
+
+    public:
+
+    explicit DaryHeap(const Compare& compare=Compare()) : before(compare) {}
+
+    std::size_t size() const { return heap.size(); }
+    bool empty() const { return heap.empty(); }
+    void reserve(std::size_t n) { heap.reserve(n); }
+    void clear() { heap.clear(); }
+
+    void push(T x) {
+        heap.push_back(std::move(x));
+        T y = std::move(heap.back()); // leaving a hole at the end
+        sift_up(heap.size()-1, std::move(y));
+    }
+
+    const T& top() const {
+        if (heap.empty()) throw std::runtime_error("error in top(): the DaryHeap is empty");
+        return heap[0];
+    }
+
+    /* remove the best element and return it. The last element has to be put back in the hole at the top. It came from
+       the bottom of the heap, so it usually belongs near the bottom again: rather than comparing it with the best child
+       at every level on the way down, move the hole all the way down to a leaf along the best children, and then move
+       the last element up from there, which is usually only a step or two */
+    T pop() {
+        if (heap.empty()) throw std::runtime_error("error in pop(): the DaryHeap is empty");
+        T best = std::move(heap[0]);
+        T last = std::move(heap.back());
+        heap.pop_back();
+        const std::size_t n = heap.size();
+        if (n > 0) {
+            std::size_t i = 0;
+            while (D*i+1 < n) {
+                const std::size_t first_child = D*i+1;
+                const std::size_t last_child = first_child+D < n ? first_child+D : n;
+                std::size_t best_child = first_child;
+                for (std::size_t c=first_child+1;c<last_child;c++) {
+                    if (before(heap[c], heap[best_child])) best_child = c; }
+                heap[i] = std::move(heap[best_child]);
+                i = best_child; }
+            sift_up(i, std::move(last)); }
+        return best;
+    }
+
+    /* move all the elements of other into this heap, leaving other empty. If other is small, its elements are pushed
+       one by one (O(m log n)), otherwise they are appended and the whole heap is rebuilt bottom-up (O(n + m)) */
+    void merge(DaryHeap& other) {
+        if (&other == this) return;
+        const std::size_t n = heap.size(), m = other.heap.size();
+        heap.reserve(n+m);
+        if (m < n/8) {
+            for (T& x: other.heap) push(std::move(x)); }
+        else {
+            for (T& x: other.heap) heap.push_back(std::move(x));
+            for (std::size_t i=(heap.size()+D-2)/D;i-->0;) {
+                T x = std::move(heap[i]);
+                sift_down(i, std::move(x)); } }
+        other.heap.clear();
+    }
+};
+
+template <typename T, std::size_t D = 2, typename Compare = std::less<T>>
+class IndexedHeap {
+
+    static_assert(D >= 2, "error in IndexedHeap: D must be at least 2");
+
+    struct Entry { T value; std::size_t handle; };
+
+    std::vector<Entry> heap;
+    std::vector<std::size_t> position; // position[h]: where the element of handle h is in heap, or npos if none
+    std::vector<std::size_t> free_handles;
+    Compare before;
+
+    void place(std::size_t i, Entry&& e) {
+        position[e.handle] = i;
+        heap[i] = std::move(e);
+    }
+
+    void sift_up(std::size_t i, Entry e) {
+        while (i > 0) {
+            const std::size_t parent = (i-1)/D;
+            if (!before(e.value, heap[parent].value)) break;
+            place(i, std::move(heap[parent]));
+            i = parent; }
+        place(i, std::move(e));
+    }
+
+    void sift_down(std::size_t i, Entry e) {
+        const std::size_t n = heap.size();
+        while (true) {
+            const std::size_t first_child = D*i+1;
+            if (first_child >= n) break;
+            const std::size_t last_child = first_child+D < n ? first_child+D : n;
+            std::size_t best = first_child;
+            for (std::size_t c=first_child+1;c<last_child;c++) {
+                if (before(heap[c].value, heap[best].value)) best = c; }
+            if (!before(heap[best].value, e.value)) break;
+            place(i, std::move(heap[best]));
+            i = best; }
+        place(i, std::move(e));
+    }
+
+    std::size_t checked_position(std::size_t h, const char* func) const {
+        if (h >= position.size() || position[h] == npos)
+            throw std::runtime_error(std::string("error in ") + func + "(): the handle has no element in the IndexedHeap");
+        return position[h];
+    }
+
+    public:
+
+    typedef std::size_t handle;
+    static constexpr std::size_t npos = std::size_t(-1);
+
+    explicit IndexedHeap(const Compare& compare=Compare()) : before(compare) {}
+
+    std::size_t size() const { return heap.size(); }
+    bool empty() const { return heap.empty(); }
+
+    void reserve(std::size_t n) {
+        heap.reserve(n);
+        position.reserve(n);
+    }
+
+    void clear() {
+        heap.clear();
+        position.clear();
+        free_handles.clear();
+    }
+
+    // insert x and return its handle
+    handle push(T x) {
+        handle h;
+        if (free_handles.empty()) {
+            h = position.size();
+            position.push_back(npos); }
+        else {
+            h = free_handles.back();
+            free_handles.pop_back(); }
+        heap.push_back(Entry{std::move(x), h});
+        Entry e = std::move(heap.back()); // leaving a hole at the end
+        sift_up(heap.size()-1, std::move(e));
+        return h;
+    }
+
+    const T& top() const {
+        if (heap.empty()) throw std::runtime_error("error in top(): the IndexedHeap is empty");
+        return heap[0].value;
+    }
+
+    handle top_handle() const {
+        if (heap.empty()) throw std::runtime_error("error in top_handle(): the IndexedHeap is empty");
+        return heap[0].handle;
+    }
+
+    // remove the best element and return it. Its handle becomes free
+    T pop() {
+        if (heap.empty()) throw std::runtime_error("error in pop(): the IndexedHeap is empty");
+        Entry best = std::move(heap[0]);
+        position[best.handle] = npos;
+        free_handles.push_back(best.handle);
+        Entry last = std::move(heap.back());
+        heap.pop_back();
+        if (!heap.empty()) sift_down(0, std::move(last));
+        return std::move(best.value);
+    }
+
+    // is the element of handle h still in the heap?
+    bool contains(handle h) const { return h < position.size() && position[h] != npos; }
+
+    const T& value(handle h) const { return heap[checked_position(h, "value")].value; }
+
+    // replace the element of handle h by x, which must not be worse
+    void decrease_key(handle h, T x) {
+        const std::size_t i = checked_position(h, "decrease_key");
+        if (before(heap[i].value, x))
+            throw std::runtime_error("error in decrease_key(): the new value is worse than the old one");
+        sift_up(i, Entry{std::move(x), h});
+    }
+};
+
+template <typename T, std::size_t D, typename Compare>
+constexpr std::size_t IndexedHeap<T, D, Compare>::npos;
+
+template <typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+class PairingHeap {
+
+    struct Node {
+        T value;
+        Node* child;   // the first child
+        Node* next;    // the next sibling
+        Node* prev;    // the previous sibling, or the parent for a first child
+        explicit Node(T&& value) : value(std::move(value)), child(nullptr), next(nullptr), prev(nullptr) {}
+    };
+
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Node> NodeAlloc;
+    typedef std::allocator_traits<NodeAlloc> NodeAllocTraits;
+
+    Node* root = nullptr;
+    std::size_t n = 0;
+    Compare before;
+    NodeAlloc alloc;
+
+    Node* new_node(T&& x) {
+        Node* node = NodeAllocTraits::allocate(alloc, 1);
+        try {
+            NodeAllocTraits::construct(alloc, node, std::move(x));
+        } catch (...) {
+            NodeAllocTraits::deallocate(alloc, node, 1);
+            throw; }
+        return node;
+    }
+
+    void delete_node(Node* node) {
+        NodeAllocTraits::destroy(alloc, node);
+        NodeAllocTraits::deallocate(alloc, node, 1);
+    }
+
+    // make the root with the worse element the first child of the other, and return the new root
+    Node* link(Node* a, Node* b) {
+        if (before(b->value, a->value)) std::swap(a, b);
+        b->prev = a;
+        b->next = a->child;
+        if (a->child) a->child->prev = b;
+        a->child = b;
+        a->next = nullptr;
+        a->prev = nullptr;
+        return a;
+    }
+
+    // the root of the tree made from the list of siblings starting at first, by the two-pass pairing
+    Node* merge_pairs(Node* first) {
+        Node* pairs = nullptr; // pass 1, left to right: link the siblings in pairs, into a list in reverse order
+        while (first) {
+            Node* a = first;
+            Node* b = a->next;
+            if (b == nullptr) {
+                a->next = pairs;
+                pairs = a;
+                break; }
+            first = b->next;
+            Node* pair = link(a, b);
+            pair->next = pairs;
+            pairs = pair; }
+        Node* result = nullptr; // pass 2, right to left: link each pair to the result so far
+        while (pairs) {
+            Node* next = pairs->next;
+            if (result) {
+                result = link(result, pairs); }
+            else {
+                result = pairs;
+                result->next = nullptr;
+                result->prev = nullptr; }
+            pairs = next; }
+        return result;
+    }
+
+    public:
+
+    typedef Node* handle;
+
+    explicit PairingHeap(const Compare& compare=Compare(), const Alloc& alloc=Alloc()) : before(compare), alloc(alloc) {}
+
+    ~PairingHeap() { clear(); }
+
+    // the handles are pointers into the heap, so a copy could not be used with them
+    PairingHeap(const PairingHeap&) = delete;
+    PairingHeap& operator=(const PairingHeap&) = delete;
+
+    PairingHeap(PairingHeap&& rhs) noexcept : root(rhs.root), n(rhs.n), before(rhs.before), alloc(rhs.alloc) {
+        rhs.root = nullptr; rhs.n = 0;
+    }
+
+    PairingHeap& operator=(PairingHeap&& rhs) noexcept {
+        if (this != &rhs) {
+            clear();
+            root = rhs.root; n = rhs.n;
+            alloc = rhs.alloc;
+            rhs.root = nullptr; rhs.n = 0; }
+        return *this;
+    }
+
+    std::size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+
+    // free every node, iteratively: the children of each node are spliced into the list of nodes still to free
+    void clear() {
+        Node* node = root;
+        while (node) {
+            if (node->child) {
+                Node* last = node->child;
+                while (last->next) last = last->next;
+                last->next = node->next;
+                node->next = node->child; }
+            Node* next = node->next;
+            delete_node(node);
+            node = next; }
+        root = nullptr;
+        n = 0;
+    }
+
+    // insert x and return its handle
+    handle push(T x) {
+        Node* node = new_node(std::move(x));
+        root = root ? link(root, node) : node;
+        n++;
+        return node;
+    }
+
+    const T& top() const {
+        if (root == nullptr) throw std::runtime_error("error in top(): the PairingHeap is empty");
+        return root->value;
+    }
+
+    handle top_handle() const {
+        if (root == nullptr) throw std::runtime_error("error in top_handle(): the PairingHeap is empty");
+        return root;
+    }
+
+    // remove the best element and return it. Its handle becomes invalid
+    T pop() {
+        if (root == nullptr) throw std::runtime_error("error in pop(): the PairingHeap is empty");
+        Node* old_root = root;
+        T best = std::move(old_root->value);
+        root = merge_pairs(old_root->child);
+        delete_node(old_root);
+        n--;
+        return best;
+    }
+
+    const T& value(handle h) const { return h->value; }
+
+    // replace the element of handle h by x, which must not be worse
+    void decrease_key(handle h, T x) {
+        if (before(h->value, x))
+            throw std::runtime_error("error in decrease_key(): the new value is worse than the old one");
+        h->value = std::move(x);
+        if (h == root) return;
+        if (h->prev->child == h) { h->prev->child = h->next; } else { h->prev->next = h->next; } // cut h off
+        if (h->next) h->next->prev = h->prev;
+        root = link(root, h);
+    }
+
+    /* move all the elements of other into this heap, in O(1), leaving other empty. The handles of other stay valid.
+       The nodes of other will be freed by this heap's allocator, so the two allocators must be equal */
+    void merge(PairingHeap& other) {
+        if (&other == this || other.root == nullptr) return;
+        if (alloc != other.alloc) throw std::runtime_error("error in merge(): the PairingHeaps have different allocators");
+        root = root ? link(root, other.root) : other.root;
+        n += other.n;
+        other.root = nullptr;
+        other.n = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+Benchmark of queue (FIFO) implementations: RingQueue (ring_queue.h) vs a linked list queue vs std::queue
+
+The access pattern is that of a message-processing loop: messages arrive in bursts and are enqueued, and a consumer
+dequeues and processes them, so the queue length goes up and down around some typical value without growing forever.
+We compare
+    - a linked list queue with the layout of brief_examples/stack_and_queue.cpp: one new Node per enqueue and one delete
+      per dequeue
+    - std::queue, which by default stores its elements in a std::deque (a list of fixed-size arrays, which are
+      allocated and freed as the front and back move along)
+    - RingQueue, enqueuing and dequeuing one element at a time
+    - RingQueue with the bulk operations, a whole burst (or a whole batch for the consumer) at a time
+for small, trivially copyable messages and for messages that own heap memory (a std::string payload).
+
+Compile with:
+g++ -std=c++11 -O2 -o queues queues.cpp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <queue>
+#include <random>
+#include <chrono>
+#include "ring_queue.h"
+
+using namespace std;
+
+struct SmallMessage {
+    int id;
+    int type;
+    double value;
+};
+
+struct StringMessage {
+    int id;
+    string payload;
+};
+
+SmallMessage make_message(int i, SmallMessage*) { return SmallMessage{i, i % 7, 0.5*i}; }
+StringMessage make_message(int i, StringMessage*) { return StringMessage{i, "message payload number " + to_string(i)}; }
+
+// linked list queue, as in stack_and_queue.cpp
+template <typename T>
+class ListQueue {
+    struct Node { T value; Node* next_node; };
+    Node* head = nullptr;
+    Node* tail = nullptr;
+
+    public:
+
+    ~ListQueue() { while (head != nullptr) dequeue(); }
+
+    void enqueue(const T& x) {
+        Node* node = new Node{x, nullptr};
+        if (head == nullptr) { head = node; tail = node; }
+        else { tail->next_node = node; tail = node; }
+    }
+
+    T dequeue() {
+        Node* node = head;
+        head = head->next_node;
+        if (head == nullptr) tail = nullptr;
+        T x = std::move(node->value);
+        delete node;
+        return x;
+    }
+};
+
+// adapter giving std::queue the same vocabulary
+template <typename T>
+struct StdQueue {
+    queue<T> q;
+    void enqueue(const T& x) { q.push(x); }
+    T dequeue() { T x = std::move(q.front()); q.pop(); return x; }
+};
+
+/* the burst sizes of the producer and the batch sizes of the consumer, random but the same for every queue. The
+   consumer takes batches of up to the same mean size, so the queue length wanders around a few hundred messages */
+struct Workload {
+    vector<int> bursts, batches;
+    Workload(int n_rounds, int mean_burst) {
+        mt19937 rng(42);
+        uniform_int_distribution<int> burst(1, 2*mean_burst-1);
+        for (int r=0;r<n_rounds;r++) { bursts.push_back(burst(rng)); batches.push_back(burst(rng)); }
+    }
+};
+
+// one element at a time. Returns the time per message in ns, and a checksum of the ids processed
+template <typename Q, typename T>
+double run_single(const Workload& w, const vector<T>& messages, long long& checksum) {
+    Q q;
+    size_t next = 0, queued = 0;
+    checksum = 0;
+    auto t_start = chrono::steady_clock::now();
+    for (size_t r=0;r<w.bursts.size();r++) {
+        for (int i=0;i<w.bursts[r];i++) q.enqueue(messages[next++ % messages.size()]);
+        queued += w.bursts[r];
+        for (int i=0;i<w.batches[r] && queued>0;i++,queued--) checksum += q.dequeue().id; }
+    while (queued > 0) { checksum += q.dequeue().id; queued--; }
+    return 1.0e9*chrono::duration<double>(chrono::steady_clock::now() - t_start).count()/double(next);
+}
+
+// a burst or batch at a time, with RingQueue's bulk operations
+template <typename T>
+double run_bulk(const Workload& w, const vector<T>& messages, long long& checksum) {
+    RingQueue<T> q;
+    vector<T> batch(4096);
+    size_t next = 0;
+    checksum = 0;
+    auto t_start = chrono::steady_clock::now();
+    for (size_t r=0;r<w.bursts.size();r++) {
+        size_t start = next % messages.size();
+        size_t count = w.bursts[r];
+        if (start + count > messages.size()) { // the producer's span wraps around the end of the message array
+            size_t first_piece = messages.size() - start;
+            q.enqueue_bulk(messages.data() + start, first_piece);
+            q.enqueue_bulk(messages.data(), count - first_piece);
+        } else {
+            q.enqueue_bulk(messages.data() + start, count); }
+        next += count;
+        size_t got = q.dequeue_bulk(batch.data(), w.batches[r]);
+        for (size_t i=0;i<got;i++) checksum += batch[i].id; }
+    size_t got;
+    while ((got = q.dequeue_bulk(batch.data(), batch.size())) > 0) {
+        for (size_t i=0;i<got;i++) checksum += batch[i].id; }
+    return 1.0e9*chrono::duration<double>(chrono::steady_clock::now() - t_start).count()/double(next);
+}
+
+template <typename T>
+void run_benchmark(const string& type_name) {
+    const int n_rounds = 200000, n_messages = 1 << 16;
+    vector<T> messages;
+    for (int i=0;i<n_messages;i++) messages.push_back(make_message(i, (T*)nullptr));
+
+    cout << "\nmessage type: " << type_name << "   (ns per message enqueued and dequeued)" << endl;
+    cout << setw(14) << "mean burst" << setw(14) << "linked list" << setw(14) << "std::queue" << setw(14) \
+         << "RingQueue" << setw(16) << "RingQueue bulk" << endl;
+    for (int mean_burst: {4, 64, 1024}) {
+        Workload w(n_rounds*4/mean_burst, mean_burst);
+        long long sum_list, sum_std, sum_ring, sum_bulk;
+        double t_list = run_single<ListQueue<T>>(w, messages, sum_list);
+        double t_std = run_single<StdQueue<T>>(w, messages, sum_std);
+        double t_ring = run_single<RingQueue<T>>(w, messages, sum_ring);
+        double t_bulk = run_bulk(w, messages, sum_bulk);
+        if (sum_std != sum_list || sum_ring != sum_list || sum_bulk != sum_list) {
+            cout << "error: the queues processed different messages" << endl; }
+        cout << setw(14) << mean_burst << fixed << setprecision(1) << setw(14) << t_list << setw(14) << t_std \
+             << setw(14) << t_ring << setw(16) << t_bulk << endl;
+        cout.unsetf(ios::fixed);
+    }
+}
+
+int main () {
+
+    run_benchmark<SmallMessage>("16-byte struct");
+    run_benchmark<StringMessage>("struct with std::string payload");
+
+    // FIFO order is kept when the ring wraps around the end of its array and then grows
+    RingQueue<int> q;
+    for (int i=0;i<10;i++) q.enqueue(i);
+    for (int i=0;i<10;i++) q.dequeue();    // head is now at slot 10 of 16
+    for (int i=0;i<40;i++) q.enqueue(i);   // wraps around, then grows twice
+    bool in_order = true;
+    for (int i=0;i<40;i++) in_order = in_order && (q.dequeue() == i);
+    cout << "\nFIFO order after wrap-around and growth: " << (in_order ? "ok" : "WRONG") << endl;
+
+    return 0;
+}
@@ -0,0 +1,217 @@
+/*
+RingQueue<T>: a queue (FIFO) stored in a circular buffer that grows by doubling
+
+The linked list Queue of brief_examples/stack_and_queue.cpp allocates a Node per enqueue and frees it per dequeue, so a
+queue that processes a stream of messages spends most of its time in malloc and free, and in following next_node
+pointers to places in memory that are not in the cache. A queue only touches its two ends, so it can instead keep its
+elements in an array used as a RING: elements are enqueued at the back and dequeued from the front, and both indices
+wrap around to the start of the array when they reach its end. The elements stay contiguous (in at most two pieces),
+and in the steady state, when the queue neither grows nor shrinks much, there are no allocations at all.
+
+The capacity is always a POWER OF TWO, so that wrapping an index around is a bitwise AND with capacity-1 rather than
+a (much slower) integer division. When the ring is full, a new array of twice the capacity is allocated and the
+elements are moved into it, in order from the front, so an enqueue costs O(1) amortised, as for ArrayStack.
+
+As in ArrayStack (array_stack.h), the array is raw memory: elements are constructed in it with placement new when they
+are enqueued (or directly from a constructor's arguments, with emplace), and destroyed when they are dequeued.
+The bulk operations enqueue_bulk and dequeue_bulk copy a whole span of elements, given as a pointer and a count, into
+or out of the ring in (at most) two contiguous pieces. For trivially copyable T, e.g. plain structs of numbers, each
+piece is a single memmove.
+*/
+
+#ifndef RING_QUEUE_H
+#define RING_QUEUE_H
+
+#include <memory>
+#include <utility>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <cstddef>
+
+template <typename T>
+class RingQueue {
+
+    std::allocator<T> alloc;
+    T* data = nullptr;
+    std::size_t cap = 0;  // number of slots in data: 0 or a power of two
+    std::size_t head = 0; // index of the front element
+    std::size_t n = 0;    // number of elements
+
+    std::size_t mask() const { return cap - 1; }
+
+    static std::size_t round_up_pow2(std::size_t x) {
+        std::size_t p = 16;
+        while (p < x) p *= 2;
+        return p;
+    }
+
+    /* move (or copy) the elements, in order from the front, to the start of new_data (of new_cap slots), which then
+       replaces the array. If a copy throws, the queue is unchanged, and the caller still owns new_data */
+    void move_into(T* new_data, std::size_t new_cap) {
+        std::size_t i = 0;
+        try {
+            for (;i<n;i++) ::new (static_cast<void*>(new_data+i)) T(std::move_if_noexcept(data[(head+i) & mask()]));
+        } catch (...) {
+            for (std::size_t j=0;j<i;j++) new_data[j].~T();
+            throw; }
+        destroy_all();
+        if (data) alloc.deallocate(data, cap);
+        data = new_data;
+        cap = new_cap;
+        head = 0;
+    }
+
+    void reallocate(std::size_t new_cap) {
+        T* new_data = alloc.allocate(new_cap);
+        try {
+            move_into(new_data, new_cap);
+        } catch (...) {
+            alloc.deallocate(new_data, new_cap);
+            throw; }
+    }
+
+    void destroy_all() {
+        for (std::size_t i=0;i<n;i++) data[(head+i) & mask()].~T();
+    }
+
+    public:
+
+    RingQueue() {}
+
+    explicit RingQueue(std::size_t initial_capacity) { reserve(initial_capacity); }
+
+    ~RingQueue() {
+        clear();
+        if (data) alloc.deallocate(data, cap);
+    }
+
+    RingQueue(const RingQueue& rhs) {
+        reserve(rhs.n);
+        for (std::size_t i=0;i<rhs.n;i++) enqueue(rhs.data[(rhs.head+i) & rhs.mask()]);
+    }
+
+    RingQueue(RingQueue&& rhs) noexcept : data(rhs.data), cap(rhs.cap), head(rhs.head), n(rhs.n) {
+        rhs.data = nullptr; rhs.cap = 0; rhs.head = 0; rhs.n = 0;
+    }
+
+    RingQueue& operator=(RingQueue rhs) noexcept {
+        swap(rhs);
+        return *this;
+    }
+
+    void swap(RingQueue& other) noexcept {
+        std::swap(data, other.data);
+        std::swap(cap, other.cap);
+        std::swap(head, other.head);
+        std::swap(n, other.n);
+    }
+
+    std::size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    std::size_t capacity() const { return cap; }
+
+    // make room for at least min_cap elements (rounded up to a power of two)
+    void reserve(std::size_t min_cap) {
+        if (min_cap > cap) reallocate(round_up_pow2(min_cap));
+    }
+
+    void enqueue(const T& x) { emplace(x); }
+
+    void enqueue(T&& x) { emplace(std::move(x)); }
+
+    // construct a new back element in place, from the arguments of one of T's constructors
+    template <typename... Args>
+    T& emplace(Args&&... args) {
+        if (n == cap) {
+            /* the arguments may refer to elements of this queue, which the reallocation would move: construct the new
+               element in the new array first, at the position it will have after the old elements */
+            const std::size_t new_cap = cap == 0 ? 16 : 2*cap;
+            T* new_data = alloc.allocate(new_cap);
+            try {
+                ::new (static_cast<void*>(new_data+n)) T(std::forward<Args>(args)...);
+            } catch (...) {
+                alloc.deallocate(new_data, new_cap);
+                throw; }
+            try {
+                move_into(new_data, new_cap);
+            } catch (...) {
+                new_data[n].~T();
+                alloc.deallocate(new_data, new_cap);
+                throw; }
+        } else {
+            ::new (static_cast<void*>(data + ((head+n) & mask()))) T(std::forward<Args>(args)...); }
+        n++;
+        return back();
+    }
+
+    T& front() {
+        if (n == 0) throw std::runtime_error("error in front(): the RingQueue is empty");
+        return data[head];
+    }
+
+    const T& front() const {
+        if (n == 0) throw std::runtime_error("error in front(): the RingQueue is empty");
+        return data[head];
+    }
+
+    T& back() {
+        if (n == 0) throw std::runtime_error("error in back(): the RingQueue is empty");
+        return data[(head+n-1) & mask()];
+    }
+
+    // remove the front element and return it (moved out of the ring)
+    T dequeue() {
+        if (n == 0) throw std::runtime_error("error in dequeue(): the RingQueue is empty");
+        T x(std::move(data[head]));
+        data[head].~T();
+        head = (head+1) & mask();
+        n--;
+        return x;
+    }
+
+    // enqueue copies of the count elements starting at first, in order
+    void enqueue_bulk(const T* first, std::size_t count) {
+        if (count == 0) return;
+        if (n + count > cap) {
+            // first may point into this ring: take a copy of the span before reallocating
+            if (data != nullptr && first >= data && first < data + cap) {
+                RingQueue<T> tmp(count);
+                tmp.enqueue_bulk(first, count);
+                reserve(n + count);
+                for (std::size_t i=0;i<count;i++) enqueue(tmp.dequeue());
+                return; }
+            reserve(n + count); }
+        // the free slots start at the back, and may wrap around the end of the array: copy in two pieces
+        const std::size_t back = (head+n) & mask();
+        const std::size_t first_piece = std::min(count, cap - back);
+        std::uninitialized_copy(first, first + first_piece, data + back);
+        try {
+            std::uninitialized_copy(first + first_piece, first + count, data);
+        } catch (...) {
+            for (std::size_t i=0;i<first_piece;i++) data[back+i].~T();
+            throw; }
+        n += count;
+    }
+
+    // dequeue up to max_count elements into the (already constructed) elements starting at out. Returns the number dequeued
+    std::size_t dequeue_bulk(T* out, std::size_t max_count) {
+        const std::size_t count = std::min(max_count, n);
+        const std::size_t first_piece = std::min(count, cap - head);
+        out = std::move(data + head, data + head + first_piece, out);
+        std::move(data, data + (count - first_piece), out);
+        for (std::size_t i=0;i<count;i++) data[(head+i) & mask()].~T();
+        head = (head + count) & mask();
+        n -= count;
+        return count;
+    }
+
+    // destroy all of the elements, keeping the array for reuse
+    void clear() {
+        destroy_all();
+        head = 0;
+        n = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+SmallString: a string of up to 23 bytes, stored inline in a 24-byte object
+
+A std::string (in libstdc++) is 32 bytes, and keeps strings of up to 15 characters inside itself (the SMALL STRING
+OPTIMIZATION); longer strings go to a heap allocation, which is then made again for every copy. For short strings whose
+maximum length is known (tags, codes, identifiers...), a fixed-capacity string can do without the heap entirely: a
+SmallString holds up to 23 bytes of characters in its own 24 bytes, never allocates, is trivially copyable (a copy is a
+24-byte memcpy), and can be stored in arrays and nodes without any pointer to chase.
+The last byte holds the number of UNUSED bytes (23 - size()), so that for a string of exactly 23 bytes it is 0 and
+doubles as the terminating '\0': c_str() is always available without a copy. The bytes after the string are kept at 0,
+so two SmallStrings are equal exactly when their 24 bytes are, which is compared as three 8-byte words.
+Constructing or appending beyond 23 bytes throws std::runtime_error: there is no fallback to the heap. For strings of
+any length that repeat a lot, the StringTable of string_table.h (4-byte handles) is the alternative.
+*/
+
+#ifndef SMALL_STRING_H
+#define SMALL_STRING_H
+
+#include <string>
+#include <ostream>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+class SmallString {
+
+    static const std::size_t n_bytes = 24;
+
+    char bytes[n_bytes]; // the characters, then zeros, and in the last byte capacity - size
+
+    void assign(const char* s, std::size_t length) {
+        if (length > capacity) throw std::runtime_error("error in SmallString: the string is longer than 23 bytes");
+        std::memset(bytes, 0, n_bytes);
+        std::memcpy(bytes, s, length);
+        bytes[n_bytes-1] = char(capacity - length);
+    }
+
+    std::uint64_t word(std::size_t i) const {
+        std::uint64_t w;
+        std::memcpy(&w, bytes + 8*i, 8);
+        return w;
+    }
+
+    public:
+
+    static const std::size_t capacity = n_bytes - 1;
+
+    SmallString() { assign("", 0); }
+    SmallString(const char* s) { assign(s, std::strlen(s)); }
+    SmallString(const char* s, std::size_t length) { assign(s, length); }
+    SmallString(const std::string& s) { assign(s.data(), s.size()); }
+
+    std::size_t size() const { return capacity - static_cast<unsigned char>(bytes[n_bytes-1]); }
+    bool empty() const { return size() == 0; }
+
+    const char* c_str() const { return bytes; }
+    const char* data() const { return bytes; }
+    char operator[](std::size_t i) const { return bytes[i]; }
+    std::string str() const { return std::string(bytes, size()); }
+
+    void push_back(char c) {
+        const std::size_t n = size();
+        if (n == capacity) throw std::runtime_error("error in push_back(): the SmallString is full");
+        bytes[n] = c;
+        bytes[n_bytes-1] = char(capacity - n - 1);
+    }
+
+    SmallString& append(const char* s, std::size_t length) {
+        const std::size_t n = size();
+        if (length > capacity - n) throw std::runtime_error("error in append(): the string is longer than 23 bytes");
+        std::memcpy(bytes + n, s, length);
+        bytes[n_bytes-1] = char(capacity - n - length);
+        return *this;
+    }
+
+    SmallString& operator+=(const char* s) { return append(s, std::strlen(s)); }
+
+    bool operator==(const SmallString& rhs) const {
+        return word(0) == rhs.word(0) && word(1) == rhs.word(1) && word(2) == rhs.word(2);
+    }
+
+    bool operator!=(const SmallString& rhs) const { return !(*this == rhs); }
+
+    // alphabetical order (by unsigned bytes, as std::string)
+    bool operator<(const SmallString& rhs) const {
+        const std::size_t n = size(), m = rhs.size();
+        const int c = std::memcmp(bytes, rhs.bytes, n < m ? n : m);
+        return c < 0 || (c == 0 && n < m);
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const SmallString& s) {
+    return os.write(s.data(), std::streamsize(s.size()));
+}
+
+#endif
@@ -0,0 +1,155 @@
+/*
+Benchmark of stack (LIFO) implementations: ArrayStack (array_stack.h) vs linked lists vs std::stack
+
+We push n elements and then pop them all, for
+    - a singly linked list that pushes at the TAIL and so must walk the whole list on every pop to find the new tail,
+      as the Stack of brief_examples/stack_and_queue.cpp used to do. Draining n elements costs O(n^2), so we only
+      run it up to moderate n: at n = 10^6 it would take hours
+    - a singly linked list that pushes and pops at the HEAD: O(1), but one heap allocation per element
+    - std::stack, which by default stores its elements in a std::deque (a list of fixed-size arrays)
+    - ArrayStack, one contiguous array that doubles in size when it is full
+for small elements (int) and for elements that own heap memory (std::string), where ArrayStack moves (not copies) the
+strings when the array grows.
+
+Compile with:
+g++ -std=c++11 -O2 -o stacks stacks.cpp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <stack>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <utility>
+#include "array_stack.h"
+
+using namespace std;
+
+// minimal linked list stacks, with the node layout of stack_and_queue.cpp
+template <typename T>
+struct ListNode {
+    T value;
+    ListNode* next_node;
+};
+
+// push at the tail, pop at the tail: O(n) per pop
+template <typename T>
+class TailListStack {
+    ListNode<T>* head = nullptr;
+    ListNode<T>* tail = nullptr;
+
+    public:
+
+    ~TailListStack() { while (head != nullptr) pop(); }
+
+    void push(const T& x) {
+        ListNode<T>* node = new ListNode<T>{x, nullptr};
+        if (head == nullptr) { head = node; tail = node; }
+        else { tail->next_node = node; tail = node; }
+    }
+
+    T pop() {
+        ListNode<T>* prev_node = nullptr;
+        ListNode<T>* current_node = head;
+        while (current_node->next_node != nullptr) {
+            prev_node = current_node;
+            current_node = current_node->next_node; }
+        if (prev_node == nullptr) { head = nullptr; tail = nullptr; }
+        else { prev_node->next_node = nullptr; tail = prev_node; }
+        T x = current_node->value;
+        delete current_node;
+        return x;
+    }
+};
+
+// push at the head, pop at the head: O(1) per pop
+template <typename T>
+class HeadListStack {
+    ListNode<T>* head = nullptr;
+
+    public:
+
+    ~HeadListStack() { while (head != nullptr) pop(); }
+
+    void push(const T& x) { head = new ListNode<T>{x, head}; }
+
+    T pop() {
+        ListNode<T>* node = head;
+        head = head->next_node;
+        T x = std::move(node->value);
+        delete node;
+        return x;
+    }
+};
+
+// time pushing n elements made by make(i) and popping them all. Returns seconds, and a checksum of the popped elements
+template <typename T, typename Push, typename Pop>
+double time_push_pop(size_t n, function<T(size_t)> make, Push push, Pop pop, size_t& checksum) {
+    auto t_start = chrono::steady_clock::now();
+    for (size_t i=0;i<n;i++) push(make(i));
+    checksum = 0;
+    for (size_t i=0;i<n;i++) checksum += hash<T>()(pop());
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+template <typename T>
+void run_benchmark(const string& type_name, function<T(size_t)> make, size_t max_n, size_t max_n_quadratic) {
+
+    cout << "\nelement type: " << type_name << endl;
+    cout << setw(10) << "n" << setw(18) << "list (tail pop)" << setw(18) << "list (head pop)" << setw(14) \
+         << "std::stack" << setw(14) << "ArrayStack" << "   (ns per push+pop)" << endl;
+
+    for (size_t n=1000;n<=max_n;n*=10) {
+        size_t sum_tail = 0, sum_head = 0, sum_std = 0, sum_array = 0;
+        double t_tail = -1.;
+        if (n <= max_n_quadratic) {
+            TailListStack<T> s;
+            t_tail = time_push_pop<T>(n, make, [&](T x) { s.push(x); }, [&]() { return s.pop(); }, sum_tail); }
+        double t_head, t_std, t_array;
+        {
+        HeadListStack<T> s;
+        t_head = time_push_pop<T>(n, make, [&](T x) { s.push(x); }, [&]() { return s.pop(); }, sum_head);
+        }
+        {
+        stack<T> s;
+        t_std = time_push_pop<T>(n, make, [&](T x) { s.push(std::move(x)); },
+                                 [&]() { T x = std::move(s.top()); s.pop(); return x; }, sum_std);
+        }
+        {
+        ArrayStack<T> s;
+        t_array = time_push_pop<T>(n, make, [&](T x) { s.push(std::move(x)); }, [&]() { return s.pop(); }, sum_array);
+        }
+        if (sum_head != sum_std || sum_array != sum_std || (t_tail >= 0. && sum_tail != sum_std)) {
+            cout << "error: the stacks popped different elements" << endl; }
+
+        const double scale = 1.0e9/double(n);
+        cout << setw(10) << n << fixed << setprecision(1);
+        if (t_tail >= 0.) { cout << setw(18) << t_tail*scale; } else { cout << setw(18) << "(too slow)"; }
+        cout << setw(18) << t_head*scale << setw(14) << t_std*scale << setw(14) << t_array*scale << endl;
+        cout.unsetf(ios::fixed);
+    }
+}
+
+int main () {
+
+    run_benchmark<int>("int", [](size_t i) { return int(i); }, 10000000, 30000);
+    run_benchmark<string>("string (40 chars)", [](size_t i) { return string(32, 'x') + to_string(10000000+i); },
+                          1000000, 30000);
+
+    // ArrayStack also works for elements without a default constructor, and copes with pushing one of its own elements
+    ArrayStack<string> s;
+    s.push("quack");
+    for (int i=0;i<20;i++) s.push(s.top()); // reallocates (at 16 elements) while copying an element of the array
+    cout << "\n" << s.size() << " elements, top: " << s.top() << endl;
+
+    // elements constructed in place from constructor arguments, and move-only elements
+    ArrayStack<pair<int, string>> records;
+    for (int i=0;i<100;i++) records.emplace(i, "record " + to_string(i));
+    ArrayStack<unique_ptr<string>> owners;
+    for (int i=0;i<100;i++) owners.emplace(new string("owned " + to_string(i)));
+    cout << records.pop().second << ", " << *owners.pop() << ", " << owners.size() << " left" << endl;
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+Short, repetitive string payloads: std::string against SmallString (small_string.h) and interned Symbols
+(string_table.h)
+
+The elements of a stack (here a std::forward_list, whose push_front and pop_front are those of the Stack of
+brief_examples/stack_and_queue.cpp) are an int id and a tag taken from a small vocabulary of bird calls, of 4 to 23
+characters, as the Bird of stack_and_queue.cpp. The tag is stored as
+    - a std::string: 32 bytes, plus a heap allocation for the tags of more than 15 characters
+    - a SmallString: 24 bytes, never on the heap
+    - a Symbol of a StringTable: 4 bytes, each distinct tag being stored once in the table
+For each we report the size of a node, the heap memory allocated per element while building the stack (nodes, strings,
+and for Symbols the table), and the time to
+    - BUILD the stack of n elements from the tags as text (for Symbols, this includes interning each one)
+    - COUNT the elements with each of 8 given tags (string comparisons, 24-byte comparisons, or integer comparisons)
+    - make a HISTOGRAM of the tags: with std::string, in an unordered_map keyed by the tag; with Symbols, in a vector
+      indexed by Symbol
+We check that the counts are the same for the three.
+
+Compile with:
+g++ -std=c++11 -O2 -o string_payloads string_payloads.cpp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <forward_list>
+#include <unordered_map>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include "../profiling/alloc_counter.h"
+#include "small_string.h"
+#include "string_table.h"
+
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point t_start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+const char* calls[] = {"quack", "honk", "squawk", "tweet", "hoot", "caw", "coo", "chirp", "cluck", "gobble",
+                       "cock-a-doodle-doo", "tu-whit tu-whoo", "kookaburra laugh", "drumming", "whip-poor-will",
+                       "chick-a-dee-dee-dee", "peent", "kee-kee-kee", "teacher teacher", "drink-your-tea",
+                       "who-cooks-for-you", "conk-la-ree", "fee-bee", "pee-a-wee", "cheer-up cheerily",
+                       "zee-zee-zoo-zee", "witchety-witchety", "quick-three-beers", "old-sam-peabody", "jay",
+                       "mew", "trill"};
+const int n_calls = sizeof(calls)/sizeof(calls[0]);
+
+struct StringBird { int id; string stringvar; };
+struct SmallStringBird { int id; SmallString stringvar; };
+struct SymbolBird { int id; Symbol stringvar; };
+
+// the node of a forward_list, for its size
+template <typename T>
+struct ListNode { void* next; T data; };
+
+struct Result { double build, count, histogram; size_t heap_bytes; vector<long> counts; };
+
+Result run_string(const vector<const char*>& input, const vector<const char*>& queries) {
+    Result r;
+    size_t bytes_before = heap_bytes;
+    auto t_start = chrono::steady_clock::now();
+    forward_list<StringBird> stack;
+    for (size_t i=0;i<input.size();i++) stack.push_front(StringBird{int(i), input[i]});
+    r.build = seconds_since(t_start);
+    r.heap_bytes = heap_bytes - bytes_before;
+
+    t_start = chrono::steady_clock::now();
+    vector<string> query_strings(queries.begin(), queries.end());
+    for (const string& q: query_strings) {
+        long count = 0;
+        for (const StringBird& b: stack) count += (b.stringvar == q);
+        r.counts.push_back(count); }
+    r.count = seconds_since(t_start);
+
+    t_start = chrono::steady_clock::now();
+    unordered_map<string, long> histogram;
+    for (const StringBird& b: stack) histogram[b.stringvar]++;
+    r.histogram = seconds_since(t_start);
+    for (int c=0;c<n_calls;c++) r.counts.push_back(histogram[calls[c]]);
+    return r;
+}
+
+Result run_small_string(const vector<const char*>& input, const vector<const char*>& queries) {
+    Result r;
+    size_t bytes_before = heap_bytes;
+    auto t_start = chrono::steady_clock::now();
+    forward_list<SmallStringBird> stack;
+    for (size_t i=0;i<input.size();i++) stack.push_front(SmallStringBird{int(i), input[i]});
+    r.build = seconds_since(t_start);
+    r.heap_bytes = heap_bytes - bytes_before;
+
+    t_start = chrono::steady_clock::now();
+    vector<SmallString> query_strings(queries.begin(), queries.end());
+    for (const SmallString& q: query_strings) {
+        long count = 0;
+        for (const SmallStringBird& b: stack) count += (b.stringvar == q);
+        r.counts.push_back(count); }
+    r.count = seconds_since(t_start);
+    r.histogram = 0; // no hash for SmallString: not measured
+    for (int c=0;c<n_calls;c++) {
+        long count = 0;
+        for (const SmallStringBird& b: stack) count += (b.stringvar == SmallString(calls[c]));
+        r.counts.push_back(count); }
+    return r;
+}
+
+Result run_symbol(const vector<const char*>& input, const vector<const char*>& queries) {
+    Result r;
+    size_t bytes_before = heap_bytes;
+    auto t_start = chrono::steady_clock::now();
+    StringTable table;
+    forward_list<SymbolBird> stack;
+    for (size_t i=0;i<input.size();i++) stack.push_front(SymbolBird{int(i), table.intern(input[i])});
+    r.build = seconds_since(t_start);
+    r.heap_bytes = heap_bytes - bytes_before;
+
+    t_start = chrono::steady_clock::now();
+    for (const char* q: queries) {
+        Symbol s;
+        long count = 0;
+        if (table.find(q, strlen(q), s)) { // a tag that is not in the table is in no element
+            for (const SymbolBird& b: stack) count += (b.stringvar == s); }
+        r.counts.push_back(count); }
+    r.count = seconds_since(t_start);
+
+    t_start = chrono::steady_clock::now();
+    vector<long> histogram(table.size(), 0);
+    for (const SymbolBird& b: stack) histogram[b.stringvar.id]++;
+    r.histogram = seconds_since(t_start);
+    for (int c=0;c<n_calls;c++) {
+        Symbol s;
+        r.counts.push_back(table.find(calls[c], strlen(calls[c]), s) ? histogram[s.id] : 0); }
+    return r;
+}
+
+int main () {
+
+    cout << "node size (bytes): std::string " << sizeof(ListNode<StringBird>) << ", SmallString " \
+         << sizeof(ListNode<SmallStringBird>) << ", Symbol " << sizeof(ListNode<SymbolBird>) << endl;
+
+    mt19937 rng(17);
+    vector<const char*> queries;
+    for (int q=0;q<8;q++) queries.push_back(calls[(5*q) % n_calls]);
+    bool all_ok = true;
+
+    for (size_t n: {10000, 1000000, 10000000}) {
+        vector<const char*> input(n);
+        for (const char*& s: input) s = calls[rng() % n_calls];
+
+        Result r_string = run_string(input, queries);
+        Result r_small = run_small_string(input, queries);
+        Result r_symbol = run_symbol(input, queries);
+        const bool ok = r_small.counts == r_string.counts && r_symbol.counts == r_string.counts;
+        all_ok = all_ok && ok;
+
+        cout << "\nn = " << n << (ok ? "" : "   ERROR: different counts") << endl;
+        cout << setw(14) << "" << setw(18) << "heap bytes/elem" << setw(16) << "build (ns/el)" << setw(16) \
+             << "count (ns/el)" << setw(20) << "histogram (ns/el)" << endl;
+        const double scale = 1.0e9/double(n);
+        auto print = [&](const char* name, const Result& r) {
+            cout << setw(14) << name << fixed << setprecision(1) << setw(18) << double(r.heap_bytes)/double(n) \
+                 << setw(16) << r.build*scale << setw(16) << r.count*scale/queries.size();
+            if (r.histogram > 0) { cout << setw(20) << r.histogram*scale; } else { cout << setw(20) << "-"; }
+            cout << endl;
+            cout.unsetf(ios::fixed); };
+        print("std::string", r_string);
+        print("SmallString", r_small);
+        print("Symbol", r_symbol); }
+
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+/*
+StringTable: string interning, with 32-bit Symbols as handles to the strings
+
+When the same few strings are stored over and over (tags, names, keywords: e.g. the stringvar of every Node of
+brief_examples/stack_and_queue.cpp), each copy in a std::string costs 32 bytes for the string object itself (with
+libstdc++), plus a heap allocation for strings of more than 15 characters, and comparing two of them compares their
+characters. INTERNING stores each distinct string ONCE, in a table, and represents every occurrence of it by a small
+integer: its index in the table, here a 32-bit Symbol. Then
+    - an element holds 4 bytes instead of 32 or more, and copying it never allocates
+    - two Symbols of the same table are equal exactly when their strings are equal, so comparing strings is comparing
+      two integers
+    - the Symbols are dense (0, 1, 2 ... in the order the strings were first interned), so a per-string counter or
+      property can live in a plain vector indexed by Symbol, instead of in a hash map keyed by the string
+The price is a hash table lookup when a string is interned (once per occurrence that comes in as text), and the
+strings can only be read back through their table.
+
+The characters are stored in an ARENA: large blocks of memory (64 KiB by default) into which the strings are copied one
+after the other, each followed by a '\0' so that c_str() needs no copy. A string longer than a block gets a block of its
+own. The strings never move once interned, so the pointers returned by c_str() stay valid as long as the table, and
+strings are never removed (the table only grows, which suits the small, repetitive vocabularies it is meant for).
+The hash index is an open-addressing table of Symbols, with linear probing, at most half full, that stores the hash of
+each string next to its Symbol, so that a probe compares the characters only when the hashes match.
+
+Symbol 0 is the empty string, so a default-constructed Symbol is valid in every table. The order of Symbols (operator<)
+is the order in which the strings were first interned, NOT alphabetical order.
+A StringTable is not thread-safe: threads that intern strings concurrently need a lock around it (reading the strings of
+existing Symbols is safe, as long as no thread is interning).
+*/
+
+#ifndef STRING_TABLE_H
+#define STRING_TABLE_H
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+struct Symbol {
+
+    std::uint32_t id = 0;
+
+    Symbol() {}
+    explicit Symbol(std::uint32_t id) : id(id) {}
+
+    bool operator==(Symbol rhs) const { return id == rhs.id; }
+    bool operator!=(Symbol rhs) const { return id != rhs.id; }
+    bool operator<(Symbol rhs) const { return id < rhs.id; }
+};
+
+class StringTable {
+
+    struct Entry {
+        const char* chars;
+        std::uint32_t length;
+        std::uint32_t hash;
+    };
+
+    struct Slot {
+        std::uint32_t hash;
+        std::uint32_t symbol_plus_one; // 0 for an empty slot
+    };
+
+    std::vector<Entry> entries;                 // indexed by Symbol
+    std::vector<Slot> slots;                    // the hash index, of a power-of-two size
+    std::vector<std::unique_ptr<char[]>> blocks; // the arena
+    char* block_next = nullptr;                 // the free space at the end of the newest block
+    std::size_t block_space = 0;
+    std::size_t block_size;
+    std::size_t bytes_in_blocks = 0;
+
+    // FNV-1a
+    static std::uint32_t hash_of(const char* s, std::size_t length) {
+        std::uint32_t h = 2166136261u;
+        for (std::size_t i=0;i<length;i++) {
+            h ^= static_cast<unsigned char>(s[i]);
+            h *= 16777619u; }
+        return h;
+    }
+
+    // the slot of the string, or the empty slot where it would go
+    std::size_t find_slot(const char* s, std::size_t length, std::uint32_t hash) const {
+        const std::size_t mask = slots.size() - 1;
+        for (std::size_t i=hash & mask;;i=(i+1) & mask) {
+            const Slot& slot = slots[i];
+            if (slot.symbol_plus_one == 0) return i;
+            if (slot.hash == hash) {
+                const Entry& e = entries[slot.symbol_plus_one-1];
+                if (e.length == length && std::memcmp(e.chars, s, length) == 0) return i; } }
+    }
+
+    void grow_index() {
+        std::vector<Slot> old(slots.size()*2, Slot{0, 0});
+        old.swap(slots);
+        const std::size_t mask = slots.size() - 1;
+        for (const Slot& slot: old) {
+            if (slot.symbol_plus_one == 0) continue;
+            std::size_t i = slot.hash & mask;
+            while (slots[i].symbol_plus_one != 0) i = (i+1) & mask;
+            slots[i] = slot; }
+    }
+
+    // copy the string into the arena, followed by a '\0'
+    const char* store(const char* s, std::size_t length) {
+        const std::size_t needed = length + 1;
+        if (needed > block_space) {
+            const std::size_t size = needed > block_size ? needed : block_size;
+            blocks.emplace_back(new char[size]);
+            bytes_in_blocks += size;
+            block_next = blocks.back().get();
+            block_space = size; }
+        char* p = block_next;
+        std::memcpy(p, s, length);
+        p[length] = '\0';
+        block_next += needed;
+        block_space -= needed;
+        return p;
+    }
+
+    public:
+
+    explicit StringTable(std::size_t block_size=65536) : slots(64, Slot{0, 0}), block_size(block_size) {
+        intern("", 0); // Symbol 0
+    }
+
+    // the Symbols of the table would point into the arena of the original
+    StringTable(const StringTable&) = delete;
+    StringTable& operator=(const StringTable&) = delete;
+
+    // the Symbol of the string, which is added to the table if it is not there yet
+    Symbol intern(const char* s, std::size_t length) {
+        if (length > UINT32_MAX) throw std::runtime_error("error in intern(): the string is too long");
+        const std::uint32_t hash = hash_of(s, length);
+        std::size_t i = find_slot(s, length, hash);
+        if (slots[i].symbol_plus_one != 0) return Symbol(slots[i].symbol_plus_one-1);
+        if (entries.size() == UINT32_MAX) throw std::runtime_error("error in intern(): the StringTable is full");
+        entries.push_back(Entry{store(s, length), std::uint32_t(length), hash});
+        slots[i] = Slot{hash, std::uint32_t(entries.size())};
+        if (2*entries.size() > slots.size()) grow_index();
+        return Symbol(std::uint32_t(entries.size()-1));
+    }
+
+    Symbol intern(const char* s) { return intern(s, std::strlen(s)); }
+    Symbol intern(const std::string& s) { return intern(s.data(), s.size()); }
+
+    // look the string up without adding it: returns false if it has not been interned
+    bool find(const char* s, std::size_t length, Symbol& out) const {
+        const std::size_t i = find_slot(s, length, hash_of(s, length));
+        if (slots[i].symbol_plus_one == 0) return false;
+        out = Symbol(slots[i].symbol_plus_one-1);
+        return true;
+    }
+
+    bool find(const std::string& s, Symbol& out) const { return find(s.data(), s.size(), out); }
+
+    const char* c_str(Symbol symbol) const { return entry(symbol).chars; }
+    std::size_t length(Symbol symbol) const { return entry(symbol).length; }
+    std::string str(Symbol symbol) const { return std::string(entry(symbol).chars, entry(symbol).length); }
+
+    // the number of distinct strings (including the empty string), i.e. one more than the largest Symbol
+    std::size_t size() const { return entries.size(); }
+
+    // the memory used by the table: the arena, the entries and the hash index
+    std::size_t bytes_used() const {
+        return bytes_in_blocks + entries.capacity()*sizeof(Entry) + slots.capacity()*sizeof(Slot);
+    }
+
+    private:
+
+    const Entry& entry(Symbol symbol) const {
+        if (symbol.id >= entries.size()) throw std::runtime_error("error in StringTable: the Symbol is not in the table");
+        return entries[symbol.id];
+    }
+};
+
+#endif
@@ -0,0 +1,243 @@
+/*
+UnrolledList<T>: a doubly linked list of small arrays of elements
+
+In the linked List of brief_examples/stack_and_queue.cpp every element has its own node, so walking along the list
+means following one pointer per element. The next node can be anywhere in memory, so the CPU cannot load it until it has
+read the pointer to it, and the hardware prefetchers, which recognise sequential and strided access, cannot guess where
+it is either: for a list that does not fit in the cache, every element costs a full memory latency (~100 ns).
+An UNROLLED linked list stores a small ARRAY of elements in each node, sized so that a node fills one or two cache lines
+(by default 128 bytes, including the node's header). Walking the list then reads the elements of a node sequentially,
+and follows a pointer only once per node, which divides the number of cache misses by the number of elements per node.
+In addition, when a walk enters a node, it asks the CPU to start loading the NEXT node (a software prefetch), so that
+the next node's memory latency overlaps with the work on this node's elements.
+Each node keeps its elements in a contiguous range [first, last) of its array, so that the list can grow at both ends
+in O(1): push_back appends to the last node (or adds a new node at the back, filled from its start), and push_front
+prepends to the first node (or adds a new node at the front, filled from its END). Likewise pop_front and pop_back
+remove a node once it is empty.
+As in std::deque, the elements never move once they are in the list (so pointers and references to them stay valid
+until they are removed), but unlike std::deque, there is no central index of the nodes: the list supports only
+sequential access, and its nodes are independent allocations, as in a linked list.
+
+Requires C++17 (for the cache line alignment of the nodes).
+*/
+
+#ifndef UNROLLED_LIST_H
+#define UNROLLED_LIST_H
+
+#include <new>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+#include <stdexcept>
+#include <cstddef>
+
+template <typename T, std::size_t NodeBytes = 128>
+class UnrolledList {
+
+    struct NodeHeader {
+        NodeHeader *prev, *next;
+        unsigned short first, last; // the elements are slots [first, last) of the array
+    };
+
+    public:
+
+    // the number of elements per node, filling the node up to NodeBytes (at least one)
+    static constexpr std::size_t node_capacity =
+        NodeBytes > sizeof(NodeHeader) + sizeof(T) ? (NodeBytes - sizeof(NodeHeader))/sizeof(T) : 1;
+
+    private:
+
+    static_assert(node_capacity < 65536, "error in UnrolledList: too many elements per node");
+
+    struct alignas(64) Node : NodeHeader {
+        alignas(T) unsigned char storage[node_capacity*sizeof(T)];
+        T* slot(std::size_t i) { return reinterpret_cast<T*>(storage) + i; }
+    };
+
+    Node *head = nullptr, *tail = nullptr;
+    std::size_t n = 0;
+
+    static Node* new_node(unsigned short first) {
+        Node* node = static_cast<Node*>(::operator new(sizeof(Node), std::align_val_t(alignof(Node))));
+        node->prev = nullptr; node->next = nullptr;
+        node->first = first; node->last = first;
+        return node;
+    }
+
+    static void delete_node(Node* node) {
+        ::operator delete(node, std::align_val_t(alignof(Node)));
+    }
+
+    static void prefetch(const void* p) {
+#if defined(__GNUC__)
+        __builtin_prefetch(p);
+#endif
+    }
+
+    public:
+
+    template <bool Const>
+    class basic_iterator {
+        typedef typename std::conditional<Const, const T, T>::type value_ref_type;
+        Node* node;
+        std::size_t i;
+
+        friend class UnrolledList;
+        basic_iterator(Node* node, std::size_t i) : node(node), i(i) {}
+
+        public:
+
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_ref_type* pointer;
+        typedef value_ref_type& reference;
+
+        basic_iterator() : node(nullptr), i(0) {}
+        operator basic_iterator<true>() const { return basic_iterator<true>(node, i); }
+
+        reference operator*() const { return *node->slot(i); }
+        pointer operator->() const { return node->slot(i); }
+
+        basic_iterator& operator++() {
+            if (++i == node->last) { // on to the next node, and prefetch the one after it
+                node = static_cast<Node*>(node->next);
+                if (node) {
+                    i = node->first;
+                    prefetch(node->next); }
+                else { i = 0; } }
+            return *this;
+        }
+
+        basic_iterator operator++(int) { basic_iterator old = *this; ++*this; return old; }
+        bool operator==(const basic_iterator& rhs) const { return node == rhs.node && i == rhs.i; }
+        bool operator!=(const basic_iterator& rhs) const { return !(*this == rhs); }
+    };
+
+    typedef basic_iterator<false> iterator;
+    typedef basic_iterator<true> const_iterator;
+
+    UnrolledList() {}
+
+    ~UnrolledList() { clear(); }
+
+    UnrolledList(const UnrolledList& rhs) {
+        for (const T& x: rhs) push_back(x);
+    }
+
+    UnrolledList(UnrolledList&& rhs) noexcept : head(rhs.head), tail(rhs.tail), n(rhs.n) {
+        rhs.head = nullptr; rhs.tail = nullptr; rhs.n = 0;
+    }
+
+    UnrolledList& operator=(UnrolledList rhs) noexcept {
+        std::swap(head, rhs.head);
+        std::swap(tail, rhs.tail);
+        std::swap(n, rhs.n);
+        return *this;
+    }
+
+    std::size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+
+    iterator begin() { return head ? iterator(head, head->first) : iterator(); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return head ? const_iterator(head, head->first) : const_iterator(); }
+    const_iterator end() const { return const_iterator(); }
+
+    T& front() {
+        if (n == 0) throw std::runtime_error("error in front(): the UnrolledList is empty");
+        return *head->slot(head->first);
+    }
+
+    T& back() {
+        if (n == 0) throw std::runtime_error("error in back(): the UnrolledList is empty");
+        return *tail->slot(tail->last-1);
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (tail == nullptr || tail->last == node_capacity) { // a new node at the back, filled from its start
+            Node* node = new_node(0);
+            try {
+                ::new (static_cast<void*>(node->slot(0))) T(std::forward<Args>(args)...);
+            } catch (...) {
+                delete_node(node);
+                throw; }
+            node->last = 1;
+            node->prev = tail;
+            if (tail) { tail->next = node; } else { head = node; }
+            tail = node;
+        } else {
+            ::new (static_cast<void*>(tail->slot(tail->last))) T(std::forward<Args>(args)...);
+            tail->last++; }
+        n++;
+        return back();
+    }
+
+    template <typename... Args>
+    T& emplace_front(Args&&... args) {
+        if (head == nullptr || head->first == 0) { // a new node at the front, filled from its end
+            Node* node = new_node(node_capacity);
+            try {
+                ::new (static_cast<void*>(node->slot(node_capacity-1))) T(std::forward<Args>(args)...);
+            } catch (...) {
+                delete_node(node);
+                throw; }
+            node->first = node_capacity-1;
+            node->next = head;
+            if (head) { head->prev = node; } else { tail = node; }
+            head = node;
+        } else {
+            ::new (static_cast<void*>(head->slot(head->first-1))) T(std::forward<Args>(args)...);
+            head->first--; }
+        n++;
+        return front();
+    }
+
+    void push_back(const T& x) { emplace_back(x); }
+    void push_back(T&& x) { emplace_back(std::move(x)); }
+    void push_front(const T& x) { emplace_front(x); }
+    void push_front(T&& x) { emplace_front(std::move(x)); }
+
+    // remove the front element and return it
+    T pop_front() {
+        if (n == 0) throw std::runtime_error("error in pop_front(): the UnrolledList is empty");
+        T* p = head->slot(head->first);
+        T x(std::move(*p));
+        p->~T();
+        if (++head->first == head->last) { // the node is empty
+            Node* next = static_cast<Node*>(head->next);
+            delete_node(head);
+            head = next;
+            if (head) { head->prev = nullptr; } else { tail = nullptr; } }
+        n--;
+        return x;
+    }
+
+    // remove the back element and return it
+    T pop_back() {
+        if (n == 0) throw std::runtime_error("error in pop_back(): the UnrolledList is empty");
+        T* p = tail->slot(tail->last-1);
+        T x(std::move(*p));
+        p->~T();
+        if (--tail->last == tail->first) {
+            Node* prev = static_cast<Node*>(tail->prev);
+            delete_node(tail);
+            tail = prev;
+            if (tail) { tail->next = nullptr; } else { head = nullptr; } }
+        n--;
+        return x;
+    }
+
+    void clear() {
+        while (head != nullptr) {
+            for (std::size_t i=head->first;i<head->last;i++) head->slot(i)->~T();
+            Node* next = static_cast<Node*>(head->next);
+            delete_node(head);
+            head = next; }
+        tail = nullptr;
+        n = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,140 @@
+/*
+Benchmark of UnrolledList (unrolled_list.h) against a linked list with one element per node and std::deque
+
+We build a list of n ints with push_back, walk along it (summing the elements), and empty it with pop_front, for
+    - a singly linked list with one element per node, as the List of brief_examples/stack_and_queue.cpp
+    - std::deque<int>, which keeps its elements in fixed-size blocks (512 bytes in libstdc++) and an index of the blocks
+    - UnrolledList<int>, with 128-byte nodes of 26 ints, and with 256-byte nodes of 58 ints
+To make the linked list's nodes as scattered in memory as they would be in a long-running program, the lists are built
+interleaved with 7 others: each push goes to the measured list or (as often) to a random one of the others, so that
+the consecutive nodes of one list are not consecutive in memory. (Built on its own in a fresh heap, a linked list's nodes can be consecutive in memory, which
+flatters it.) The walk is the operation that matters: it is memory-latency-bound for the linked list once the list no
+longer fits in the cache.
+
+Compile with:
+g++ -std=c++17 -O2 -o unrolled_lists unrolled_lists.cpp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <random>
+#include <chrono>
+#include "unrolled_list.h"
+
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point t_start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+// a singly linked list with the node layout of stack_and_queue.cpp, with the same vocabulary as the others
+class LinkedList {
+    struct Node { int data; Node* next_node; };
+    Node *head = nullptr, *tail = nullptr;
+
+    public:
+
+    class iterator {
+        Node* node;
+        public:
+        explicit iterator(Node* node) : node(node) {}
+        int& operator*() const { return node->data; }
+        iterator& operator++() { node = node->next_node; return *this; }
+        bool operator!=(const iterator& rhs) const { return node != rhs.node; }
+    };
+
+    ~LinkedList() { while (head != nullptr) pop_front(); }
+
+    void push_back(int x) {
+        Node* node = new Node{x, nullptr};
+        if (tail) { tail->next_node = node; } else { head = node; }
+        tail = node;
+    }
+
+    int pop_front() {
+        Node* node = head;
+        head = head->next_node;
+        if (head == nullptr) tail = nullptr;
+        int x = node->data;
+        delete node;
+        return x;
+    }
+
+    iterator begin() { return iterator(head); }
+    iterator end() { return iterator(nullptr); }
+};
+
+// deque with pop_front returning the element
+struct Deque : deque<int> {
+    int pop_front() { int x = front(); deque<int>::pop_front(); return x; }
+};
+
+struct Times { double build, walk, drain; long long checksum; };
+
+template <typename ListType>
+Times run(size_t n, int n_walks) {
+    const int n_lists = 8;
+    vector<ListType> lists(n_lists);
+    mt19937 rng(5);
+    vector<size_t> sizes(n_lists, 0);
+    Times t;
+
+    auto t_start = chrono::steady_clock::now();
+    // push n elements into list 0, and (on average) n more spread over the others, in a random interleaving
+    for (size_t i=0;sizes[0]<n;i++) {
+        int l = rng() % 2 == 0 ? 0 : 1 + int(rng() % (n_lists-1));
+        lists[l].push_back(l == 0 ? int(sizes[0]) : int(i));
+        sizes[l]++; }
+    t.build = seconds_since(t_start);
+
+    t.checksum = 0;
+    t_start = chrono::steady_clock::now();
+    for (int w=0;w<n_walks;w++) {
+        for (int x: lists[0]) t.checksum += x; }
+    t.walk = seconds_since(t_start)/n_walks;
+
+    t_start = chrono::steady_clock::now();
+    for (size_t i=0;i<n;i++) t.checksum += lists[0].pop_front();
+    t.drain = seconds_since(t_start);
+    return t;
+}
+
+int main () {
+
+    cout << "UnrolledList<int> elements per node: " << UnrolledList<int>::node_capacity << " (128 bytes), " \
+         << UnrolledList<int, 256>::node_capacity << " (256 bytes)" << endl;
+
+    for (size_t n: {1000, 100000, 10000000}) {
+        const int n_walks = int(max<size_t>(1, 100000000/n));
+        Times t_list = run<LinkedList>(n, n_walks);
+        Times t_deque = run<Deque>(n, n_walks);
+        Times t_unrolled = run<UnrolledList<int>>(n, n_walks);
+        Times t_unrolled256 = run<UnrolledList<int, 256>>(n, n_walks);
+        if (t_deque.checksum != t_list.checksum || t_unrolled.checksum != t_list.checksum ||
+            t_unrolled256.checksum != t_list.checksum) cout << "error: the lists have different contents" << endl;
+
+        cout << "\nn = " << n << " (ns per element)" << endl;
+        cout << setw(22) << "" << setw(12) << "build" << setw(12) << "walk" << setw(12) << "pop_front" << endl;
+        const double scale = 1.0e9/double(n);
+        auto print = [&](const char* name, const Times& t) {
+            cout << setw(22) << name << fixed << setprecision(2) << setw(12) << t.build*scale << setw(12) \
+                 << t.walk*scale << setw(12) << t.drain*scale << endl;
+            cout.unsetf(ios::fixed); };
+        print("linked list", t_list);
+        print("std::deque", t_deque);
+        print("UnrolledList (128 B)", t_unrolled);
+        print("UnrolledList (256 B)", t_unrolled256); }
+
+    // both ends
+    UnrolledList<int> l;
+    for (int i=0;i<100;i++) { l.push_back(i); l.push_front(-i-1); }
+    bool ok = true;
+    int expected = -100;
+    for (int x: l) { ok = ok && (x == expected); expected++; }
+    while (!l.empty()) l.pop_back();
+    cout << "\npush at both ends in order: " << (ok ? "ok" : "WRONG") << endl;
+
+    return 0;
+}
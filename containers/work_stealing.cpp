@@ -0,0 +1,196 @@
+/*
+Stress test and benchmark of the Chase-Lev WorkStealingDeque (work_stealing_deque.h)
+
+STRESS TEST: one owner thread pushes n distinct values into a deque that starts with a capacity of 2, so that it has to
+grow many times while thieves are stealing, and pops some of them itself (in bursts, so that the deque often runs down
+to its last element, where the owner and the thieves race for it). Several thief threads steal continually. Every value
+must be taken exactly once, by the owner or by a thief: we count how many times each value was taken.
+
+BENCHMARK: the load balancing of an IRREGULAR task tree, as in the Unbalanced Tree Search benchmark. Each task (a tree
+node) does a little work, and then creates a random number of child tasks: 8 children with probability q, and none
+otherwise. With 8q close to 1 the subtrees below the root's children have wildly different sizes, so a static split
+of the root's children between the threads would leave most of the threads idle while one works on a huge subtree.
+We compare
+    - work stealing: each worker pushes its children onto its own deque and pops from it, and steals from a random
+      other worker when its deque is empty
+    - a central queue: all of the workers push to and pop from one std::deque protected by a mutex
+The computation is finished when no task is outstanding (an atomic counter of tasks created but not yet completed).
+
+Run with an optional number of worker threads, e.g. ./work_stealing 8
+
+Compile with:
+g++ -std=c++17 -O2 -o work_stealing work_stealing.cpp -pthread
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include "work_stealing_deque.h"
+
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point t_start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+// returns true if every value in [0, n) was taken exactly once
+bool stress_test(int n_thieves, int64_t n) {
+    WorkStealingDeque<int64_t> dq(2);
+    vector<atomic<int>> taken(n);
+    for (auto& c: taken) c.store(0);
+    atomic<bool> done{false};
+    atomic<int64_t> n_stolen{0};
+
+    vector<thread> thieves;
+    for (int i=0;i<n_thieves;i++) {
+        thieves.emplace_back([&]() {
+            int64_t x, count = 0;
+            while (!done.load(memory_order_acquire) || !dq.empty()) {
+                if (dq.steal(x)) { taken[x]++; count++; } }
+            n_stolen += count;
+        }); }
+
+    mt19937 rng(3);
+    int64_t next = 0, x;
+    while (next < n) {
+        int burst = int(rng() % 64);
+        for (int i=0;i<burst && next<n;i++) dq.push(next++);
+        int pops = int(rng() % 80); // sometimes more than were pushed, to empty the deque
+        for (int i=0;i<pops;i++) {
+            if (dq.pop(x)) { taken[x]++; } else { break; } }
+        if (rng() % 16 == 0) this_thread::yield(); } // let the thieves run, even with fewer cores than threads
+    while (dq.pop(x)) taken[x]++;
+    done.store(true, memory_order_release);
+    for (thread& t: thieves) t.join();
+
+    int64_t n_wrong = 0;
+    for (int64_t i=0;i<n;i++) {
+        if (taken[i].load() != 1) n_wrong++; }
+    cout << "stress test, " << n_thieves << " thieves: " << n << " values, " << n_stolen.load() << " stolen, final capacity " \
+         << dq.capacity() << ", " << n_wrong << " taken other than once: " << (n_wrong == 0 ? "ok" : "FAILED") << endl;
+    return n_wrong == 0;
+}
+
+// a tree node's work: some arithmetic, and the seeds of its children (empty with probability 1-q)
+const int n_children = 8;
+const double q = 0.1245;
+
+uint64_t mix(uint64_t x) {
+    x ^= x >> 33; x *= 0xff51afd7ed558ccdULL; x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53ULL; x ^= x >> 33;
+    return x;
+}
+
+int process_node(uint64_t seed, uint64_t* children) {
+    uint64_t h = seed;
+    for (int i=0;i<200;i++) h = mix(h + i); // the work
+    if (double(h % 1000000)/1.0e6 >= q) return 0;
+    for (int c=0;c<n_children;c++) children[c] = mix(seed*31 + c + 1);
+    return n_children;
+}
+
+// the root's children
+vector<uint64_t> root_tasks(int n_roots) {
+    vector<uint64_t> roots;
+    for (int i=0;i<n_roots;i++) roots.push_back(mix(i + 12345));
+    return roots;
+}
+
+double run_work_stealing(int n_workers, const vector<uint64_t>& roots, int64_t& n_nodes) {
+    vector<unique_ptr<WorkStealingDeque<uint64_t>>> deques;
+    for (int w=0;w<n_workers;w++) deques.emplace_back(new WorkStealingDeque<uint64_t>());
+    for (size_t i=0;i<roots.size();i++) deques[0]->push(roots[i]); // all of the work starts on worker 0
+    atomic<int64_t> outstanding{int64_t(roots.size())}, processed{0};
+
+    auto t_start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int w=0;w<n_workers;w++) {
+        workers.emplace_back([&, w]() {
+            mt19937 rng(w);
+            uint64_t task, children[n_children];
+            int64_t count = 0;
+            for (;;) {
+                bool got = deques[w]->pop(task);
+                while (!got && outstanding.load(memory_order_relaxed) > 0) { // steal from a random victim
+                    int victim = int(rng() % n_workers);
+                    if (victim != w) { got = deques[victim]->steal(task); } else { this_thread::yield(); } }
+                if (!got) break; // nothing outstanding: finished
+                int k = process_node(task, children);
+                if (k > 0) outstanding.fetch_add(k, memory_order_relaxed);
+                for (int c=0;c<k;c++) deques[w]->push(children[c]);
+                outstanding.fetch_sub(1, memory_order_relaxed);
+                count++; }
+            processed += count;
+        }); }
+    for (thread& t: workers) t.join();
+    n_nodes = processed.load();
+    return seconds_since(t_start);
+}
+
+double run_central_queue(int n_workers, const vector<uint64_t>& roots, int64_t& n_nodes) {
+    deque<uint64_t> tasks(roots.begin(), roots.end());
+    mutex m;
+    atomic<int64_t> outstanding{int64_t(roots.size())}, processed{0};
+
+    auto t_start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int w=0;w<n_workers;w++) {
+        workers.emplace_back([&]() {
+            uint64_t task, children[n_children];
+            int64_t count = 0;
+            for (;;) {
+                bool got = false;
+                while (!got) {
+                    {
+                    lock_guard<mutex> lock(m);
+                    if (!tasks.empty()) { task = tasks.back(); tasks.pop_back(); got = true; }
+                    }
+                    if (!got) {
+                        if (outstanding.load() == 0) break;
+                        this_thread::yield(); } }
+                if (!got) break;
+                int k = process_node(task, children);
+                if (k > 0) {
+                    outstanding.fetch_add(k);
+                    lock_guard<mutex> lock(m);
+                    for (int c=0;c<k;c++) tasks.push_back(children[c]); }
+                outstanding.fetch_sub(1);
+                count++; }
+            processed += count;
+        }); }
+    for (thread& t: workers) t.join();
+    n_nodes = processed.load();
+    return seconds_since(t_start);
+}
+
+int main (int argc, char* argv[]) {
+
+    int max_workers = max(2, int(thread::hardware_concurrency()));
+    if (argc > 1) max_workers = atoi(argv[1]);
+
+    bool ok = true;
+    for (int n_thieves: {1, 3}) ok = stress_test(n_thieves, 2000000) && ok;
+
+    const vector<uint64_t> roots = root_tasks(2000);
+    cout << "\nunbalanced tree search (8 children with probability " << q << "):" << endl;
+    cout << setw(10) << "workers" << setw(12) << "nodes" << setw(20) << "work stealing (s)" << setw(20) \
+         << "central queue (s)" << endl;
+    for (int n_workers=1;n_workers<=max_workers;n_workers*=2) {
+        int64_t nodes_ws, nodes_central;
+        double t_ws = run_work_stealing(n_workers, roots, nodes_ws);
+        double t_central = run_central_queue(n_workers, roots, nodes_central);
+        if (nodes_ws != nodes_central) {
+            cout << "error: different numbers of nodes processed" << endl;
+            ok = false; }
+        cout << setw(10) << n_workers << setw(12) << nodes_ws << fixed << setprecision(3) << setw(20) << t_ws \
+             << setw(20) << t_central << endl;
+        cout.unsetf(ios::fixed); }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+/*
+WorkStealingDeque<T>: the Chase-Lev work-stealing deque
+
+In a work-stealing scheduler, every worker thread has its own deque of tasks. The OWNER pushes the tasks it creates at
+the BOTTOM of its deque, and pops them from the bottom again, so for the owner the deque is a stack (LIFO): it works on
+the most recently created task, whose data is most likely to still be in its cache, and in a divide-and-conquer
+computation it goes depth-first, which keeps the number of tasks in the deque small. A worker whose deque is empty
+becomes a THIEF: it picks another worker at random and steals the task at the TOP of that worker's deque, i.e. the
+OLDEST task, which in a divide-and-conquer computation is the biggest piece of work, so that steals are rare.
+The owner's push and pop are just a few plain loads and stores: only when the owner and a thief compete for the last
+task, and when thieves compete with each other, is a compare-and-swap (CAS) on the top index needed.
+
+The deque is a circular array indexed by two ever-increasing counters, top (the next task to steal) and bottom (where
+the next task will be pushed), so it holds bottom-top tasks. When the array is full, push copies the tasks into an array
+of twice the size. A thief may still be reading from the old array at that moment, so old arrays are not freed until
+the deque itself is destroyed (they take at most as much memory again as the current array).
+
+The memory orderings are those proven correct for the C11/C++11 memory model by Le, Pop, Cohen and Zappa Nardelli,
+"Correct and efficient work-stealing for weak memory models" (PPoPP 2013):
+    - push writes the task, then a release fence, then bottom: a thief that sees the new bottom also sees the task
+    - pop FIRST decrements bottom (claiming the bottom task), then a sequentially consistent fence, then reads top. A
+      thief does the reverse: reads top, fence, reads bottom. The two fences guarantee that the owner and a thief cannot
+      both miss each other's claim, so when they go for the same (last) task, both see it and settle it with a CAS on top
+    - a thief claims the task at top with a CAS of top from t to t+1: if the CAS fails, another thief (or the owner)
+      took that task first, and the steal fails
+The tasks are read and written concurrently by the owner and thieves (a thief may read a slot that the owner is
+overwriting, and then the thief's CAS fails and it discards what it read), so the slots are atomics, and T must be
+trivially copyable: typically a pointer to a task, or a small task descriptor.
+
+Requires C++17 if deques are allocated with new, for their alignas(64) members.
+*/
+
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+template <typename T>
+class WorkStealingDeque {
+
+    static_assert(std::is_trivially_copyable<T>::value, "error in WorkStealingDeque: T must be trivially copyable");
+
+    // a circular array of atomic slots, of a power-of-two size
+    class CircularArray {
+        const std::int64_t cap, mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        public:
+
+        explicit CircularArray(std::int64_t cap) : cap(cap), mask(cap-1), slots(new std::atomic<T>[cap]) {}
+
+        std::int64_t capacity() const { return cap; }
+        void put(std::int64_t i, T x) { slots[i & mask].store(x, std::memory_order_relaxed); }
+        T get(std::int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+
+        // a copy of twice the size, with the tasks at positions [t, b)
+        CircularArray* grow(std::int64_t t, std::int64_t b) const {
+            CircularArray* a = new CircularArray(2*cap);
+            for (std::int64_t i=t;i<b;i++) a->put(i, get(i));
+            return a;
+        }
+    };
+
+    alignas(64) std::atomic<std::int64_t> top{0};    // written by thieves (CAS) and by the owner on the last task
+    alignas(64) std::atomic<std::int64_t> bottom{0}; // written by the owner only
+    std::atomic<CircularArray*> array;
+    std::vector<std::unique_ptr<CircularArray>> arrays; // the current and all retired arrays, freed on destruction
+
+    public:
+
+    explicit WorkStealingDeque(std::int64_t initial_capacity=1024) {
+        std::int64_t cap = 2;
+        while (cap < initial_capacity) cap *= 2;
+        arrays.emplace_back(new CircularArray(cap));
+        array.store(arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // approximate, if other threads are working on the deque
+    std::int64_t size() const {
+        std::int64_t b = bottom.load(std::memory_order_relaxed), t = top.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    std::int64_t capacity() const { return array.load(std::memory_order_relaxed)->capacity(); }
+
+    // OWNER only: push a task at the bottom
+    void push(T x) {
+        const std::int64_t b = bottom.load(std::memory_order_relaxed);
+        const std::int64_t t = top.load(std::memory_order_acquire);
+        CircularArray* a = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity() - 1) { // full
+            a = a->grow(t, b);
+            arrays.emplace_back(a); // only the owner touches arrays
+            array.store(a, std::memory_order_release); }
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b+1, std::memory_order_relaxed);
+    }
+
+    // OWNER only: pop the task at the bottom (the most recently pushed). Returns false if the deque is empty
+    bool pop(T& out) {
+        const std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        CircularArray* a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) { // the deque was empty
+            bottom.store(b+1, std::memory_order_relaxed);
+            return false; }
+        out = a->get(b);
+        if (t == b) { // the last task: race any thieves for it
+            const bool won = top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b+1, std::memory_order_relaxed);
+            return won; }
+        return true;
+    }
+
+    /* ANY thread: steal the task at the top (the oldest). Returns false if the deque is empty, or if another thread took
+       the task first (in which case a retry may succeed) */
+    bool steal(T& out) {
+        std::int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return false; // empty
+        CircularArray* a = array.load(std::memory_order_acquire);
+        T x = a->get(t);
+        if (!top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed)) return false;
+        out = x;
+        return true;
+    }
+};
+
+#endif
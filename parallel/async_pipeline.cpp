@@ -0,0 +1,584 @@
+/*
+Overlapping I/O and computation with C++20 COROUTINES
+
+Every other program in this repository is strictly synchronous: e.g. strategy.cpp reads its input with a blocking
+ifstream, and proxy.cpp and prototype_after.cpp sit in blocking loops on cin. A program that reads a large file in
+chunks and processes each chunk therefore alternates between waiting for the disk (with the CPU idle) and computing
+(with the disk idle). If instead we start reading chunk k+1 before processing chunk k, the two overlap and, when
+they take similar times, the whole job runs up to twice as fast.
+
+Writing this with threads and callbacks quickly becomes unreadable. A COROUTINE is a function that can SUSPEND itself
+part-way through (at a "co_await" expression) and be RESUMED later, possibly on another thread, with all of its local
+variables intact. This lets asynchronous code be written as if it were sequential:
+    task<uint64_t> process_file(...) {
+        size_t n = co_await io.read(fd, buf, size, offset);   // suspends until the data has arrived; no thread blocks
+        ... }
+C++20 provides only the language mechanism (co_await, co_return, and the promise_type/awaiter protocol through which
+the compiler-generated coroutine code talks to library code). The library parts are written here:
+    - task<T>: a LAZY coroutine returning a T. It starts running when it is co_awaited, and on completion resumes the
+      coroutine that awaited it ("symmetric transfer", so that long chains of tasks do not grow the stack)
+    - ThreadPoolScheduler: worker threads that resume coroutines. "co_await pool.schedule()" moves the rest of the
+      coroutine onto a worker thread
+    - when_all(t1, t2, ...): runs several tasks concurrently and resumes the caller when all of them have finished,
+      with a tuple of their results
+    - sync_wait(t): runs a task from ordinary (non-coroutine) code, blocking until it has finished
+    - IoContext::read(): an awaitable file read. It uses Linux io_uring, where the program places read requests in a
+      ring buffer shared with the kernel and the kernel places completions in another, so there is no thread blocked in
+      read(). A separate thread waits for the completions and hands the suspended coroutines back to the pool. If
+      io_uring is not available (older kernels, or forbidden by a container's seccomp policy) a dedicated I/O thread
+      does blocking pread() calls instead. NB epoll cannot be used for this: regular files are always "ready" as far as
+      epoll is concerned, so it does not make file reads asynchronous
+We talk to io_uring through its raw system calls, to avoid a dependency on the liburing library.
+
+The main() function writes a test file and then checksums it chunk by chunk, first reading and computing serially,
+then with the read of the next chunk overlapped with the computation on the current one. The file's pages are dropped
+from the page cache before each run, so that the reads really go to the disk.
+
+Compile with:
+g++ -std=c++20 -O2 -o async_pipeline async_pipeline.cpp -pthread
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <queue>
+#include <tuple>
+#include <optional>
+#include <utility>
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+using namespace std;
+
+/* ---------------------------------------------------------------- task<T> */
+
+template <class T> class task;
+
+// the parts of the promise shared by task<T> and task<void>
+struct task_promise_base {
+
+    coroutine_handle<> continuation; // the coroutine waiting for this one
+    exception_ptr error;
+
+    // lazy: do not start running until co_awaited
+    suspend_always initial_suspend() noexcept { return {}; }
+
+    // on completion, transfer control straight to the waiting coroutine
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        template <class Promise>
+        coroutine_handle<> await_suspend(coroutine_handle<Promise> h) noexcept {
+            coroutine_handle<> c = h.promise().continuation;
+            return c ? c : noop_coroutine(); }
+        void await_resume() noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { error = current_exception(); }
+};
+
+template <class T>
+struct task_promise : task_promise_base {
+    optional<T> value;
+    task<T> get_return_object();
+    void return_value(T v) { value = std::move(v); }
+    T result() {
+        if (error) rethrow_exception(error);
+        return std::move(*value); }
+};
+
+template <>
+struct task_promise<void> : task_promise_base {
+    task<void> get_return_object();
+    void return_void() {}
+    void result() { if (error) rethrow_exception(error); }
+};
+
+template <class T>
+class task {
+
+    public:
+
+    using promise_type = task_promise<T>;
+    using handle_type = coroutine_handle<promise_type>;
+
+    explicit task(handle_type h) : h(h) {}
+    task(task&& rhs) noexcept : h(rhs.h) { rhs.h = nullptr; }
+    task& operator=(task&& rhs) noexcept {
+        if (this != &rhs) {
+            if (h) h.destroy();
+            h = rhs.h;
+            rhs.h = nullptr; }
+        return *this; }
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+    ~task() { if (h) h.destroy(); }
+
+    // co_await starts the task, and resumes the awaiting coroutine with the result when the task has finished
+    auto operator co_await() {
+        struct awaiter {
+            handle_type h;
+            bool await_ready() { return false; }
+            coroutine_handle<> await_suspend(coroutine_handle<> awaiting) {
+                h.promise().continuation = awaiting;
+                return h; }
+            T await_resume() { return h.promise().result(); }
+        };
+        return awaiter{h};
+    }
+
+    private:
+
+    handle_type h;
+};
+
+template <class T>
+task<T> task_promise<T>::get_return_object() { return task<T>(coroutine_handle<task_promise<T>>::from_promise(*this)); }
+
+inline task<void> task_promise<void>::get_return_object() {
+    return task<void>(coroutine_handle<task_promise<void>>::from_promise(*this)); }
+
+/* a coroutine that starts immediately and destroys itself when finished. Used internally to drive tasks from
+   sync_wait() and when_all() */
+struct detached_task {
+    struct promise_type {
+        detached_task get_return_object() { return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+};
+
+/* ---------------------------------------------------------------- scheduler */
+
+class ThreadPoolScheduler {
+
+    vector<thread> workers;
+    queue<coroutine_handle<>> ready;
+    mutex m;
+    condition_variable cv;
+    bool stopping = false;
+
+    void worker_loop() {
+        while (true) {
+            coroutine_handle<> h;
+            {
+            unique_lock<mutex> lock(m);
+            cv.wait(lock, [&]() { return stopping || !ready.empty(); });
+            if (ready.empty()) return; // stopping, and nothing left to do
+            h = ready.front();
+            ready.pop();
+            }
+            h.resume();
+        }
+    }
+
+    public:
+
+    ThreadPoolScheduler(int n_threads=thread::hardware_concurrency()) {
+        for (int i=0;i<max(n_threads,1);i++) workers.emplace_back(&ThreadPoolScheduler::worker_loop, this);
+    }
+
+    ~ThreadPoolScheduler() {
+        {
+        lock_guard<mutex> lock(m);
+        stopping = true;
+        }
+        cv.notify_all();
+        for (auto& w: workers) w.join();
+    }
+
+    // queue a suspended coroutine to be resumed by a worker thread
+    void post(coroutine_handle<> h) {
+        {
+        lock_guard<mutex> lock(m);
+        ready.push(h);
+        }
+        cv.notify_one();
+    }
+
+    // co_await pool.schedule() continues the current coroutine on a worker thread
+    auto schedule() {
+        struct awaiter {
+            ThreadPoolScheduler* pool;
+            bool await_ready() { return false; }
+            void await_suspend(coroutine_handle<> h) { pool->post(h); }
+            void await_resume() {}
+        };
+        return awaiter{this};
+    }
+};
+
+/* ---------------------------------------------------------------- sync_wait and when_all */
+
+template <class T>
+detached_task sync_wait_driver(task<T>& t, optional<T>& result, exception_ptr& error, mutex& m, condition_variable& cv,
+                               bool& done) {
+    try {
+        result = co_await t;
+    } catch (...) {
+        error = current_exception(); }
+    lock_guard<mutex> lock(m);
+    done = true;
+    cv.notify_one();
+}
+
+// run a task from non-coroutine code, and block until it has finished
+template <class T>
+T sync_wait(task<T> t) {
+    optional<T> result;
+    exception_ptr error;
+    mutex m;
+    condition_variable cv;
+    bool done = false;
+    sync_wait_driver(t, result, error, m, cv, done);
+    unique_lock<mutex> lock(m);
+    cv.wait(lock, [&]() { return done; });
+    if (error) rethrow_exception(error);
+    return std::move(*result);
+}
+
+// the shared state of a when_all(): a count of the tasks still running, and the coroutine to resume at the end
+struct WhenAllState {
+    atomic<int> remaining{0};
+    coroutine_handle<> waiting;
+    exception_ptr error;
+    mutex error_mutex;
+
+    // called once by each finished task (and once by the awaiter itself). The last one resumes the waiting coroutine
+    bool arrive() { return remaining.fetch_sub(1) == 1; }
+};
+
+template <class T>
+detached_task when_all_driver(task<T>& t, optional<T>& result, WhenAllState& state) {
+    try {
+        result = co_await t;
+    } catch (...) {
+        lock_guard<mutex> lock(state.error_mutex);
+        if (!state.error) state.error = current_exception(); }
+    if (state.arrive()) state.waiting.resume();
+}
+
+template <class... Ts, size_t... Is>
+void start_all(tuple<task<Ts>...>& tasks, tuple<optional<Ts>...>& results, WhenAllState& state, index_sequence<Is...>) {
+    (when_all_driver(get<Is>(tasks), get<Is>(results), state), ...);
+}
+
+/* run the tasks concurrently (each one runs on the calling thread until its first suspension, so tasks that compute
+   should start with co_await pool.schedule()) and return all of their results. If any task throws, the first
+   exception is rethrown once all of the tasks have finished */
+template <class... Ts>
+task<tuple<Ts...>> when_all(task<Ts>... tasks_in) {
+    tuple<task<Ts>...> tasks(std::move(tasks_in)...);
+    tuple<optional<Ts>...> results;
+    WhenAllState state;
+
+    struct awaiter {
+        tuple<task<Ts>...>& tasks;
+        tuple<optional<Ts>...>& results;
+        WhenAllState& state;
+        bool await_ready() { return false; }
+        bool await_suspend(coroutine_handle<> h) {
+            state.waiting = h;
+            state.remaining = sizeof...(Ts) + 1;
+            start_all(tasks, results, state, index_sequence_for<Ts...>());
+            return !state.arrive(); // if every task has already finished, do not suspend at all
+        }
+        void await_resume() {}
+    };
+    co_await awaiter{tasks, results, state};
+
+    if (state.error) rethrow_exception(state.error);
+    co_return apply([](optional<Ts>&... r) { return tuple<Ts...>(std::move(*r)...); }, results);
+}
+
+/* ---------------------------------------------------------------- asynchronous file reads */
+
+class IoContext {
+
+    // a read request, which lives in the frame of the suspended coroutine while the read is in flight
+    struct ReadOp {
+        int fd;
+        void* buf;
+        size_t len;
+        off_t offset;
+        iovec iov;
+        long result = 0; // bytes read, or -errno
+        coroutine_handle<> h;
+    };
+
+    ThreadPoolScheduler& pool;
+    thread completion_thread;
+
+    // io_uring state
+    bool use_uring = false;
+    int ring_fd = -1;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_entries, *sq_array, *cq_head, *cq_tail, *cq_mask;
+    io_uring_sqe* sqes;
+    io_uring_cqe* cqes;
+    void *sq_ring_ptr = nullptr, *cq_ring_ptr = nullptr;
+    size_t sq_ring_size = 0, cq_ring_size = 0, sqes_size = 0;
+    mutex submit_mutex;
+
+    // fallback state: a queue of requests for a blocking I/O thread
+    queue<ReadOp*> pending;
+    mutex pending_mutex;
+    condition_variable pending_cv;
+    bool stopping = false;
+
+    bool setup_uring(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+        if (ring_fd < 0) return false;
+
+        sq_ring_size = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) sq_ring_size = cq_ring_size = max(sq_ring_size, cq_ring_size);
+        sq_ring_ptr = mmap(nullptr, sq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ring_ptr == MAP_FAILED) { close(ring_fd); return false; }
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cq_ring_ptr = sq_ring_ptr;
+        } else {
+            cq_ring_ptr = mmap(nullptr, cq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+            if (cq_ring_ptr == MAP_FAILED) { munmap(sq_ring_ptr, sq_ring_size); close(ring_fd); return false; } }
+        sqes_size = params.sq_entries*sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe*)mmap(nullptr, sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) { close(ring_fd); return false; }
+
+        char* sq = (char*)sq_ring_ptr;
+        char* cq = (char*)cq_ring_ptr;
+        sq_head = (unsigned*)(sq + params.sq_off.head);
+        sq_tail = (unsigned*)(sq + params.sq_off.tail);
+        sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+        sq_entries = (unsigned*)(sq + params.sq_off.ring_entries);
+        sq_array = (unsigned*)(sq + params.sq_off.array);
+        cq_head = (unsigned*)(cq + params.cq_off.head);
+        cq_tail = (unsigned*)(cq + params.cq_off.tail);
+        cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // place one request in the submission ring and tell the kernel about it
+    void submit_sqe(uint8_t opcode, ReadOp* op) {
+        lock_guard<mutex> lock(submit_mutex);
+        unsigned tail = *sq_tail;
+        // the ring is full if the kernel has not yet consumed *sq_entries earlier submissions (it consumes them
+        // during io_uring_enter(), which we call after every submission, so this does not happen in practice)
+        while (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= *sq_entries) this_thread::yield();
+        unsigned index = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = opcode;
+        if (op) {
+            sqe->fd = op->fd;
+            sqe->addr = (uint64_t)&op->iov;
+            sqe->len = 1;
+            sqe->off = op->offset; }
+        sqe->user_data = (uint64_t)op; // a NOP with user_data 0 tells the completion thread to stop
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail+1, __ATOMIC_RELEASE); // the kernel must see the filled entry before the new tail
+        if (syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0) < 0) {
+            throw runtime_error("error in IoContext: io_uring_enter() failed"); }
+    }
+
+    // wait for completions, and hand each completed coroutine back to the pool
+    void uring_completion_loop() {
+        while (true) {
+            unsigned head = *cq_head;
+            if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                continue; }
+            io_uring_cqe* cqe = &cqes[head & *cq_mask];
+            ReadOp* op = (ReadOp*)cqe->user_data;
+            long res = cqe->res;
+            __atomic_store_n(cq_head, head+1, __ATOMIC_RELEASE); // the kernel may now reuse this completion entry
+            if (!op) return;
+            op->result = res;
+            pool.post(op->h);
+        }
+    }
+
+    void blocking_io_loop() {
+        while (true) {
+            ReadOp* op;
+            {
+            unique_lock<mutex> lock(pending_mutex);
+            pending_cv.wait(lock, [&]() { return stopping || !pending.empty(); });
+            if (pending.empty()) return;
+            op = pending.front();
+            pending.pop();
+            }
+            ssize_t n = pread(op->fd, op->buf, op->len, op->offset);
+            op->result = (n < 0) ? -errno : n;
+            pool.post(op->h);
+        }
+    }
+
+    public:
+
+    IoContext(ThreadPoolScheduler& pool, bool try_uring=true) : pool(pool) {
+        use_uring = try_uring && setup_uring(256);
+        if (use_uring) {
+            completion_thread = thread(&IoContext::uring_completion_loop, this);
+        } else {
+            completion_thread = thread(&IoContext::blocking_io_loop, this); }
+    }
+
+    IoContext(const IoContext&) = delete;
+    IoContext& operator=(const IoContext&) = delete;
+
+    ~IoContext() {
+        if (use_uring) {
+            submit_sqe(IORING_OP_NOP, nullptr);
+            completion_thread.join();
+            munmap(sqes, sqes_size);
+            if (cq_ring_ptr != sq_ring_ptr) munmap(cq_ring_ptr, cq_ring_size);
+            munmap(sq_ring_ptr, sq_ring_size);
+            close(ring_fd);
+        } else {
+            {
+            lock_guard<mutex> lock(pending_mutex);
+            stopping = true;
+            }
+            pending_cv.notify_all();
+            completion_thread.join(); }
+    }
+
+    string backend() const { return use_uring ? "io_uring" : "blocking I/O thread"; }
+
+    /* co_await io.read(fd, buf, len, offset) reads up to len bytes at offset, and returns the number of bytes read.
+       The coroutine is resumed on a pool thread */
+    auto read(int fd, void* buf, size_t len, off_t offset) {
+        struct awaiter {
+            IoContext* io;
+            ReadOp op;
+            bool await_ready() { return false; }
+            void await_suspend(coroutine_handle<> h) {
+                op.h = h;
+                op.iov = iovec{op.buf, op.len};
+                /* once &op is handed over, the read may complete and resume h on another thread at any moment, which
+                   destroys this awaiter: from then on, only local variables may be used */
+                IoContext* const context = io;
+                if (context->use_uring) {
+                    context->submit_sqe(IORING_OP_READV, &op); // READV rather than READ, for kernels older than 5.6
+                } else {
+                    {
+                    lock_guard<mutex> lock(context->pending_mutex);
+                    context->pending.push(&op);
+                    }
+                    context->pending_cv.notify_one(); }
+            }
+            size_t await_resume() {
+                if (op.result < 0) throw runtime_error(string("error in IoContext::read(): ") + strerror(-op.result));
+                return op.result; }
+        };
+        return awaiter{this, ReadOp{fd, buf, len, offset, iovec{}, 0, nullptr}};
+    }
+};
+
+/* ---------------------------------------------------------------- the pipeline */
+
+// the "computation" on each chunk: a few rounds of a multiplicative hash over every byte
+uint64_t checksum(const char* data, size_t n) {
+    uint64_t h = 1469598103934665603ULL;
+    for (int round=0;round<4;round++) {
+        for (size_t i=0;i<n;i++) h = (h ^ (unsigned char)data[i]) * 1099511628211ULL; }
+    return h;
+}
+
+task<size_t> read_chunk(IoContext& io, int fd, char* buf, size_t len, off_t offset) {
+    co_return co_await io.read(fd, buf, len, offset);
+}
+
+task<uint64_t> compute_chunk(ThreadPoolScheduler& pool, const char* buf, size_t n) {
+    co_await pool.schedule(); // run on a pool thread, concurrently with the read
+    co_return checksum(buf, n);
+}
+
+// serial: read a chunk, then process it, then read the next one...
+task<uint64_t> process_serial(IoContext& io, int fd, size_t chunk_size) {
+    vector<char> buf(chunk_size);
+    uint64_t total = 0;
+    off_t offset = 0;
+    while (true) {
+        size_t n = co_await io.read(fd, buf.data(), chunk_size, offset);
+        if (n == 0) break;
+        total += checksum(buf.data(), n);
+        offset += n; }
+    co_return total;
+}
+
+// pipelined: process chunk k while chunk k+1 is being read (DOUBLE BUFFERING)
+task<uint64_t> process_pipelined(ThreadPoolScheduler& pool, IoContext& io, int fd, size_t chunk_size) {
+    vector<char> current(chunk_size), next(chunk_size);
+    uint64_t total = 0;
+    off_t offset = 0;
+    size_t n = co_await io.read(fd, current.data(), chunk_size, offset);
+    while (n > 0) {
+        auto [n_next, sum] = co_await when_all(read_chunk(io, fd, next.data(), chunk_size, offset+n),
+                                               compute_chunk(pool, current.data(), n));
+        total += sum;
+        offset += n;
+        n = n_next;
+        swap(current, next); }
+    co_return total;
+}
+
+// write the data to disk and drop the file's pages from the page cache, so that the next read comes from the disk
+void evict_from_page_cache(int fd) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+int main () {
+
+    const string filename = "async_pipeline_test.dat";
+    const size_t file_size = size_t(256) << 20, chunk_size = size_t(4) << 20;
+
+    int fd = open(filename.c_str(), O_RDWR|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0) { cout << "error: could not create " << filename << endl; return 1; }
+    vector<char> block(chunk_size);
+    for (size_t i=0;i<chunk_size;i++) block[i] = char(i*7 + i/4096);
+    for (size_t written=0;written<file_size;written+=chunk_size) {
+        if (write(fd, block.data(), chunk_size) != ssize_t(chunk_size)) { cout << "error writing test file" << endl; return 1; } }
+
+    ThreadPoolScheduler pool;
+    IoContext io(pool);
+    cout << "Checksumming a " << (file_size>>20) << " MB file in " << (chunk_size>>20) << " MB chunks, reads via " \
+         << io.backend() << endl;
+
+    auto run = [&](const string& name, task<uint64_t> t) {
+        auto t_start = chrono::steady_clock::now();
+        uint64_t sum = sync_wait(std::move(t));
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+        cout << setw(30) << left << name << right << setw(10) << fixed << setprecision(1) << 1.0e3*seconds \
+             << " ms   checksum " << hex << sum << dec << endl; };
+
+    evict_from_page_cache(fd);
+    run("serial read then compute", process_serial(io, fd, chunk_size));
+    evict_from_page_cache(fd);
+    run("overlapped read and compute", process_pipelined(pool, io, fd, chunk_size));
+
+    close(fd);
+    unlink(filename.c_str());
+
+    return 0;
+}
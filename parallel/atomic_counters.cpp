@@ -0,0 +1,216 @@
+/*
+Strategies for updating a shared counter from many threads
+
+In privacy.cpp we used "#pragma omp atomic" to protect simple updates (y++, x += y) of shared integers.
+The "atomic" directive is only one of several ways of achieving a correct result, and they do not cost the same:
+    - "omp atomic": the compiler emits a single hardware read-modify-write instruction (e.g. lock xadd on x86)
+    - "omp critical": a lock is taken around the statement, so only one thread at a time may execute it. This
+      is much more general (any block of code) but much slower for a single integer update
+    - std::atomic<T>::fetch_add(): the C++11 equivalent of "omp atomic". The MEMORY ORDER argument specifies what
+      ordering guarantees the update gives with respect to other memory operations. For a pure counter that is only
+      read after the threads have joined, std::memory_order_relaxed is enough. std::memory_order_seq_cst (the default)
+      additionally imposes a single total order on all seq_cst operations, which may cost a full memory fence
+    - compare-and-swap (CAS) loop: read the value, compute the new value, and try to swap it in with
+      compare_exchange_weak(), retrying if another thread got there first. This is how arbitrary atomic
+      read-modify-write operations are built, but under contention many attempts fail and must be retried
+    - SHARDING: each thread updates its own private slot (padded to a cache line, to avoid FALSE SHARING, where
+      independent variables that happen to live on the same cache line cause the line to bounce between cores) and
+      the slots are summed (reduced) when the value is read. There is no contention at all during updates
+
+All of the atomic variants above serialise on a single cache line when many threads hit the same counter, so the
+best strategy depends on the number of threads and on how often the counter is updated (the CONTENTION).
+
+Here we wrap each strategy in a POLICY class and write a single Counter<Policy> class template, so that the
+strategy can be switched at compile time without touching the code that uses the counter, e.g.:
+    Counter<ShardedPolicy> n_visited;
+    #pragma omp parallel for
+    for (int i=0;i<n;i++) { ... n_visited.increment(); }
+    cout << n_visited.value() << endl;
+
+The main() function is a microbenchmark that times each policy across thread counts and contention levels (the amount
+of private work done between successive updates of the counter), and checks that every policy gives the exact count.
+
+Compile with:
+g++ -std=c++17 -O2 -o atomic_counters atomic_counters.cpp -fopenmp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <omp.h>
+
+using namespace std;
+
+const int cache_line_size = 64;
+
+/* POLICIES. Each policy holds the state of the counter and provides add() and load(). load() is only guaranteed
+   to give the exact total once all updating threads have joined */
+
+struct OmpAtomicPolicy {
+
+    static string name() { return "omp atomic"; }
+
+    long count = 0;
+
+    void add(long v) {
+        #pragma omp atomic
+        count += v;
+    }
+
+    long load() const { return count; }
+};
+
+struct OmpCriticalPolicy {
+
+    static string name() { return "omp critical"; }
+
+    long count = 0;
+
+    void add(long v) {
+        // a named critical section, so that this lock is not shared with unnamed critical sections elsewhere
+        #pragma omp critical(counter_update)
+        count += v;
+    }
+
+    long load() const { return count; }
+};
+
+// fetch_add with a specified memory ordering
+template <memory_order Order>
+struct FetchAddPolicy {
+
+    static string name() {
+        return Order==memory_order_relaxed ? "fetch_add relaxed" : "fetch_add seq_cst"; }
+
+    atomic<long> count{0};
+
+    void add(long v) { count.fetch_add(v, Order); }
+
+    long load() const { return count.load(); }
+};
+
+// compare-and-swap loop with a specified memory ordering (on success)
+template <memory_order Order>
+struct CasLoopPolicy {
+
+    static string name() {
+        return Order==memory_order_relaxed ? "CAS loop relaxed" : "CAS loop seq_cst"; }
+
+    atomic<long> count{0};
+
+    void add(long v) {
+        long expected = count.load(memory_order_relaxed);
+        /* if count has changed since we read it, compare_exchange_weak() fails and stores the current value in
+           expected, so we simply try again (the weak form may also fail spuriously, which is fine in a loop) */
+        while (!count.compare_exchange_weak(expected, expected+v, Order, memory_order_relaxed)) {}
+    }
+
+    long load() const { return count.load(); }
+};
+
+// one slot per thread, each on its own cache line, summed on load()
+struct ShardedPolicy {
+
+    static string name() { return "sharded"; }
+
+    struct alignas(cache_line_size) Shard { long count = 0; };
+
+    vector<Shard> shards;
+
+    // NB must be constructed outside of the parallel region, with enough slots for every thread that will update it
+    ShardedPolicy() : shards(omp_get_max_threads()) {}
+
+    void add(long v) { shards[omp_get_thread_num()].count += v; }
+
+    long load() const {
+        long total = 0;
+        for (const auto& shard: shards) total += shard.count;
+        return total; }
+};
+
+// the counter itself: the interface is the same whatever the choice of update strategy
+template <class Policy>
+class Counter {
+
+    Policy impl;
+
+    public:
+
+    Counter() {}
+    Counter(const Counter&) = delete; // atomic state cannot be meaningfully copied
+    Counter& operator=(const Counter&) = delete;
+
+    void add(long v) { impl.add(v); }
+    void increment() { impl.add(1); }
+    long value() const { return impl.load(); }
+
+    static string name() { return Policy::name(); }
+};
+
+// a small amount of private (non-shared) work done between updates, which sets the contention level
+inline double private_work(int n_flops, double x) {
+    for (int k=0;k<n_flops;k++) x = x*0.999999 + 1.0e-6;
+    return x;
+}
+
+/* time n_updates increments of a single Counter<Policy>, shared by n_threads threads, with n_flops of private work
+   between successive updates. Returns the time per update in nanoseconds */
+template <class Policy>
+double time_counter(int n_threads, long n_updates, int n_flops) {
+
+    Counter<Policy> counter;
+    double sink = 0.;
+
+    double t_start = omp_get_wtime();
+    #pragma omp parallel for num_threads(n_threads) reduction(+:sink) schedule(static)
+    for (long i=0;i<n_updates;i++) {
+        sink += private_work(n_flops, double(i));
+        counter.increment();
+    }
+    double t_elapsed = omp_get_wtime() - t_start;
+
+    if (counter.value() != n_updates) {
+        cout << "error: " << Counter<Policy>::name() << " counted " << counter.value() << " of " << n_updates \
+             << " updates" << endl; }
+    volatile double result = sink; // use the result of the private work, so that it is not optimised away
+    (void)result;
+    return 1.0e9*t_elapsed/double(n_updates);
+}
+
+template <class Policy>
+void benchmark_policy(const vector<int>& thread_counts, long n_updates, int n_flops) {
+    cout << setw(20) << left << Counter<Policy>::name() << right;
+    for (int n_threads: thread_counts) {
+        cout << setw(12) << fixed << setprecision(2) << time_counter<Policy>(n_threads, n_updates, n_flops); }
+    cout << endl;
+}
+
+int main () {
+
+    const int max_no_threads = omp_get_max_threads();
+    const long n_updates = 10000000;
+
+    vector<int> thread_counts;
+    for (int n=1;n<max_no_threads;n*=2) thread_counts.push_back(n);
+    thread_counts.push_back(max_no_threads);
+
+    // 0 flops between updates is the worst case (pure contention); with more private work the updates collide less
+    for (int n_flops: {0, 10, 100}) {
+        cout << "\nns per update, " << n_flops << " flops of private work between updates" << endl;
+        cout << setw(20) << left << "threads:" << right;
+        for (int n_threads: thread_counts) cout << setw(12) << n_threads;
+        cout << endl;
+
+        benchmark_policy<OmpAtomicPolicy>(thread_counts, n_updates, n_flops);
+        benchmark_policy<OmpCriticalPolicy>(thread_counts, n_updates, n_flops);
+        benchmark_policy<FetchAddPolicy<memory_order_relaxed>>(thread_counts, n_updates, n_flops);
+        benchmark_policy<FetchAddPolicy<memory_order_seq_cst>>(thread_counts, n_updates, n_flops);
+        benchmark_policy<CasLoopPolicy<memory_order_relaxed>>(thread_counts, n_updates, n_flops);
+        benchmark_policy<CasLoopPolicy<memory_order_seq_cst>>(thread_counts, n_updates, n_flops);
+        benchmark_policy<ShardedPolicy>(thread_counts, n_updates, n_flops);
+    }
+
+    return 0;
+}
@@ -0,0 +1,392 @@
+/*
+Interchangeable parallel BACKENDS: OpenMP, a std::thread pool, or the C++17 execution policies
+
+Everything else in this directory uses OpenMP directly, so every program must be compiled with -fopenmp and linked
+against an OpenMP runtime. That is not always acceptable: a program that is embedded in an application which already
+has its own thread pool should not start a second set of threads (OpenMP's), since the two sets would compete for the
+same cores (OVERSUBSCRIPTION), and the threads would keep being descheduled in the middle of their work.
+
+Here we write the three basic parallel algorithms once, against a small BACKEND interface:
+    parallel_for(n, f)                       calls f(i) for i = 0..n-1
+    parallel_reduce(n, identity, f, op)      returns identity op f(0) op f(1) op ... op f(n-1)
+    parallel_scan(in, out, n, op, identity)  inclusive scan (see scan.cpp): out[i] = in[0] op ... op in[i]
+with the following backends:
+    - OpenMPBackend: "#pragma omp parallel", available only when compiled with -fopenmp
+    - ThreadPoolBackend: a fork-join pool of std::threads. The pool is reached through the abstract Executor class,
+      so an application can plug in its own thread pool by implementing Executor and calling set_executor()
+    - StdParBackend: the C++17 parallel algorithms, std::for_each / std::transform_reduce / std::inclusive_scan with the
+      std::execution::par_unseq policy (with GCC these run on Intel TBB)
+    - SerialBackend: plain loops, as a reference
+The OpenMP and thread pool backends share the same CHUNKED implementation of the algorithms (written once in the
+ChunkedBackend base class): the index range is split into chunks, and the backend only has to provide run_chunks(),
+which runs a function on every chunk in parallel. This is the "curiously recurring template pattern" (CRTP): the base
+class template takes the derived class as a template parameter, so it can call the derived class's run_chunks()
+without virtual functions, and the loop bodies can still be inlined.
+
+A backend is chosen either at compile time, as a template argument:
+    double sum = ThreadPoolBackend::parallel_reduce(n, 0., [&](size_t i) { return v[i]; }, plus<double>());
+or at run time, with the Backend enum (e.g. from a command line argument or configuration file):
+    double sum = parallel_reduce(Backend::std_par, n, 0., [&](size_t i) { return v[i]; }, plus<double>());
+The main() function checks and times each algorithm on each backend. A backend can be chosen on the command line,
+e.g. ./backends thread_pool
+
+Compile with:
+g++ -std=c++17 -O2 -o backends backends.cpp -fopenmp -pthread -ltbb
+or, without any OpenMP runtime at all:
+g++ -std=c++17 -O2 -o backends backends.cpp -pthread -ltbb
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <execution>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+/* an Executor runs n_tasks calls task(0), ..., task(n_tasks-1) in parallel, and returns when they have all finished.
+   This is all that the thread pool backend needs from a thread pool */
+class Executor {
+    public:
+    virtual ~Executor() {}
+    virtual int concurrency() const = 0; // the number of tasks that can usefully run at the same time
+    virtual void run(int n_tasks, const function<void(int)>& task) = 0;
+};
+
+/* a simple fork-join thread pool. The calling thread takes part in the work, so the pool only starts
+   n_threads-1 extra threads. The tasks are handed out dynamically through an atomic counter, so a slow task does
+   not hold up the others. NB run() must not be called from inside a task (the pool is not reentrant) */
+class ThreadPool : public Executor {
+
+    vector<thread> workers;
+    mutex m;
+    condition_variable cv_start, cv_done;
+    const function<void(int)>* job = nullptr;
+    int n_tasks = 0;
+    atomic<int> next_task{0};
+    long generation = 0; // incremented for every call to run(), so that the workers know there is new work
+    int n_working = 0;
+    bool stopping = false;
+
+    void do_tasks() {
+        int t;
+        while ((t = next_task++) < n_tasks) (*job)(t);
+    }
+
+    void worker_loop() {
+        long seen_generation = 0;
+        while (true) {
+            {
+            unique_lock<mutex> lock(m);
+            cv_start.wait(lock, [&]() { return stopping || generation != seen_generation; });
+            if (stopping) return;
+            seen_generation = generation;
+            }
+            do_tasks();
+            lock_guard<mutex> lock(m);
+            if (--n_working == 0) cv_done.notify_one();
+        }
+    }
+
+    public:
+
+    ThreadPool(int n_threads=thread::hardware_concurrency()) {
+        for (int i=1;i<max(n_threads,1);i++) workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+        lock_guard<mutex> lock(m);
+        stopping = true;
+        }
+        cv_start.notify_all();
+        for (auto& w: workers) w.join();
+    }
+
+    int concurrency() const override { return workers.size() + 1; }
+
+    void run(int n, const function<void(int)>& task) override {
+        {
+        lock_guard<mutex> lock(m);
+        job = &task;
+        n_tasks = n;
+        next_task = 0;
+        n_working = workers.size();
+        generation++;
+        }
+        cv_start.notify_all();
+        do_tasks();
+        unique_lock<mutex> lock(m);
+        cv_done.wait(lock, [&]() { return n_working == 0; });
+    }
+};
+
+// the executor used by ThreadPoolBackend. By default a ThreadPool with one thread per core, created when first used
+Executor*& executor_ptr() {
+    static Executor* executor = nullptr;
+    return executor;
+}
+
+Executor& get_executor() {
+    if (!executor_ptr()) {
+        static ThreadPool default_pool;
+        executor_ptr() = &default_pool; }
+    return *executor_ptr();
+}
+
+// use the application's own thread pool (which must outlive any use of ThreadPoolBackend)
+void set_executor(Executor* executor) { executor_ptr() = executor; }
+
+/* the algorithms, for any backend that provides
+       static int concurrency();
+       static void run_chunks(int n_chunks, F chunk_func);   // calls chunk_func(c) for c = 0..n_chunks-1, in parallel */
+template <class Derived>
+struct ChunkedBackend {
+
+    // [lo, hi) of chunk c, when n elements are split into n_chunks
+    static pair<size_t,size_t> chunk_range(size_t n, int n_chunks, int c) {
+        return make_pair(n*c/n_chunks, n*(c+1)/n_chunks);
+    }
+
+    // a few chunks per thread, for load balance
+    static int default_chunks(size_t n) {
+        return int(min<size_t>(n, 4*size_t(Derived::concurrency())));
+    }
+
+    template <class F>
+    static void parallel_for(size_t n, F f) {
+        if (n == 0) return;
+        const int n_chunks = default_chunks(n);
+        Derived::run_chunks(n_chunks, [&](int c) {
+            pair<size_t,size_t> r = chunk_range(n, n_chunks, c);
+            for (size_t i=r.first;i<r.second;i++) f(i); });
+    }
+
+    // the partial results are combined in chunk order, so op need not be commutative, and the result is deterministic
+    template <class T, class F, class Op>
+    static T parallel_reduce(size_t n, T identity, F f, Op op) {
+        if (n == 0) return identity;
+        const int n_chunks = default_chunks(n);
+        vector<T> partial(n_chunks, identity);
+        Derived::run_chunks(n_chunks, [&](int c) {
+            pair<size_t,size_t> r = chunk_range(n, n_chunks, c);
+            T acc = identity;
+            for (size_t i=r.first;i<r.second;i++) acc = op(acc, f(i));
+            partial[c] = acc; });
+        T result = identity;
+        for (const T& p: partial) result = op(result, p);
+        return result;
+    }
+
+    // the two-pass blocked scan of scan.cpp
+    template <class T, class Op>
+    static void parallel_scan(const T* in, T* out, size_t n, Op op, T identity) {
+        if (n == 0) return;
+        const int n_chunks = min<size_t>(n, Derived::concurrency());
+        vector<T> offsets(n_chunks+1, identity);
+        Derived::run_chunks(n_chunks, [&](int c) {
+            pair<size_t,size_t> r = chunk_range(n, n_chunks, c);
+            T acc = identity;
+            for (size_t i=r.first;i<r.second;i++) acc = op(acc, in[i]);
+            offsets[c+1] = acc; });
+        for (int c=1;c<=n_chunks;c++) offsets[c] = op(offsets[c-1], offsets[c]);
+        Derived::run_chunks(n_chunks, [&](int c) {
+            pair<size_t,size_t> r = chunk_range(n, n_chunks, c);
+            T acc = offsets[c];
+            for (size_t i=r.first;i<r.second;i++) {
+                acc = op(acc, in[i]);
+                out[i] = acc; } });
+    }
+};
+
+#ifdef _OPENMP
+struct OpenMPBackend : public ChunkedBackend<OpenMPBackend> {
+    static string name() { return "openmp"; }
+    static int concurrency() { return omp_get_max_threads(); }
+    template <class F>
+    static void run_chunks(int n_chunks, F chunk_func) {
+        #pragma omp parallel for schedule(dynamic,1)
+        for (int c=0;c<n_chunks;c++) chunk_func(c);
+    }
+};
+#endif
+
+struct ThreadPoolBackend : public ChunkedBackend<ThreadPoolBackend> {
+    static string name() { return "thread_pool"; }
+    static int concurrency() { return get_executor().concurrency(); }
+    template <class F>
+    static void run_chunks(int n_chunks, F chunk_func) {
+        get_executor().run(n_chunks, function<void(int)>(chunk_func)); // one indirect call per chunk, not per element
+    }
+};
+
+struct SerialBackend : public ChunkedBackend<SerialBackend> {
+    static string name() { return "serial"; }
+    static int concurrency() { return 1; }
+    template <class F>
+    static void run_chunks(int n_chunks, F chunk_func) {
+        for (int c=0;c<n_chunks;c++) chunk_func(c);
+    }
+};
+
+/* the standard library's parallel algorithms. These have no index-based interface, so parallel_for and
+   parallel_reduce run over a vector of chunk numbers. NB transform_reduce may combine the partial results in any
+   order, so here op must be commutative as well as associative */
+struct StdParBackend {
+
+    static string name() { return "std_par"; }
+
+    static vector<int> chunk_ids(size_t n) {
+        vector<int> ids(int(min<size_t>(n, 4*size_t(thread::hardware_concurrency()))));
+        iota(ids.begin(), ids.end(), 0);
+        return ids;
+    }
+
+    template <class F>
+    static void parallel_for(size_t n, F f) {
+        vector<int> ids = chunk_ids(n);
+        const int n_chunks = ids.size();
+        for_each(execution::par_unseq, ids.begin(), ids.end(), [&](int c) {
+            for (size_t i=n*c/n_chunks;i<n*(c+1)/n_chunks;i++) f(i); });
+    }
+
+    template <class T, class F, class Op>
+    static T parallel_reduce(size_t n, T identity, F f, Op op) {
+        vector<int> ids = chunk_ids(n);
+        const int n_chunks = ids.size();
+        return transform_reduce(execution::par_unseq, ids.begin(), ids.end(), identity, op, [&](int c) {
+            T acc = identity;
+            for (size_t i=n*c/n_chunks;i<n*(c+1)/n_chunks;i++) acc = op(acc, f(i));
+            return acc; });
+    }
+
+    template <class T, class Op>
+    static void parallel_scan(const T* in, T* out, size_t n, Op op, T) {
+        inclusive_scan(execution::par_unseq, in, in+n, out, op);
+    }
+};
+
+// RUN-TIME selection of the backend
+enum class Backend { serial, openmp, thread_pool, std_par };
+
+Backend backend_from_string(const string& name) {
+    if (name == "serial") return Backend::serial;
+#ifdef _OPENMP
+    if (name == "openmp") return Backend::openmp;
+#endif
+    if (name == "thread_pool") return Backend::thread_pool;
+    if (name == "std_par") return Backend::std_par;
+    throw invalid_argument("error in backend_from_string(): unknown or unavailable backend " + name);
+}
+
+vector<Backend> available_backends() {
+#ifdef _OPENMP
+    return {Backend::serial, Backend::openmp, Backend::thread_pool, Backend::std_par};
+#else
+    return {Backend::serial, Backend::thread_pool, Backend::std_par};
+#endif
+}
+
+/* call func with the backend type as a template argument, e.g.
+       with_backend(b, [&](auto backend) { using B = decltype(backend); B::parallel_for(n, f); }); */
+template <class Func>
+void with_backend(Backend b, Func func) {
+    switch (b) {
+#ifdef _OPENMP
+        case Backend::openmp: func(OpenMPBackend()); break;
+#else
+        case Backend::openmp: throw invalid_argument("error in with_backend(): compiled without OpenMP");
+#endif
+        case Backend::thread_pool: func(ThreadPoolBackend()); break;
+        case Backend::std_par: func(StdParBackend()); break;
+        default: func(SerialBackend()); break; }
+}
+
+string backend_name(Backend b) {
+    string name;
+    with_backend(b, [&](auto backend) { name = decltype(backend)::name(); });
+    return name;
+}
+
+template <class F>
+void parallel_for(Backend b, size_t n, F f) {
+    with_backend(b, [&](auto backend) { decltype(backend)::parallel_for(n, f); });
+}
+
+template <class T, class F, class Op>
+T parallel_reduce(Backend b, size_t n, T identity, F f, Op op) {
+    T result = identity;
+    with_backend(b, [&](auto backend) { result = decltype(backend)::parallel_reduce(n, identity, f, op); });
+    return result;
+}
+
+template <class T, class Op>
+void parallel_scan(Backend b, const T* in, T* out, size_t n, Op op, T identity) {
+    with_backend(b, [&](auto backend) { decltype(backend)::parallel_scan(in, out, n, op, identity); });
+}
+
+double seconds_since(chrono::steady_clock::time_point t_start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t_start).count();
+}
+
+int main (int argc, char* argv[]) {
+
+    vector<Backend> backends = available_backends();
+    if (argc > 1) {
+        try {
+            backends = {backend_from_string(argv[1])};
+        } catch (const invalid_argument& e) {
+            cout << e.what() << endl;
+            return 1; } }
+
+    const size_t n = 20000000;
+    const int n_repeats = 5;
+    vector<double> a(n), b(n, 1.0), c(n, 2.0);
+    vector<long> ints(n, 1), ints_out(n);
+
+    cout << "n = " << n << ", times in ms (average of " << n_repeats << " repeats)" << endl;
+    cout << setw(14) << left << "backend" << right << setw(14) << "for (triad)" << setw(14) << "reduce (sum)" \
+         << setw(14) << "scan (sum)" << endl;
+
+    for (Backend backend: backends) {
+        // warm up: the first call may start threads
+        parallel_for(backend, n, [&](size_t i) { a[i] = 0.; });
+
+        auto t_start = chrono::steady_clock::now();
+        for (int r=0;r<n_repeats;r++) {
+            parallel_for(backend, n, [&](size_t i) { a[i] = b[i] + 3.0*c[i]; }); }
+        double t_for = seconds_since(t_start)/n_repeats;
+
+        double sum = 0.;
+        t_start = chrono::steady_clock::now();
+        for (int r=0;r<n_repeats;r++) {
+            sum = parallel_reduce(backend, n, 0., [&](size_t i) { return a[i]; }, plus<double>()); }
+        double t_reduce = seconds_since(t_start)/n_repeats;
+
+        t_start = chrono::steady_clock::now();
+        for (int r=0;r<n_repeats;r++) {
+            parallel_scan(backend, ints.data(), ints_out.data(), n, plus<long>(), 0L); }
+        double t_scan = seconds_since(t_start)/n_repeats;
+
+        bool correct = (sum == 7.0*n) && (ints_out[n-1] == long(n)) && (ints_out[n/2] == long(n/2+1));
+        cout << setw(14) << left << backend_name(backend) << right << fixed << setprecision(2) << setw(14) << 1.0e3*t_for \
+             << setw(14) << 1.0e3*t_reduce << setw(14) << 1.0e3*t_scan << "   " << (correct ? "correct" : "WRONG") << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,248 @@
+/*
+Per-thread buffered output from parallel regions
+
+In fork_join.cpp every iteration of the parallel for loop does
+    cout << "I'm doing a parallel for loop! Thread no.: " << omp_get_thread_num() << endl;
+This is fine for a demonstration, but it is very slow: the standard streams are shared by all threads, so each "<<"
+takes a lock on the stream (and the lines of different threads can still interleave, since the lock is only held for
+a single "<<"). Worse, "endl" does not just write a newline, it also FLUSHES the stream, i.e. makes a write() system call
+for every single line. The threads spend their time queueing for the lock and for the kernel, and the loop is
+effectively serialised.
+
+The cure is to let each thread collect its lines in its own private memory buffer, and to write the buffer out in a
+single write() system call when it is full, or when the threads have joined. The LineSink class below does this:
+    LineSink sink(STDOUT_FILENO);
+    #pragma omp parallel for
+    for (int i=0;i<n;i++) {
+        sink.line(i) << "iteration " << i << " on thread " << omp_get_thread_num(); // the newline is added for you
+    }
+    sink.flush(); // after the join
+Each thread only ever touches its own buffer, so no lock is needed while writing lines. In ORDERED mode, the lines are
+kept in memory until flush() and then sorted by the index given to line() (e.g. the loop iteration), so that the
+output is the same as that of the serial loop, whatever the number of threads and the schedule.
+
+The main() function shows the ordered output and then times the loop writing with cout and endl, with cout and '\n',
+and with the LineSink. The timed output is sent to /dev/null. Finally, a LineSink writing to a file descriptor that
+cannot be written shows that a failed write() is reported by error() rather than thrown (the sink writes from
+destructors, where an exception would terminate the program); a write() interrupted by a signal is simply retried.
+
+Compile with:
+g++ -std=c++17 -O2 -o buffered_output buffered_output.cpp -fopenmp
+(C++17 for the aligned operator new: before it, the std::vector of ThreadBuffers ignores their alignas(64))
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <omp.h>
+
+using namespace std;
+
+class LineSink {
+
+    // a line in a thread's buffer, recorded for ordered mode
+    struct LineRecord {
+        long index;
+        size_t offset, length;
+    };
+
+    /* one buffer per thread, aligned to a cache line so that neighbouring threads' bookkeeping does not share a line.
+       std::vector only honours the alignment from C++17 on, where std::allocator uses the aligned operator new */
+    struct alignas(64) ThreadBuffer {
+        ostringstream text;
+        vector<LineRecord> lines;
+    };
+
+    int fd;
+    bool ordered;
+    size_t flush_threshold;
+    vector<ThreadBuffer> buffers;
+    mutex write_mutex;
+    int write_error = 0; // errno of the first failed write(), 0 if none (guarded by write_mutex)
+
+    /* write a whole buffer with (in the normal case) a single write() system call, retrying if a signal interrupts it.
+       This is called from destructors (of Line and LineSink), so it must not throw: a failure is recorded for error()
+       instead, and the rest of the buffer is dropped */
+    bool write_all(const string& data) {
+        lock_guard<mutex> lock(write_mutex); // so that a partial write cannot be interleaved with another thread's
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = ::write(fd, data.data()+written, data.size()-written);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                if (write_error == 0) write_error = errno;
+                return false; }
+            written += n; }
+        return true;
+    }
+
+    public:
+
+    /* the sink writes to the file descriptor fd (e.g. STDOUT_FILENO). In unordered mode each thread's buffer is
+       written as soon as it holds flush_threshold bytes */
+    LineSink(int fd, bool ordered=false, size_t flush_threshold=1<<16) :
+        fd(fd), ordered(ordered), flush_threshold(flush_threshold), buffers(omp_get_max_threads()) {}
+
+    LineSink(const LineSink&) = delete;
+    LineSink& operator=(const LineSink&) = delete;
+
+    ~LineSink() { flush(); }
+
+    // errno of the first write() that failed (the lines it held are lost), or 0 if all the output has been written
+    int error() {
+        lock_guard<mutex> lock(write_mutex);
+        return write_error;
+    }
+
+    /* a single line of output. The line is terminated (and, in unordered mode, the buffer written if it is full) when
+       the Line object is destroyed, i.e. at the end of the statement sink.line(i) << ... << ...; */
+    class Line {
+
+        LineSink& sink;
+        ThreadBuffer& buf;
+        long index;
+        size_t start;
+        bool active = true; // false once moved from, so that the line is only terminated once
+
+        public:
+
+        Line(LineSink& sink, ThreadBuffer& buf, long index) :
+            sink(sink), buf(buf), index(index), start(buf.text.tellp()) {}
+
+        Line(const Line&) = delete;
+        Line(Line&& rhs) : sink(rhs.sink), buf(rhs.buf), index(rhs.index), start(rhs.start) { rhs.active = false; }
+
+        ~Line() {
+            if (!active) return;
+            buf.text << '\n';
+            size_t end = buf.text.tellp();
+            if (sink.ordered) {
+                buf.lines.push_back(LineRecord{index, start, end-start});
+            } else if (end >= sink.flush_threshold) {
+                sink.write_all(buf.text.str());
+                buf.text.str(""); }
+        }
+
+        template <class T>
+        Line& operator<<(const T& x) {
+            buf.text << x;
+            return *this; }
+    };
+
+    // start a new line from the calling thread. index is only used in ordered mode, to sort the lines
+    Line line(long index=0) { return Line(*this, buffers[omp_get_thread_num()], index); }
+
+    /* write out everything that is still buffered. Must be called outside of the parallel region (after the join).
+       In ordered mode, the lines of all threads are merged in order of their index and written with a single write() */
+    void flush() {
+        cout.flush(); // anything already written to cout should appear before our lines
+        if (!ordered) {
+            for (auto& buf: buffers) {
+                if (buf.text.tellp() > 0) write_all(buf.text.str());
+                buf.text.str(""); }
+            return; }
+
+        /* each thread is normally handed its loop iterations in increasing order, so its own lines are already
+           sorted, and we only need to merge the per-thread sequences (otherwise we sort them first) */
+        const int n_buffers = buffers.size();
+        vector<string> texts(n_buffers);
+        size_t total = 0;
+        for (int t=0;t<n_buffers;t++) {
+            vector<LineRecord>& lines = buffers[t].lines;
+            auto by_index = [](const LineRecord& x, const LineRecord& y) { return x.index < y.index; };
+            if (!is_sorted(lines.begin(), lines.end(), by_index)) stable_sort(lines.begin(), lines.end(), by_index);
+            texts[t] = buffers[t].text.str();
+            total += texts[t].size(); }
+
+        string merged;
+        merged.reserve(total);
+        vector<size_t> next(n_buffers, 0); // next line to take from each thread's buffer
+        while (true) {
+            int t_min = -1;
+            for (int t=0;t<n_buffers;t++) {
+                if (next[t] < buffers[t].lines.size() && \
+                    (t_min<0 || buffers[t].lines[next[t]].index < buffers[t_min].lines[next[t_min]].index)) t_min = t; }
+            if (t_min < 0) break;
+            const LineRecord& rec = buffers[t_min].lines[next[t_min]++];
+            merged.append(texts[t_min], rec.offset, rec.length); }
+        if (!merged.empty()) write_all(merged);
+
+        for (auto& buf: buffers) { buf.text.str(""); buf.lines.clear(); }
+    }
+};
+
+int main () {
+
+    const int max_no_threads = omp_get_max_threads();
+
+    // the loop of fork_join.cpp, writing through an ordered LineSink: the lines come out in iteration order
+    cout << "Ordered output from a parallel for loop on " << max_no_threads << " threads:" << endl;
+    {
+    LineSink sink(STDOUT_FILENO, true);
+    #pragma omp parallel for schedule(dynamic)
+    for (int i=0;i<3*max_no_threads;i++) {
+        sink.line(i) << "Iteration " << i << " of the parallel for loop was done by thread no.: " << omp_get_thread_num();
+    }
+    sink.flush();
+    }
+
+    // now time the loop with a large number of iterations, with stdout temporarily redirected to /dev/null
+    const int n = 1000000;
+    const int saved_stdout = dup(STDOUT_FILENO);
+    const int dev_null = open("/dev/null", O_WRONLY);
+
+    auto time_loop = [&](const string& name, void (*loop)(int)) {
+        cout.flush();
+        dup2(dev_null, STDOUT_FILENO);
+        double t_start = omp_get_wtime();
+        loop(n);
+        cout.flush();
+        double t = omp_get_wtime() - t_start;
+        dup2(saved_stdout, STDOUT_FILENO);
+        cout << setw(30) << left << name << right << setw(10) << fixed << setprecision(1) << 1.0e3*t << " ms" << endl; };
+
+    cout << "\nWriting " << n << " lines from a parallel for loop:" << endl;
+    time_loop("cout with endl", [](int n) {
+        #pragma omp parallel for
+        for (int i=0;i<n;i++) cout << "I'm doing a parallel for loop! Thread no.: " << omp_get_thread_num() << endl; });
+    time_loop("cout with '\\n'", [](int n) {
+        #pragma omp parallel for
+        for (int i=0;i<n;i++) cout << "I'm doing a parallel for loop! Thread no.: " << omp_get_thread_num() << '\n'; });
+    time_loop("LineSink", [](int n) {
+        LineSink sink(STDOUT_FILENO);
+        #pragma omp parallel for
+        for (int i=0;i<n;i++) sink.line(i) << "I'm doing a parallel for loop! Thread no.: " << omp_get_thread_num();
+        sink.flush(); });
+    time_loop("LineSink (ordered)", [](int n) {
+        LineSink sink(STDOUT_FILENO, true);
+        #pragma omp parallel for
+        for (int i=0;i<n;i++) sink.line(i) << "I'm doing a parallel for loop! Thread no.: " << omp_get_thread_num();
+        sink.flush(); });
+
+    close(dev_null);
+    close(saved_stdout);
+
+    /* a sink whose writes fail (here, a file descriptor opened for reading only): the error is reported by error(), and
+       the destructor, which writes out the last line, does not throw */
+    int error;
+    const int read_only = open("/dev/null", O_RDONLY);
+    {
+    LineSink sink(read_only);
+    sink.line() << "this line is lost";
+    sink.flush();
+    error = sink.error();
+    sink.line() << "and so is this one, written by the destructor";
+    }
+    close(read_only);
+    cout << "\nWriting to a read-only file descriptor: " << (error != 0 ? strerror(error) : "NO ERROR REPORTED") << endl;
+
+    return error != 0 ? 0 : 1;
+}
@@ -0,0 +1,275 @@
+/*
+Region-level profiling of OpenMP programs with an OMPT tool
+
+It is hard to see where the time goes inside "#pragma omp parallel" regions such as those of fork_join.cpp and
+privacy.cpp. A wall-clock timer around the region tells us how long the region took, but not how much of that time
+was spent forking the threads, doing useful work, or WAITING at the barriers (including the implicit barrier at the end
+of every "omp for" loop and every parallel region), where fast threads sit idle until the slowest thread arrives.
+
+OpenMP 5.0 defines a tools interface, OMPT, for exactly this purpose. The OpenMP runtime looks for a function
+    ompt_start_tool()
+in the program, or in the shared libraries listed in the OMP_TOOL_LIBRARIES environment variable. If it finds one, it
+calls it at startup, and the tool can then register CALLBACKS which the runtime invokes at events such as the start and
+end of a parallel region, the start and end of each thread's share of the work (its "implicit task"), the start and
+end of each wait at a barrier, and the creation of explicit tasks. The program being profiled needs no changes at all.
+
+This file is such a tool. For every parallel region (identified by its return address in the code, printed as
+function+offset) and every thread, it records:
+    - fork latency: time from the master thread starting the region to each thread starting its implicit task
+    - join latency: time from the last thread arriving at the region's closing barrier to the master continuing
+    - barrier wait: total time spent waiting at barriers, taskwaits and taskgroups
+    - work: time in the implicit task, minus the barrier wait
+    - tasks: number of explicit tasks created
+At the end of the program it prints a summary table to stderr, and writes a timeline of every region, work span and
+barrier wait in the Chrome trace event JSON format (open it in chrome://tracing or https://ui.perfetto.dev) to the
+file named by the OMPT_PROFILER_TRACE environment variable (default ompt_trace.json).
+
+NB GCC's OpenMP runtime (libgomp) does not implement OMPT. Use the LLVM OpenMP runtime (libomp), e.g. with clang, or
+the Intel compilers. Build the tool as a shared library, and the program as usual (-rdynamic lets the tool print the
+names of the functions containing the parallel regions):
+clang++ -std=c++11 -O2 -shared -fPIC -o libompt_profiler.so ompt_profiler.cpp -ldl
+clang++ -std=c++11 -O2 -rdynamic -o fork_join fork_join.cpp -fopenmp
+and run the program with:
+OMP_TOOL_LIBRARIES=./libompt_profiler.so ./fork_join
+(libomp also implements libgomp's interface, so a program compiled with g++ -fopenmp can be profiled by running it
+against libomp instead, e.g. via a libgomp.so.1 symlink to libomp.so in LD_LIBRARY_PATH)
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <dlfcn.h>
+#include <omp-tools.h>
+
+using namespace std;
+
+namespace {
+
+// time in microseconds since the tool was loaded
+double now_us() {
+    static const auto t0 = chrono::steady_clock::now();
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+}
+
+// one execution of a parallel region. Allocated by the master thread at parallel_begin, and pointed to by parallel_data
+struct RegionInstance {
+    const void* codeptr;
+    double t_begin, t_end = 0.;
+    atomic<double> t_last_arrival{0.}; // latest time at which a thread arrived at the closing barrier
+    unsigned int n_threads = 0;
+};
+
+// a span on the timeline
+struct TraceEvent {
+    const char* name;
+    const void* codeptr;
+    double t_begin, duration;
+};
+
+// accumulated statistics for one region on one thread
+struct RegionStats {
+    long instances = 0;
+    double fork_latency = 0., join_latency = 0., barrier_wait = 0., work = 0.;
+    long tasks = 0;
+};
+
+// per-thread state. Only ever touched by its own thread until finalize(), so no locking is needed
+struct ThreadState {
+    int index;
+    vector<RegionInstance*> region_stack;  // regions this thread is currently running an implicit task of
+    vector<double> task_begin_stack;
+    vector<double> barrier_wait_stack;     // barrier wait accumulated in the current implicit task
+    double wait_begin = 0.;
+    map<const void*, RegionStats> stats;
+    vector<TraceEvent> events;
+};
+
+/* everything recorded so far. NB the runtime calls tool_finalize() during its own shutdown, which may come after the
+   destructors of this library's global objects have run, so the registry is allocated once and never destroyed */
+struct Registry {
+    mutex registry_mutex;
+    vector<ThreadState*> all_threads;
+    vector<RegionInstance*> all_regions;
+};
+
+Registry& registry() {
+    static Registry* reg = new Registry;
+    return *reg;
+}
+
+atomic<int> next_thread_index{0};
+thread_local ThreadState* this_thread = nullptr;
+
+ompt_set_callback_t ompt_set_callback_fn;
+
+ThreadState* get_thread_state() {
+    if (!this_thread) {
+        this_thread = new ThreadState;
+        this_thread->index = next_thread_index++;
+        lock_guard<mutex> lock(registry().registry_mutex);
+        registry().all_threads.push_back(this_thread); }
+    return this_thread;
+}
+
+// "function+0xoffset" for a code address, using the dynamic symbol table
+string describe_codeptr(const void* codeptr) {
+    Dl_info info;
+    ostringstream ss;
+    if (codeptr && dladdr(codeptr, &info) && info.dli_sname) {
+        ss << info.dli_sname << "+0x" << hex << ((const char*)codeptr - (const char*)info.dli_saddr);
+    } else {
+        ss << codeptr; }
+    return ss.str();
+}
+
+/* CALLBACKS. Their signatures are fixed by the OpenMP specification */
+
+void on_thread_begin(ompt_thread_t, ompt_data_t* thread_data) {
+    thread_data->value = get_thread_state()->index;
+}
+
+void on_parallel_begin(ompt_data_t*, const ompt_frame_t*, ompt_data_t* parallel_data, unsigned int requested_parallelism,
+                       int, const void* codeptr_ra) {
+    RegionInstance* region = new RegionInstance;
+    region->codeptr = codeptr_ra;
+    region->t_begin = now_us();
+    region->n_threads = requested_parallelism;
+    parallel_data->ptr = region;
+    lock_guard<mutex> lock(registry().registry_mutex);
+    registry().all_regions.push_back(region);
+}
+
+void on_parallel_end(ompt_data_t* parallel_data, ompt_data_t*, int, const void*) {
+    RegionInstance* region = static_cast<RegionInstance*>(parallel_data->ptr);
+    region->t_end = now_us();
+    ThreadState* ts = get_thread_state();
+    ts->events.push_back(TraceEvent{"parallel region", region->codeptr, region->t_begin, region->t_end - region->t_begin});
+    RegionStats& stats = ts->stats[region->codeptr];
+    double t_last = region->t_last_arrival.load();
+    if (t_last > 0.) stats.join_latency += region->t_end - t_last;
+}
+
+void on_implicit_task(ompt_scope_endpoint_t endpoint, ompt_data_t* parallel_data, ompt_data_t*,
+                      unsigned int, unsigned int, int flags) {
+    if (flags & ompt_task_initial) return; // the implicit task of the initial (serial) thread is not a region
+    ThreadState* ts = get_thread_state();
+    double t = now_us();
+    if (endpoint == ompt_scope_begin) {
+        RegionInstance* region = static_cast<RegionInstance*>(parallel_data->ptr);
+        ts->region_stack.push_back(region);
+        ts->task_begin_stack.push_back(t);
+        ts->barrier_wait_stack.push_back(0.);
+        RegionStats& stats = ts->stats[region->codeptr];
+        stats.instances++;
+        stats.fork_latency += t - region->t_begin;
+    } else if (!ts->region_stack.empty()) {
+        // NB parallel_data may be NULL at the end of an implicit task, so we use our own record of the region
+        RegionInstance* region = ts->region_stack.back();
+        double t_begin = ts->task_begin_stack.back(), wait = ts->barrier_wait_stack.back();
+        ts->region_stack.pop_back(); ts->task_begin_stack.pop_back(); ts->barrier_wait_stack.pop_back();
+        ts->stats[region->codeptr].work += (t - t_begin) - wait;
+        ts->events.push_back(TraceEvent{"implicit task", region->codeptr, t_begin, t - t_begin}); }
+}
+
+void on_sync_region_wait(ompt_sync_region_t kind, ompt_scope_endpoint_t endpoint, ompt_data_t*, ompt_data_t*,
+                         const void*) {
+    ThreadState* ts = get_thread_state();
+    if (ts->region_stack.empty()) return;
+    RegionInstance* region = ts->region_stack.back();
+    double t = now_us();
+    if (endpoint == ompt_scope_begin) {
+        ts->wait_begin = t;
+        // the barrier at the very end of the parallel region: record the latest arrival, for the join latency
+        if (kind == ompt_sync_region_barrier_implicit_parallel || kind == ompt_sync_region_barrier_implicit) {
+            double prev = region->t_last_arrival.load();
+            while (prev < t && !region->t_last_arrival.compare_exchange_weak(prev, t)) {} }
+    } else {
+        double wait = t - ts->wait_begin;
+        ts->barrier_wait_stack.back() += wait;
+        ts->stats[region->codeptr].barrier_wait += wait;
+        ts->events.push_back(TraceEvent{"barrier wait", region->codeptr, ts->wait_begin, wait}); }
+}
+
+void on_task_create(ompt_data_t*, const ompt_frame_t*, ompt_data_t*, int flags, int, const void*) {
+    if (!(flags & ompt_task_explicit)) return;
+    ThreadState* ts = get_thread_state();
+    if (!ts->region_stack.empty()) ts->stats[ts->region_stack.back()->codeptr].tasks++;
+}
+
+void write_chrome_trace(const string& filename) {
+    ofstream f(filename);
+    f << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (ThreadState* ts: registry().all_threads) {
+        for (const TraceEvent& ev: ts->events) {
+            f << (first ? "" : ",\n") << "{\"name\":\"" << ev.name << "\",\"cat\":\"" << describe_codeptr(ev.codeptr) \
+              << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << ts->index << ",\"ts\":" << fixed << setprecision(3) << ev.t_begin \
+              << ",\"dur\":" << ev.duration << "}";
+            first = false; }
+        f << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ts->index \
+          << ",\"args\":{\"name\":\"OpenMP thread " << ts->index << "\"}}";
+        first = false; }
+    f << "\n]}\n";
+}
+
+void print_summary() {
+    map<const void*, vector<pair<int,RegionStats>>> by_region;
+    for (ThreadState* ts: registry().all_threads) {
+        for (auto& entry: ts->stats) by_region[entry.first].push_back(make_pair(ts->index, entry.second)); }
+
+    cerr << "\n==== OMPT profile: times in microseconds, summed over all instances of each region ====" << endl;
+    for (auto& region: by_region) {
+        cerr << "\nparallel region at " << describe_codeptr(region.first) << endl;
+        cerr << setw(8) << "thread" << setw(11) << "instances" << setw(14) << "fork latency" << setw(14) << "join latency" \
+             << setw(14) << "barrier wait" << setw(14) << "work" << setw(8) << "tasks" << endl;
+        for (auto& thread: region.second) {
+            const RegionStats& s = thread.second;
+            cerr << setw(8) << thread.first << setw(11) << s.instances << fixed << setprecision(1) << setw(14) << s.fork_latency \
+                 << setw(14) << s.join_latency << setw(14) << s.barrier_wait << setw(14) << s.work << setw(8) << s.tasks << endl; }
+    }
+}
+
+int tool_initialize(ompt_function_lookup_t lookup, int, ompt_data_t*) {
+    ompt_set_callback_fn = (ompt_set_callback_t)lookup("ompt_set_callback");
+    if (!ompt_set_callback_fn) return 0; // returning 0 deactivates the tool
+    ompt_set_callback_fn(ompt_callback_thread_begin, (ompt_callback_t)&on_thread_begin);
+    ompt_set_callback_fn(ompt_callback_parallel_begin, (ompt_callback_t)&on_parallel_begin);
+    ompt_set_callback_fn(ompt_callback_parallel_end, (ompt_callback_t)&on_parallel_end);
+    ompt_set_callback_fn(ompt_callback_implicit_task, (ompt_callback_t)&on_implicit_task);
+    ompt_set_callback_fn(ompt_callback_task_create, (ompt_callback_t)&on_task_create);
+    if (ompt_set_callback_fn(ompt_callback_sync_region_wait, (ompt_callback_t)&on_sync_region_wait) == ompt_set_never) {
+        cerr << "ompt_profiler: this OpenMP runtime does not report barrier waits" << endl; }
+    now_us(); // start the clock
+    return 1;
+}
+
+void tool_finalize(ompt_data_t*) {
+    lock_guard<mutex> lock(registry().registry_mutex);
+    print_summary();
+    const char* trace_file = getenv("OMPT_PROFILER_TRACE");
+    string filename = trace_file ? trace_file : "ompt_trace.json";
+    write_chrome_trace(filename);
+    cerr << "\nompt_profiler: timeline written to " << filename << endl;
+    for (RegionInstance* region: registry().all_regions) delete region;
+}
+
+} // namespace
+
+// the entry point that the OpenMP runtime looks for
+extern "C" ompt_start_tool_result_t* ompt_start_tool(unsigned int, const char* runtime_version) {
+    static ompt_start_tool_result_t result;
+    result.initialize = &tool_initialize;
+    result.finalize = &tool_finalize;
+    result.tool_data.value = 0;
+    cerr << "ompt_profiler: attached to " << runtime_version << endl;
+    return &result;
+}
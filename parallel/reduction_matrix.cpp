@@ -0,0 +1,213 @@
+/*
+Correctness and performance test matrix for parallel reductions
+
+reduction.cpp shows the "reduction" clause on a vector of five ints, and prints the result without checking it. For
+floating point data, checking a parallel reduction is less simple than it looks: floating point addition is NOT
+associative ((a+b)+c and a+(b+c) can differ in the last bits), and a parallel reduction necessarily adds the numbers in
+a different order from the serial loop. Moreover, with "reduction(+:...)" the order depends on the number of threads,
+so the same program can give (slightly) different answers on different machines, or from one run to the next with
+dynamic scheduling. There are two reasonable requirements:
+    - FAST mode: any order is allowed, but the result must be within the error bound of floating point summation,
+      |computed - exact| <= c * n * eps * sum(|x_i|)  (eps = 2^-53 for double), compared with an accurate reference
+    - DETERMINISTIC mode: the result must be bitwise identical for any number of threads. This is achieved by splitting
+      the data into blocks of a FIXED size (not one block per thread), reducing every block in a fixed order, and
+      combining the block results in a fixed order. The threads only decide who computes which block
+We test both, for each reduction kernel below, at 1, 2, 4, ... threads and for input sizes from 10^3 elements upwards.
+
+Checking correctness is not enough: we also want to catch performance regressions. For each run we report
+    - the SCALING EFFICIENCY relative to the single-thread time, T(1) / (p * T(p)), which is 100% for perfect scaling
+    - the memory bandwidth achieved (GB/s read), and as a fraction of a STREAM-style copy loop measured at the same
+      number of threads. A large reduction is memory-bound, so once the data no longer fits in cache the best we can
+      hope for is close to 100% of the STREAM bandwidth
+The program exits with a non-zero status if any correctness check fails, so it can be used as a test.
+
+Run with an optional maximum input size, e.g. ./reduction_matrix 1000000000 (10^9 doubles need 8 GB of memory, so the
+default maximum is 10^8).
+
+Compile with:
+g++ -std=c++11 -O3 -march=native -o reduction_matrix reduction_matrix.cpp -fopenmp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+#include <limits>
+#include <omp.h>
+
+using namespace std;
+
+const size_t deterministic_block = 4096; // fixed block size of the deterministic kernels, independent of the threads
+
+// a reduction kernel: computes the sum of x[0..n-1] on n_threads threads
+struct Kernel {
+    string name;
+    bool deterministic; // if true, the result must be bitwise identical for every number of threads
+    double (*sum)(const double* x, size_t n, int n_threads);
+};
+
+// the "reduction" clause, as in reduction.cpp
+double sum_reduction_clause(const double* x, size_t n, int n_threads) {
+    double s = 0.;
+    #pragma omp parallel for reduction(+:s) num_threads(n_threads) schedule(static)
+    for (size_t i=0;i<n;i++) s += x[i];
+    return s;
+}
+
+// the same, also allowing the compiler to vectorise the sum on each thread (i.e. to reorder the additions again)
+double sum_reduction_simd(const double* x, size_t n, int n_threads) {
+    double s = 0.;
+    #pragma omp parallel for simd reduction(+:s) num_threads(n_threads) schedule(static)
+    for (size_t i=0;i<n;i++) s += x[i];
+    return s;
+}
+
+// pairwise combination of the block sums, in a fixed order: O(log n_blocks) rounding error growth rather than O(n_blocks)
+double pairwise_combine(vector<double>& partial) {
+    size_t m = partial.size();
+    while (m > 1) {
+        size_t half = (m+1)/2;
+        for (size_t i=0;i+half<m;i++) partial[i] += partial[i+half];
+        m = half; }
+    return m ? partial[0] : 0.;
+}
+
+/* DETERMINISTIC: fixed-size blocks, each reduced with the same (vectorised) instruction sequence whatever thread
+   runs it, then combined pairwise in a fixed order */
+double sum_deterministic_blocked(const double* x, size_t n, int n_threads) {
+    const size_t n_blocks = (n + deterministic_block - 1)/deterministic_block;
+    vector<double> partial(n_blocks);
+    #pragma omp parallel for num_threads(n_threads) schedule(static)
+    for (size_t b=0;b<n_blocks;b++) {
+        const size_t lo = b*deterministic_block, hi = min(n, lo+deterministic_block);
+        double s = 0.;
+        #pragma omp simd reduction(+:s)
+        for (size_t i=lo;i<hi;i++) s += x[i];
+        partial[b] = s; }
+    return pairwise_combine(partial);
+}
+
+/* DETERMINISTIC and more accurate: Kahan (compensated) summation within each block, which carries the rounding error
+   of every addition along in a second variable c. NB this must not be compiled with -ffast-math, which would
+   "simplify" the compensation away */
+double sum_deterministic_kahan(const double* x, size_t n, int n_threads) {
+    const size_t n_blocks = (n + deterministic_block - 1)/deterministic_block;
+    vector<double> partial(n_blocks);
+    #pragma omp parallel for num_threads(n_threads) schedule(static)
+    for (size_t b=0;b<n_blocks;b++) {
+        const size_t lo = b*deterministic_block, hi = min(n, lo+deterministic_block);
+        double s = 0., c = 0.;
+        for (size_t i=lo;i<hi;i++) {
+            double y = x[i] - c;
+            double t = s + y;
+            c = (t - s) - y;
+            s = t; }
+        partial[b] = s; }
+    return pairwise_combine(partial);
+}
+
+// accurate reference sum (long double accumulation of Kahan-compensated blocks), and the sum of absolute values
+void reference_sum(const double* x, size_t n, long double& exact, long double& abs_sum) {
+    exact = 0.L; abs_sum = 0.L;
+    long double c = 0.L;
+    for (size_t i=0;i<n;i++) {
+        long double y = (long double)x[i] - c;
+        long double t = exact + y;
+        c = (t - exact) - y;
+        exact = t;
+        abs_sum += fabsl(x[i]); }
+}
+
+// STREAM-style copy bandwidth (bytes read + written per second) on n_threads threads
+double stream_copy_bandwidth(const double* x, double* y, size_t n, int n_threads) {
+    double best = 0.;
+    for (int r=0;r<3;r++) {
+        double t_start = omp_get_wtime();
+        #pragma omp parallel for num_threads(n_threads) schedule(static)
+        for (size_t i=0;i<n;i++) y[i] = x[i];
+        double t = omp_get_wtime() - t_start;
+        best = max(best, 2.0*sizeof(double)*double(n)/t); }
+    return best;
+}
+
+bool same_bits(double a, double b) { return memcmp(&a, &b, sizeof(double)) == 0; }
+
+int main (int argc, char* argv[]) {
+
+    size_t max_size = 100000000;
+    if (argc > 1) max_size = strtoull(argv[1], nullptr, 10);
+
+    const int max_no_threads = omp_get_max_threads();
+    vector<int> thread_counts;
+    for (int p=1;p<max_no_threads;p*=2) thread_counts.push_back(p);
+    thread_counts.push_back(max_no_threads);
+
+    vector<Kernel> kernels = {
+        {"reduction clause", false, sum_reduction_clause},
+        {"reduction simd", false, sum_reduction_simd},
+        {"deterministic", true, sum_deterministic_blocked},
+        {"deterministic kahan", true, sum_deterministic_kahan}};
+
+    // random data of both signs, so that there is cancellation, initialised in parallel (first touch)
+    vector<double> x(max_size), y(max_size);
+    #pragma omp parallel
+    {
+        mt19937_64 rng(1234 + omp_get_thread_num());
+        uniform_real_distribution<double> dist(-1.0, 1.0);
+        #pragma omp for schedule(static)
+        for (size_t i=0;i<max_size;i++) { x[i] = dist(rng); y[i] = 0.; }
+    }
+
+    // the STREAM bandwidth at each thread count, on the largest array
+    vector<double> stream_bw;
+    for (int p: thread_counts) stream_bw.push_back(stream_copy_bandwidth(x.data(), y.data(), max_size, p));
+
+    const double eps = numeric_limits<double>::epsilon()/2.;
+    int n_failures = 0;
+
+    cout << setw(20) << left << "kernel" << right << setw(12) << "n" << setw(9) << "threads" << setw(12) << "time (ms)" \
+         << setw(12) << "efficiency" << setw(10) << "GB/s" << setw(12) << "% STREAM" << setw(12) << "rel. error" \
+         << "  check" << endl;
+
+    for (size_t n=1000;n<=max_size;n*=10) {
+        long double exact, abs_sum;
+        reference_sum(x.data(), n, exact, abs_sum);
+        // enough repeats for about 10^8 elements in total, so that small sizes are timed accurately
+        const int n_repeats = int(max<size_t>(1, min<size_t>(100000, 100000000/n)));
+
+        for (const Kernel& kernel: kernels) {
+            double t1 = 0., result1 = 0.;
+            for (size_t ip=0;ip<thread_counts.size();ip++) {
+                const int p = thread_counts[ip];
+                double result = kernel.sum(x.data(), n, p); // warm up
+                double t_start = omp_get_wtime();
+                for (int r=0;r<n_repeats;r++) result = kernel.sum(x.data(), n, p);
+                double t = (omp_get_wtime() - t_start)/n_repeats;
+                if (ip == 0) { t1 = t; result1 = result; }
+
+                // FAST mode check: within the error bound of floating point summation (with c = 2)
+                double err = double(fabsl((long double)result - exact));
+                bool ok = err <= 2.0*double(n)*eps*double(abs_sum);
+                // DETERMINISTIC mode check: bitwise identical to the single-thread result
+                if (kernel.deterministic) ok = ok && same_bits(result, result1);
+                if (!ok) n_failures++;
+
+                double bw = sizeof(double)*double(n)/t;
+                cout << setw(20) << left << kernel.name << right << setw(12) << n << setw(9) << p << fixed \
+                     << setprecision(4) << setw(12) << 1.0e3*t << setprecision(1) << setw(11) << 100.0*t1/(p*t) << "%" \
+                     << setw(10) << bw/1.0e9 << setw(11) << 100.0*bw/stream_bw[ip] << "%" << scientific << setprecision(2) \
+                     << setw(12) << err/double(abs_sum) << "  " << (ok ? "ok" : "FAILED") << defaultfloat << endl;
+            }
+        }
+    }
+
+    if (n_failures > 0) {
+        cout << "\n" << n_failures << " check(s) FAILED" << endl;
+        return 1; }
+    cout << "\nall checks passed" << endl;
+    return 0;
+}
@@ -0,0 +1,257 @@
+/*
+Parallel prefix sum (SCAN)
+
+In reduction.cpp we used the "reduction" clause to combine the values from all loop iterations into a single result.
+A SCAN (or prefix sum) is the generalisation where we keep every partial result:
+    input:            3  1  4  1  5
+    inclusive scan:   3  4  8  9 14      out[i] = in[0] + ... + in[i]
+    exclusive scan:   0  3  4  8  9      out[i] = init + in[0] + ... + in[i-1]
+Scans are the building block of many parallel algorithms, e.g. stream compaction (the exclusive scan of a 0/1 "keep"
+flag gives the output position of each kept element) and building the row offsets of a sparse (CSR) matrix from the
+number of nonzeros in each row.
+
+At first sight a scan is inherently serial, since out[i] depends on out[i-1]. However, if the operator is ASSOCIATIVE,
+i.e. (a+b)+c = a+(b+c), then the work can be split into blocks. With one block per thread, the TWO-PASS algorithm is:
+    1. (parallel) each thread reduces its own block to a single value, the block sum
+    2. (serial)   an exclusive scan of the (few) block sums gives the offset at which each block starts
+    3. (parallel) each thread scans its own block, starting from its offset
+The operator does NOT need to be commutative, since the order of the elements is never changed.
+
+OpenMP 5.0 added a "scan" directive which does this for us, for loops with a reduction(inscan,...) clause:
+    #pragma omp parallel for reduction(inscan,+:x)
+    for (int i=0;i<n;i++) {
+        x += in[i];
+        #pragma omp scan inclusive(x)   // statements before the directive are the input phase, after are the scan phase
+        out[i] = x; }
+The same directive can be used with "omp simd", to vectorise the scan within a single thread's block. Here we always
+use the two-pass blocked algorithm, which handles any user-defined associative operator (see Affine below, which is
+associative but not commutative). For the built-in + operator on arithmetic types, the in-block scans use the
+"omp simd" scan directive when the compiler supports it (GCC >= 10, or any OpenMP >= 5.0 compiler). This turns out to
+be faster than putting the scan directive on the whole "parallel for" loop, which is also timed below.
+
+The main() function checks the results and benchmarks against a serial loop and std::inclusive_scan with the C++17
+execution policies.
+
+Compile with:
+g++ -std=c++17 -O3 -march=native -o scan scan.cpp -fopenmp -ltbb
+(GCC's parallel execution policies are implemented on top of Intel TBB, hence -ltbb)
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <execution>
+#include <omp.h>
+
+using namespace std;
+
+#if defined(_OPENMP) && (_OPENMP >= 201811 || (defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 10))
+#define HAVE_OMP_SCAN
+#endif
+
+/* in-block serial scans, starting from the value carried in from the previous blocks.
+   For + on arithmetic types, the "simd" scan lets the compiler vectorise the loop-carried dependency */
+template <class T, class Op>
+T block_inclusive_scan(const T* in, T* out, size_t n, Op op, T carry) {
+    for (size_t i=0;i<n;i++) {
+        carry = op(carry, in[i]);
+        out[i] = carry; }
+    return carry;
+}
+
+template <class T, class Op>
+T block_exclusive_scan(const T* in, T* out, size_t n, Op op, T carry) {
+    for (size_t i=0;i<n;i++) {
+        T next = op(carry, in[i]); // NB in and out may be the same array
+        out[i] = carry;
+        carry = next; }
+    return carry;
+}
+
+#ifdef HAVE_OMP_SCAN
+template <class T, class U>
+typename enable_if<is_arithmetic<T>::value, T>::type block_inclusive_scan(const T* in, T* out, size_t n, plus<U>, T carry) {
+    #pragma omp simd reduction(inscan,+:carry)
+    for (size_t i=0;i<n;i++) {
+        carry += in[i];
+        #pragma omp scan inclusive(carry)
+        out[i] = carry; }
+    return carry;
+}
+
+template <class T, class U>
+typename enable_if<is_arithmetic<T>::value, T>::type block_exclusive_scan(const T* in, T* out, size_t n, plus<U>, T carry) {
+    #pragma omp simd reduction(inscan,+:carry)
+    for (size_t i=0;i<n;i++) {
+        out[i] = carry;
+        #pragma omp scan exclusive(carry)
+        carry += in[i]; }
+    return carry;
+}
+#endif
+
+/* the TWO-PASS blocked algorithm, for any associative operator op with identity element. One contiguous block per
+   thread. If exclusive is true, out[i] excludes in[i] and the scan starts from init */
+template <class T, class Op>
+void blocked_scan(const T* in, T* out, size_t n, Op op, T identity, T init, bool exclusive) {
+
+    const int n_threads = omp_get_max_threads();
+    vector<T> block_offsets(n_threads+1, identity);
+
+    #pragma omp parallel num_threads(n_threads)
+    {
+        const int t = omp_get_thread_num();
+        const int nt = omp_get_num_threads(); // may be fewer threads than requested
+        const size_t lo = n*t/nt, hi = n*(t+1)/nt;
+
+        // pass 1: reduce each block
+        T block_sum = identity;
+        for (size_t i=lo;i<hi;i++) block_sum = op(block_sum, in[i]);
+        block_offsets[t+1] = block_sum;
+
+        // serial exclusive scan of the block sums, by a single thread (there is an implicit barrier at the end)
+        #pragma omp barrier
+        #pragma omp single
+        {
+        block_offsets[0] = init;
+        for (int b=1;b<=nt;b++) block_offsets[b] = op(block_offsets[b-1], block_offsets[b]);
+        }
+
+        // pass 2: scan each block starting from its offset
+        if (exclusive) {
+            block_exclusive_scan(in+lo, out+lo, hi-lo, op, block_offsets[t]);
+        } else {
+            block_inclusive_scan(in+lo, out+lo, hi-lo, op, block_offsets[t]); }
+    }
+}
+
+/* the user-facing functions. identity is the identity element of op (e.g. 0 for +, 1 for *), which the blocked
+   algorithm needs to start each block's reduction */
+template <class T, class Op>
+void parallel_inclusive_scan(const T* in, T* out, size_t n, Op op, T identity) {
+    blocked_scan(in, out, n, op, identity, identity, false);
+}
+
+template <class T, class Op>
+void parallel_exclusive_scan(const T* in, T* out, size_t n, T init, Op op, T identity) {
+    blocked_scan(in, out, n, op, identity, init, true);
+}
+
+#ifdef HAVE_OMP_SCAN
+/* for comparison: the scan directive applied to the whole parallel loop. NB GCC implements this with a temporary
+   array of n partial results, so it moves more memory than blocked_scan() with the simd scan inside each block */
+// GCC warns about the temporary it generates for the inscan reduction, not about anything in this code
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+template <class T>
+void omp_inclusive_scan(const T* in, T* out, size_t n) {
+    T x = T(0);
+    #pragma omp parallel for reduction(inscan,+:x)
+    for (size_t i=0;i<n;i++) {
+        x += in[i];
+        #pragma omp scan inclusive(x)
+        out[i] = x; }
+}
+#pragma GCC diagnostic pop
+#endif
+
+/* a user-defined associative but NOT commutative operator: composition of affine maps f(x) = a*x + b.
+   Composing g after f gives g(f(x)) = g.a*f.a*x + g.a*f.b + g.b. Unsigned arithmetic wraps around, so is exact */
+struct Affine {
+    unsigned long a, b;
+    bool operator==(const Affine& rhs) const { return a==rhs.a && b==rhs.b; }
+};
+
+struct Compose {
+    Affine operator()(const Affine& f, const Affine& g) const { return Affine{g.a*f.a, g.a*f.b + g.b}; }
+};
+
+template <class T>
+bool same(const vector<T>& x, const vector<T>& y) { return equal(x.begin(), x.end(), y.begin()); }
+
+int main () {
+
+    cout << "Running on " << omp_get_max_threads() << " threads" << endl;
+#ifdef HAVE_OMP_SCAN
+    cout << "Using the OpenMP simd scan directive within blocks for + on arithmetic types" << endl;
+#else
+    cout << "OpenMP scan directive not supported, using serial scans within blocks" << endl;
+#endif
+
+    // first, check correctness on a small example of each kind of scan
+    vector<long> small = {3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5};
+    vector<long> small_out(small.size()), small_ref(small.size());
+
+    parallel_inclusive_scan(small.data(), small_out.data(), small.size(), plus<long>(), 0L);
+    inclusive_scan(small.begin(), small.end(), small_ref.begin());
+    cout << "\ninclusive scan of 3 1 4 1 5 9 2 6 5 3 5: ";
+    for (auto x: small_out) cout << x << " ";
+    cout << (same(small_out, small_ref) ? "(correct)" : "(WRONG)") << endl;
+
+    parallel_exclusive_scan(small.data(), small_out.data(), small.size(), 100L, plus<long>(), 0L);
+    exclusive_scan(small.begin(), small.end(), small_ref.begin(), 100L);
+    cout << "exclusive scan, starting from 100:       ";
+    for (auto x: small_out) cout << x << " ";
+    cout << (same(small_out, small_ref) ? "(correct)" : "(WRONG)") << endl;
+
+    parallel_inclusive_scan(small.data(), small_out.data(), small.size(),
+                            [](long x, long y) { return max(x,y); }, numeric_limits<long>::min());
+    cout << "running maximum:                         ";
+    for (auto x: small_out) cout << x << " ";
+    cout << endl;
+
+    // the non-commutative operator, on a large input so that every thread has a block
+    const size_t n_affine = 1000003;
+    vector<Affine> maps(n_affine), maps_out(n_affine), maps_ref(n_affine);
+    for (size_t i=0;i<n_affine;i++) maps[i] = Affine{2*i+1, i};
+    parallel_inclusive_scan(maps.data(), maps_out.data(), n_affine, Compose(), Affine{1,0});
+    inclusive_scan(maps.begin(), maps.end(), maps_ref.begin(), Compose());
+    cout << "scan of " << n_affine << " composed affine maps (non-commutative): " \
+         << (same(maps_out, maps_ref) ? "correct" : "WRONG") << endl;
+
+    // benchmark on a large array of doubles. NB floating point + is not exactly associative, so we compare with a tolerance
+    const size_t n = 20000000;
+    const int n_repeats = 5;
+    vector<double> in(n), out(n), ref(n);
+    for (size_t i=0;i<n;i++) in[i] = double(i%7) - 3.0;
+    for (size_t i=0,s=0;i<n;i++) { s += i%7; ref[i] = double(s) - 3.0*double(i+1); } // exact in double
+
+    auto check = [&](const vector<double>& x) {
+        double max_err = 0.;
+        for (size_t i=0;i<n;i++) max_err = max(max_err, abs(x[i]-ref[i]));
+        return max_err < 1.0e-6 ? "correct" : "WRONG"; };
+
+    auto time_scan = [&](const string& name, function<void()> scan_func) {
+        fill(out.begin(), out.end(), 0.);
+        scan_func(); // warm up, and touch the pages of out
+        double t_start = omp_get_wtime();
+        for (int r=0;r<n_repeats;r++) scan_func();
+        double t = (omp_get_wtime() - t_start)/double(n_repeats);
+        cout << setw(34) << left << name << right << setw(10) << fixed << setprecision(2) << 1.0e3*t << " ms" \
+             << setw(10) << setprecision(2) << 2.0*sizeof(double)*double(n)/t/1.0e9 << " GB/s   " << check(out) << endl; };
+
+    cout << "\nInclusive scan of " << n << " doubles (" << n_repeats << " repeats):" << endl;
+    time_scan("serial loop", [&]() {
+        double s = 0.;
+        for (size_t i=0;i<n;i++) { s += in[i]; out[i] = s; } });
+    time_scan("std::inclusive_scan (seq)", [&]() {
+        inclusive_scan(execution::seq, in.begin(), in.end(), out.begin()); });
+    time_scan("std::inclusive_scan (par)", [&]() {
+        inclusive_scan(execution::par, in.begin(), in.end(), out.begin()); });
+    time_scan("std::inclusive_scan (par_unseq)", [&]() {
+        inclusive_scan(execution::par_unseq, in.begin(), in.end(), out.begin()); });
+#ifdef HAVE_OMP_SCAN
+    time_scan("omp parallel for scan directive", [&]() {
+        omp_inclusive_scan(in.data(), out.data(), n); });
+#endif
+    time_scan("parallel_inclusive_scan (+)", [&]() {
+        parallel_inclusive_scan(in.data(), out.data(), n, plus<double>(), 0.); });
+    time_scan("parallel_inclusive_scan (lambda)", [&]() {
+        parallel_inclusive_scan(in.data(), out.data(), n, [](double x, double y) { return x+y; }, 0.); });
+
+    return 0;
+}
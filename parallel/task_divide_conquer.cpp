@@ -0,0 +1,221 @@
+/*
+Recursive divide and conquer with OpenMP TASKS
+
+fork_join.cpp describes fork-join as the "divide and conquer" of parallel computing, but a "parallel for" loop can only
+split a loop whose iterations are known in advance. Recursive algorithms (quicksort, merge sort, tree traversals...)
+split the work into pieces whose sizes are only discovered as the recursion proceeds. For these, OpenMP provides TASKS:
+    - "#pragma omp task" packages the following statement/block, and the data it needs, into a task that may be run
+      later by any thread of the team (or immediately by the thread that created it)
+    - "#pragma omp taskwait" waits until all of the CHILD tasks created so far by the current task have completed
+    - "#pragma omp taskgroup" (a block) waits at its end for all tasks created inside it AND all of their descendants
+Tasks must be created from inside a parallel region. The usual pattern is that one thread starts the recursion (via
+"#pragma omp single") while the rest of the team waits at the implicit barrier at the end of the "single" construct,
+where they pick up and run the tasks as they are created.
+
+Creating a task has an overhead (a few hundred ns up to a microsecond), so when the subproblems become small it is
+much faster to finish them serially. We therefore stop creating tasks when a subproblem is smaller than a SERIAL
+CUTOFF, or when the recursion is deeper than a DEPTH LIMIT (there is little to gain once there are many more tasks
+than threads).
+
+Here we write a small framework: a problem is described by a class with the member functions
+    size_t size() const;                 // size of the problem, compared with the cutoff
+    void solve_serial();                 // solve the problem without creating tasks
+    pair<Problem,Problem> split();       // divide the problem into two subproblems
+    void combine(const TaskConfig&, int depth); // combine the solved subproblems (may itself create tasks, at the
+                                                // recursion depth of the problem, so that cfg.max_depth still holds)
+and parallel merge sort and parallel quicksort are written with it. The main() function benchmarks them against
+serial std::sort and against a "flat loop" version (sort one chunk per thread in a parallel for loop, then merge the
+chunks pairwise in further parallel for loops).
+
+Compile with:
+g++ -std=c++11 -O2 -o task_divide_conquer task_divide_conquer.cpp -fopenmp
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <omp.h>
+
+using namespace std;
+
+struct TaskConfig {
+    size_t serial_cutoff = 10000; // subproblems smaller than this are solved serially
+    int max_depth = 16;           // no tasks are created below this recursion depth
+};
+
+// recursive driver. Must be called from inside a parallel region (see divide_and_conquer())
+template <class Problem>
+void divide_and_conquer_task(Problem problem, const TaskConfig& cfg, int depth) {
+    // NB problems of size <= 2 are always solved serially, so that every split makes progress
+    if (problem.size() <= max(cfg.serial_cutoff, size_t(2)) || depth >= cfg.max_depth) {
+        problem.solve_serial();
+        return; }
+    pair<Problem,Problem> subproblems = problem.split();
+    /* the first half is a new task, which another thread may pick up. The current thread carries on with the second
+       half itself, rather than creating a second task and then sitting idle in the taskwait */
+    #pragma omp task firstprivate(subproblems) shared(cfg)
+    divide_and_conquer_task(subproblems.first, cfg, depth+1);
+    divide_and_conquer_task(subproblems.second, cfg, depth+1);
+    #pragma omp taskwait
+    problem.combine(cfg, depth);
+}
+
+// user-facing function: fork the thread team, and let one thread start the recursion
+template <class Problem>
+void divide_and_conquer(Problem problem, const TaskConfig& cfg) {
+    #pragma omp parallel
+    #pragma omp single
+    {
+        #pragma omp taskgroup
+        divide_and_conquer_task(problem, cfg, 0);
+    }
+}
+
+/* MERGE of two sorted ranges [a1,a2) and [b1,b2) into out, itself divided and conquered: take the middle element of
+   the longer range, find where it would go in the shorter range (binary search), and merge the two lower and the two
+   upper parts independently. Without this, the final merge of the merge sort would be serial, O(n) */
+template <class T>
+struct MergeProblem {
+    const T *a1, *a2, *b1, *b2;
+    T *out;
+
+    size_t size() const { return (a2-a1) + (b2-b1); }
+    void solve_serial() { merge(a1, a2, b1, b2, out); }
+    pair<MergeProblem,MergeProblem> split() {
+        const T *l1=a1, *l2=a2, *s1=b1, *s2=b2; // longer and shorter ranges
+        if (l2-l1 < s2-s1) { swap(l1,s1); swap(l2,s2); }
+        const T *l_mid = l1 + (l2-l1)/2;
+        const T *s_mid = lower_bound(s1, s2, *l_mid);
+        T *out_mid = out + (l_mid-l1) + (s_mid-s1);
+        return make_pair(MergeProblem{l1, l_mid, s1, s_mid, out}, MergeProblem{l_mid, l2, s_mid, s2, out_mid});
+    }
+    void combine(const TaskConfig&, int) {}
+};
+
+/* MERGE SORT of [data, data+n), using buf (of the same size) as scratch space. The result is left in data, or in buf if
+   in_buf is set. The two halves are sorted into the OTHER array, and merged from there into this one, so the arrays
+   swap roles at every level ("ping-pong") and no level has to copy its merged result back */
+template <class T>
+struct MergeSortProblem {
+    T *data, *buf;
+    size_t n;
+    bool in_buf;
+
+    size_t size() const { return n; }
+    void solve_serial() {
+        sort(data, data+n);
+        if (in_buf) copy(data, data+n, buf); }
+    pair<MergeSortProblem,MergeSortProblem> split() {
+        size_t half = n/2;
+        return make_pair(MergeSortProblem{data, buf, half, !in_buf}, MergeSortProblem{data+half, buf+half, n-half, !in_buf});
+    }
+    // the two halves are now sorted, in the other array: merge them (in parallel) into this one
+    void combine(const TaskConfig& cfg, int depth) {
+        size_t half = n/2;
+        const T *src = in_buf ? data : buf;
+        T *dst = in_buf ? buf : data;
+        divide_and_conquer_task(MergeProblem<T>{src, src+half, src+half, src+n, dst}, cfg, depth);
+    }
+};
+
+/* QUICKSORT of [data, data+n): all of the work is done in split(), by partitioning around a pivot, and combine() has
+   nothing to do. We use a three-way partition (less than / equal to / greater than the pivot), so that inputs with
+   many repeated values do not degrade to O(n^2), and a median-of-three pivot */
+template <class T>
+struct QuickSortProblem {
+    T *data;
+    size_t n;
+
+    size_t size() const { return n; }
+    void solve_serial() { sort(data, data+n); }
+    pair<QuickSortProblem,QuickSortProblem> split() {
+        T a = data[0], b = data[n/2], c = data[n-1];
+        T pivot = max(min(a,b), min(max(a,b),c));
+        T *lt_end = partition(data, data+n, [pivot](const T& x) { return x < pivot; });
+        T *eq_end = partition(lt_end, data+n, [pivot](const T& x) { return !(pivot < x); });
+        return make_pair(QuickSortProblem{data, size_t(lt_end-data)}, QuickSortProblem{eq_end, size_t(data+n-eq_end)});
+    }
+    void combine(const TaskConfig&, int) {}
+};
+
+template <class T>
+void parallel_merge_sort(vector<T>& v, const TaskConfig& cfg) {
+    vector<T> buf(v.size());
+    divide_and_conquer(MergeSortProblem<T>{v.data(), buf.data(), v.size(), false}, cfg);
+}
+
+template <class T>
+void parallel_quicksort(vector<T>& v, const TaskConfig& cfg) {
+    divide_and_conquer(QuickSortProblem<T>{v.data(), v.size()}, cfg);
+}
+
+/* the same sort with flat "parallel for" loops only: sort one chunk per thread, then merge neighbouring pairs of
+   chunks in a sequence of parallel for loops. The number of pairs halves at every level, so fewer and fewer threads
+   have any work to do, and the last merge is done by a single thread */
+template <class T>
+void flat_loop_sort(vector<T>& v) {
+    const int n_chunks = omp_get_max_threads();
+    const size_t n = v.size();
+    vector<size_t> bounds(n_chunks+1);
+    for (int c=0;c<=n_chunks;c++) bounds[c] = n*c/n_chunks;
+
+    #pragma omp parallel for schedule(static,1)
+    for (int c=0;c<n_chunks;c++) sort(v.begin()+bounds[c], v.begin()+bounds[c+1]);
+
+    vector<T> buf(n);
+    for (int width=1;width<n_chunks;width*=2) {
+        #pragma omp parallel for schedule(dynamic,1)
+        for (int c=0;c<n_chunks;c+=2*width) {
+            size_t lo = bounds[c], mid = bounds[min(c+width,n_chunks)], hi = bounds[min(c+2*width,n_chunks)];
+            merge(v.begin()+lo, v.begin()+mid, v.begin()+mid, v.begin()+hi, buf.begin()+lo);
+            copy(buf.begin()+lo, buf.begin()+hi, v.begin()+lo);
+        }
+    }
+}
+
+int main () {
+
+    const size_t n = 10000000;
+    const int n_repeats = 3;
+    cout << "Sorting " << n << " random ints on " << omp_get_max_threads() << " threads" << endl;
+
+    mt19937 rng(42);
+    vector<int> input(n);
+    for (auto& x: input) x = int(rng() % 1000000); // lots of repeated values, to exercise the three-way partition
+    vector<int> reference = input;
+    sort(reference.begin(), reference.end());
+
+    auto time_sort = [&](const string& name, void (*sort_func)(vector<int>&, const TaskConfig&), const TaskConfig& cfg) {
+        double t_total = 0.;
+        bool correct = true;
+        for (int r=0;r<n_repeats;r++) {
+            vector<int> v = input;
+            double t_start = omp_get_wtime();
+            sort_func(v, cfg);
+            t_total += omp_get_wtime() - t_start;
+            correct = correct && (v==reference); }
+        cout << setw(40) << left << name << right << setw(10) << fixed << setprecision(1) \
+             << 1.0e3*t_total/n_repeats << " ms   " << (correct ? "correct" : "WRONG") << endl; };
+
+    TaskConfig cfg;
+    time_sort("serial std::sort", [](vector<int>& v, const TaskConfig&) { sort(v.begin(), v.end()); }, cfg);
+    time_sort("flat parallel for loops", [](vector<int>& v, const TaskConfig&) { flat_loop_sort(v); }, cfg);
+
+    // the effect of the serial cutoff. With a tiny cutoff, the overhead of creating tasks dominates
+    for (size_t cutoff: {1000, 10000, 100000, 1000000}) {
+        cfg.serial_cutoff = cutoff;
+        time_sort("merge sort tasks, cutoff " + to_string(cutoff), parallel_merge_sort<int>, cfg);
+        time_sort("quicksort tasks, cutoff " + to_string(cutoff), parallel_quicksort<int>, cfg); }
+
+    // the effect of the depth limit. With max_depth = 0 no tasks are created at all
+    cfg.serial_cutoff = 10000;
+    for (int depth: {0, 2, 4, 8}) {
+        cfg.max_depth = depth;
+        time_sort("merge sort tasks, max depth " + to_string(depth), parallel_merge_sort<int>, cfg);
+        time_sort("quicksort tasks, max depth " + to_string(depth), parallel_quicksort<int>, cfg); }
+
+    return 0;
+}
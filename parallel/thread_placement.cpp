@@ -0,0 +1,257 @@
+/*
+NUMA- and affinity-aware thread placement
+
+In fork_join.cpp we set the number of threads with omp_set_num_threads(), but left it to the operating system to decide
+which CPU each thread runs on. On a multi-socket machine this matters: memory is physically attached to one of the
+sockets (a NUMA node, for Non-Uniform Memory Access), and reading memory attached to the other socket is slower and
+has to cross the inter-socket link. Two things must therefore be controlled:
+    - THREAD AFFINITY: each thread should stay on one CPU (rather than being migrated by the scheduler), so that
+      its cache contents and its local memory stay local
+    - DATA PLACEMENT: on Linux, a page of memory is placed on the NUMA node of the thread that first WRITES to it
+      (the FIRST-TOUCH policy), NOT on the node of the thread that allocated it. So if the master thread initialises
+      a large array serially, the whole array lands on the master thread's socket, and every thread on the other
+      socket reads its data remotely. The cure is to initialise the data in parallel, with the same loop schedule
+      as the loops that later use it
+
+The standard OpenMP way of pinning threads is with environment variables, e.g.:
+    export OMP_PLACES=cores        # a "place" is a physical core (alternatives: threads, sockets, or explicit lists)
+    export OMP_PROC_BIND=close     # put consecutive threads on neighbouring places (or spread, to spread them out)
+Here we also do it by hand, with pthread_setaffinity_np(), after reading the machine TOPOLOGY (which logical CPUs
+are on which socket, which are SMT "hyperthread" siblings of the same physical core, and which NUMA node each CPU
+belongs to) from the files under /sys/devices/system/. This is Linux-specific.
+
+The main() function prints the topology and times a bandwidth-bound STREAM-style "triad" loop a[i] = b[i] + s*c[i],
+with and without pinning and with serial vs first-touch initialisation.
+
+Compile with:
+g++ -std=c++11 -O2 -o thread_placement thread_placement.cpp -fopenmp -pthread
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <omp.h>
+
+using namespace std;
+
+// a logical CPU, as seen by the operating system
+struct Cpu {
+    int id;          // logical CPU number, as used by sched_setaffinity()
+    int socket;      // physical package id
+    int core;        // physical core id (unique only within a socket)
+    int smt_rank;    // 0 for the first hardware thread of a core, 1 for its first SMT sibling, etc.
+    int numa_node;
+};
+
+// read the first integer from a file under /sys. Returns fallback if the file does not exist
+int read_sys_int(const string& path, int fallback) {
+    ifstream f(path);
+    int value;
+    if (f >> value) return value;
+    return fallback;
+}
+
+// parse a Linux CPU list, e.g. "0-3,8-11,16"
+vector<int> parse_cpu_list(const string& list) {
+    vector<int> cpus;
+    stringstream ss(list);
+    string range;
+    while (getline(ss, range, ',')) {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        int lo = stoi(range.substr(0, dash));
+        int hi = (dash==string::npos) ? lo : stoi(range.substr(dash+1));
+        for (int c=lo;c<=hi;c++) cpus.push_back(c); }
+    return cpus;
+}
+
+// the topology of the CPUs that this process is allowed to run on
+class Topology {
+
+    public:
+
+    vector<Cpu> cpus;
+    int n_sockets = 0, n_cores = 0, n_numa_nodes = 0;
+
+    Topology() {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed); // e.g. restricted by taskset, or a container's cpuset
+
+        // NUMA node of each CPU. If there is no NUMA information, everything is on node 0
+        map<int,int> node_of_cpu;
+        for (int node=0;;node++) {
+            ifstream f("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+            if (!f) break;
+            string list;
+            getline(f, list);
+            for (int c: parse_cpu_list(list)) node_of_cpu[c] = node;
+            n_numa_nodes = node+1; }
+        n_numa_nodes = max(n_numa_nodes, 1);
+
+        map<pair<int,int>,int> threads_seen_on_core; // (socket, core) -> no. of hardware threads found so far
+        for (int c=0;c<CPU_SETSIZE;c++) {
+            if (!CPU_ISSET(c, &allowed)) continue;
+            const string dir = "/sys/devices/system/cpu/cpu" + to_string(c) + "/topology/";
+            Cpu cpu;
+            cpu.id = c;
+            cpu.socket = read_sys_int(dir + "physical_package_id", 0);
+            cpu.core = read_sys_int(dir + "core_id", c);
+            cpu.smt_rank = threads_seen_on_core[make_pair(cpu.socket, cpu.core)]++;
+            cpu.numa_node = node_of_cpu.count(c) ? node_of_cpu[c] : 0;
+            cpus.push_back(cpu);
+            n_sockets = max(n_sockets, cpu.socket+1); }
+        n_cores = threads_seen_on_core.size();
+    }
+
+    /* order the CPUs for pinning thread i to cpu_order[i % n]:
+       "close"  - fill one socket before moving on to the next; within a socket, one thread per physical core before
+                  using the SMT siblings
+       "spread" - alternate between sockets, so that every socket (and its memory bandwidth) is used even with
+                  few threads; again physical cores before SMT siblings */
+    vector<int> cpu_order(const string& policy) const {
+        vector<Cpu> sorted = cpus;
+        if (policy=="spread") {
+            // round-robin over sockets: rank each CPU by its index among the CPUs of the same socket and SMT rank
+            map<pair<int,int>,int> index_on_socket;
+            vector<pair<vector<int>,int>> keyed;
+            for (const Cpu& cpu: sorted) {
+                int k = index_on_socket[make_pair(cpu.socket, cpu.smt_rank)]++;
+                keyed.push_back(make_pair(vector<int>{cpu.smt_rank, k, cpu.socket}, cpu.id)); }
+            sort(keyed.begin(), keyed.end());
+            vector<int> order;
+            for (auto& key: keyed) order.push_back(key.second);
+            return order;
+        }
+        stable_sort(sorted.begin(), sorted.end(), [](const Cpu& x, const Cpu& y) {
+            if (x.socket != y.socket) return x.socket < y.socket;
+            if (x.smt_rank != y.smt_rank) return x.smt_rank < y.smt_rank;
+            return x.core < y.core; });
+        vector<int> order;
+        for (const Cpu& cpu: sorted) order.push_back(cpu.id);
+        return order;
+    }
+
+    void print() const {
+        cout << n_sockets << " socket(s), " << n_cores << " physical core(s), " << cpus.size() \
+             << " logical CPU(s), " << n_numa_nodes << " NUMA node(s)" << endl;
+        cout << "  cpu socket core smt node" << endl;
+        for (const Cpu& cpu: cpus) {
+            cout << setw(5) << cpu.id << setw(7) << cpu.socket << setw(5) << cpu.core << setw(4) << cpu.smt_rank \
+                 << setw(5) << cpu.numa_node << endl; }
+    }
+};
+
+// pin the calling thread to a single logical CPU. Returns false if this is not allowed
+bool pin_this_thread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// allow the calling thread to run on any of the CPUs in the topology again
+void unpin_this_thread(const Topology& topo) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const Cpu& cpu: topo.cpus) CPU_SET(cpu.id, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/* pin each thread of the OpenMP thread team to a CPU. The runtime keeps the same OS threads in its pool between
+   parallel regions, so the pinning persists for later regions with the same number of threads.
+   If the user has already asked the runtime to bind threads (OMP_PROC_BIND), we leave them alone */
+void pin_omp_threads(const Topology& topo, int n_threads, const string& policy) {
+    if (omp_get_proc_bind() != omp_proc_bind_false) {
+        cout << "OMP_PROC_BIND is set, leaving thread placement to the OpenMP runtime" << endl;
+        return; }
+    const vector<int> order = topo.cpu_order(policy);
+    #pragma omp parallel num_threads(n_threads)
+    {
+        int cpu = order[omp_get_thread_num() % order.size()];
+        if (!pin_this_thread(cpu)) {
+            #pragma omp critical
+            cout << "warning: could not pin thread " << omp_get_thread_num() << " to cpu " << cpu << endl;
+        }
+    }
+}
+
+void unpin_omp_threads(const Topology& topo, int n_threads) {
+    if (omp_get_proc_bind() != omp_proc_bind_false) return;
+    #pragma omp parallel num_threads(n_threads)
+    unpin_this_thread(topo);
+}
+
+/* FIRST-TOUCH allocation: allocate an array of n elements *without* initialising it (new T[n] for a type without a
+   constructor does not write to the memory, so no pages are placed yet), then initialise it in parallel with a static
+   schedule. Any later "omp for schedule(static)" loop over the same range with the same number of threads gives
+   each thread the same iterations, so each thread's part of the array is on its own NUMA node */
+template <class T>
+unique_ptr<T[]> first_touch_array(size_t n, T value, int n_threads) {
+    unique_ptr<T[]> arr(new T[n]);
+    #pragma omp parallel for schedule(static) num_threads(n_threads)
+    for (size_t i=0;i<n;i++) arr[i] = value;
+    return arr;
+}
+
+// for comparison, the usual serial initialisation, which places every page on the master thread's NUMA node
+template <class T>
+unique_ptr<T[]> serial_touch_array(size_t n, T value) {
+    unique_ptr<T[]> arr(new T[n]);
+    for (size_t i=0;i<n;i++) arr[i] = value;
+    return arr;
+}
+
+// STREAM triad a = b + s*c, repeated n_repeats times. Returns the memory bandwidth in GB/s
+double triad_bandwidth(double* a, const double* b, const double* c, size_t n, int n_threads, int n_repeats) {
+    const double s = 3.0;
+    double t_start = omp_get_wtime();
+    for (int r=0;r<n_repeats;r++) {
+        #pragma omp parallel for schedule(static) num_threads(n_threads)
+        for (size_t i=0;i<n;i++) a[i] = b[i] + s*c[i];
+    }
+    double t = omp_get_wtime() - t_start;
+    return 3.0*sizeof(double)*double(n)*double(n_repeats)/t/1.0e9;
+}
+
+int main () {
+
+    Topology topo;
+    topo.print();
+
+    const int max_no_threads = omp_get_max_threads();
+    const size_t n = 40000000; // 3 arrays of 320 MB, much larger than the caches
+    const int n_repeats = 10;
+
+    cout << "\nSTREAM triad on " << max_no_threads << " threads, GB/s:" << endl;
+    cout << setw(12) << "" << setw(16) << "serial init" << setw(16) << "first touch" << endl;
+
+    for (string placement: {"unpinned", "close", "spread"}) {
+        if (placement=="unpinned") {
+            unpin_omp_threads(topo, max_no_threads);
+        } else {
+            pin_omp_threads(topo, max_no_threads, placement); }
+
+        cout << setw(12) << left << placement << right;
+        {
+        auto a = serial_touch_array(n, 0.), b = serial_touch_array(n, 1.), c = serial_touch_array(n, 2.);
+        cout << setw(16) << fixed << setprecision(2) << triad_bandwidth(a.get(), b.get(), c.get(), n, max_no_threads, n_repeats);
+        }
+        {
+        auto a = first_touch_array(n, 0., max_no_threads), b = first_touch_array(n, 1., max_no_threads), \
+             c = first_touch_array(n, 2., max_no_threads);
+        cout << setw(16) << fixed << setprecision(2) << triad_bandwidth(a.get(), b.get(), c.get(), n, max_no_threads, n_repeats);
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*
+Counting heap allocations, by replacing the global operator new and operator delete
+
+Allocations are often the hidden cost of a container or of an operator that returns a new object: each one is a call
+to malloc, and the memory it returns is cold. A program can replace the global operator new (and operator delete) with
+its own versions, which every new expression, std::allocator, std::string, std::vector... then calls. The replacements
+here pass the requests on to malloc and free, and count them in two global variables:
+    - n_allocations: the number of calls to operator new (any form, including arrays and, from C++17, over-aligned types)
+    - heap_bytes: the total number of bytes requested
+Read the counters before and after a piece of code to get the allocations it made. They are plain (non-atomic)
+counters, so they are only exact when one thread allocates at a time.
+
+Replacement functions must be defined exactly once in a program: include this header in ONE translation unit only
+(e.g. the file with main()).
+
+NB GCC 11 and later warn (-Wmismatched-new-delete) when a replacement operator delete that calls free() is inlined into
+a delete expression, as they assume that memory from operator new must not be passed to free(). Here it came from the
+operator new below, i.e. from malloc, so the warning is silenced around the definitions.
+*/
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+std::size_t n_allocations = 0;
+std::size_t heap_bytes = 0;
+
+void* operator new(std::size_t n) {
+    n_allocations++;
+    heap_bytes += n;
+    if (void* p = std::malloc(n)) return p;
+    throw std::bad_alloc();
+}
+
+#if __cpp_aligned_new
+void* operator new(std::size_t n, std::align_val_t align) {
+    n_allocations++;
+    heap_bytes += n;
+    const std::size_t a = std::size_t(align);
+    if (void* p = std::aligned_alloc(a, (n + a - 1)/a*a)) return p; // aligned_alloc wants a multiple of the alignment
+    throw std::bad_alloc();
+}
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#if __cpp_aligned_new
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+#endif
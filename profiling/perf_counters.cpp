@@ -0,0 +1,131 @@
+/*
+Hardware performance counters around benchmark kernels, with the PerfScope class of perf_scope.h
+
+We wrap three kinds of kernel from elsewhere in this repository in a PerfScope, to see their cache and branch
+behaviour and not only their run time:
+    - the union-find loop at the heart of Karger's algorithm (algorithms/karger.cpp), on a large random graph. find()
+      follows parent pointers to random places in memory, so we expect LLC and dTLB misses per edge
+    - a sum reduction as in parallel/reduction.cpp, serial and with "reduction(+:...)". A sequential scan of memory is
+      handled well by the hardware prefetchers, so we expect a high IPC and few misses per element. In the parallel
+      version every thread counts its own events, and we add them up after the join
+    - pushing and popping a large number of elements through std::stack (contiguous blocks, via std::deque) and through
+      a linked list (one heap allocation per node), the two designs compared in brief_examples/stack_and_queue.cpp
+
+Compile with:
+g++ -std=c++11 -O2 -o perf_counters perf_counters.cpp -fopenmp
+and, if the counters are reported as unavailable, allow access to them with e.g.
+sudo sysctl kernel.perf_event_paranoid=2
+*/
+
+#include <iostream>
+#include <vector>
+#include <list>
+#include <stack>
+#include <random>
+#include <omp.h>
+#include "perf_scope.h"
+
+using namespace std;
+
+struct Edge { int src, dest; };
+
+struct subset { int parent, rank; };
+
+// union-find with path compression and union by rank, as in karger.cpp
+int find(vector<subset>& subsets, int i) {
+    if (subsets[i].parent != i) subsets[i].parent = find(subsets, subsets[i].parent);
+    return subsets[i].parent;
+}
+
+void Union(vector<subset>& subsets, int x, int y) {
+    int xroot = find(subsets, x), yroot = find(subsets, y);
+    if (subsets[xroot].rank < subsets[yroot].rank) {
+        subsets[xroot].parent = yroot;
+    } else if (subsets[xroot].rank > subsets[yroot].rank) {
+        subsets[yroot].parent = xroot;
+    } else {
+        subsets[yroot].parent = xroot;
+        subsets[xroot].rank++; }
+}
+
+// contract random edges until two super-vertices remain, and count the edges crossing the cut
+int karger_contract(int V, const vector<Edge>& edges, mt19937& rng) {
+    vector<subset> subsets(V);
+    for (int v=0;v<V;v++) subsets[v] = subset{v, 0};
+    int vertices = V;
+    uniform_int_distribution<int> pick(0, edges.size()-1);
+    while (vertices > 2) {
+        const Edge& e = edges[pick(rng)];
+        int subset1 = find(subsets, e.src), subset2 = find(subsets, e.dest);
+        if (subset1 == subset2) continue;
+        vertices--;
+        Union(subsets, subset1, subset2); }
+    int cutedges = 0;
+    for (const Edge& e: edges) {
+        if (find(subsets, e.src) != find(subsets, e.dest)) cutedges++; }
+    return cutedges;
+}
+
+int main () {
+
+    mt19937 rng(12345);
+
+    /* Karger's union-find loop on a random graph with 1 million vertices and 5 million edges. The first V-1 edges
+       join each vertex to a random earlier one, so that the graph is connected (otherwise the contraction could never
+       get down to two vertices) */
+    const int V = 1000000, E = 5000000;
+    vector<Edge> edges(E);
+    uniform_int_distribution<int> vertex(0, V-1);
+    for (int i=0;i<E;i++) {
+        if (i < V-1) {
+            edges[i] = Edge{i+1, int(rng() % (i+1))};
+        } else {
+            edges[i] = Edge{vertex(rng), vertex(rng)}; } }
+    int cut;
+    {
+    PerfScope perf("karger union-find     ", E);
+    cut = karger_contract(V, edges, rng);
+    }
+    cout << "  (cut found: " << cut << " edges)" << endl;
+
+    // a sum reduction over 100 million doubles
+    const size_t n = 100000000;
+    vector<double> v(n, 1.0);
+    double sum = 0.;
+    {
+    PerfScope perf("serial reduction      ", n);
+    for (size_t i=0;i<n;i++) sum += v[i];
+    }
+
+    // the parallel reduction: one PerfScope per thread, summed after the join
+    PerfCounts total;
+    double psum = 0.;
+    #pragma omp parallel reduction(+:psum)
+    {
+        PerfScope perf("", 0., false);
+        #pragma omp for
+        for (size_t i=0;i<n;i++) psum += v[i];
+        const PerfCounts& counts = perf.stop();
+        #pragma omp critical
+        total += counts;
+    }
+    total.print("parallel reduction    ", n);
+    cout << "  (sums: " << sum << " " << psum << ")" << endl;
+
+    // push and pop 10 million ints through std::stack and through a linked list
+    const int n_push = 10000000;
+    {
+    PerfScope perf("std::stack push/pop   ", 2.0*n_push);
+    stack<int> s;
+    for (int i=0;i<n_push;i++) s.push(i);
+    while (!s.empty()) s.pop();
+    }
+    {
+    PerfScope perf("linked list push/pop  ", 2.0*n_push);
+    list<int> l;
+    for (int i=0;i<n_push;i++) l.push_back(i);
+    while (!l.empty()) l.pop_back();
+    }
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+PerfScope: hardware performance counters around a block of code, via the Linux perf_event_open() system call
+
+Wall-clock time tells us how long a kernel took, but not WHY. The CPU's performance monitoring unit counts hardware
+events, and a few of them explain most of the performance of simple kernels:
+    - cycles and instructions: their ratio, the INSTRUCTIONS PER CYCLE (IPC), shows how well the core is being fed.
+      A modern core can retire ~4 instructions per cycle; an IPC well below 1 usually means the core is waiting on memory
+    - last level cache (LLC) misses: loads that had to go all the way to main memory (~100 ns each)
+    - branch misses: mispredicted branches, each costing ~15-20 cycles of wasted work
+    - dTLB misses: loads whose virtual-to-physical address translation was not cached, typical of random access over
+      a large memory range (e.g. following pointers in a linked list)
+
+Usage: construct a PerfScope at the start of a block; when it goes out of scope it prints the counts, IPC and the
+number of misses per element of the kernel:
+    {
+    PerfScope perf("sum of vector", v.size());
+    for (auto x: v) sum += x;
+    } // prints here
+The counters count only the calling THREAD. To measure a parallel region, create a PerfScope on every thread (with
+print=false), and add up the results of stop() with PerfCounts::operator+= after the join.
+
+The counters may not be available: the kernel setting /proc/sys/kernel/perf_event_paranoid may forbid their use
+(a value <= 2 allows a process to count its own user-space events, which is all we ask for), the process may be running
+in a container or virtual machine without access to the hardware counters, or the CPU may not support a particular
+event. In all of these cases the missing counts are reported as "n/a", and the time is still measured.
+*/
+
+#ifndef PERF_SCOPE_H
+#define PERF_SCOPE_H
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <cstdint>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+enum PerfEvent { perf_cycles, perf_instructions, perf_llc_misses, perf_branch_misses, perf_dtlb_misses, n_perf_events };
+
+// the counts from one PerfScope (or the sum of several)
+struct PerfCounts {
+
+    bool valid[n_perf_events] = {false, false, false, false, false};
+    double value[n_perf_events] = {0., 0., 0., 0., 0.};
+    double seconds = 0.;
+
+    PerfCounts& operator+=(const PerfCounts& rhs) {
+        for (int e=0;e<n_perf_events;e++) {
+            valid[e] = valid[e] || rhs.valid[e];
+            value[e] += rhs.value[e]; }
+        seconds = std::max(seconds, rhs.seconds); // the threads of a parallel region run at the same time
+        return *this; }
+
+    // print one line of results. n_elements is the number of elements processed by the kernel
+    void print(const std::string& label, double n_elements) const {
+        static const char* names[n_perf_events] = {"cycles", "instr", "LLC miss", "br miss", "dTLB miss"};
+        std::ios::fmtflags saved_flags = std::cout.flags();
+        std::streamsize saved_precision = std::cout.precision();
+        std::cout << label << ": " << std::fixed << std::setprecision(3) << 1.0e3*seconds << " ms";
+        if (valid[perf_cycles] && valid[perf_instructions] && value[perf_cycles] > 0.) {
+            std::cout << "  IPC " << std::setprecision(2) << value[perf_instructions]/value[perf_cycles]; }
+        for (int e=0;e<n_perf_events;e++) {
+            std::cout << "  " << names[e] << "/elem ";
+            if (valid[e] && n_elements > 0.) {
+                std::cout << std::setprecision(3) << value[e]/n_elements;
+            } else {
+                std::cout << "n/a"; } }
+        std::cout << std::endl;
+        std::cout.flags(saved_flags);
+        std::cout.precision(saved_precision); }
+};
+
+class PerfScope {
+
+    std::string label;
+    double n_elements;
+    bool print_on_exit, stopped = false;
+    int fd[n_perf_events];
+    int leader = -1; // the first counter that could be opened, which the others are grouped with
+    std::chrono::steady_clock::time_point t_start;
+    PerfCounts result;
+
+    static int perf_event_open(perf_event_attr* attr, int group_fd) {
+        // pid 0 and cpu -1: count the calling thread, on whichever CPU it runs
+        return syscall(SYS_perf_event_open, attr, 0, -1, group_fd, 0);
+    }
+
+    static perf_event_attr make_attr(PerfEvent e) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;       // the whole group is enabled at once, through the leader
+        attr.exclude_kernel = 1; // user-space events only, which is allowed up to perf_event_paranoid = 2
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        const uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        switch (e) {
+            case perf_cycles: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+            case perf_instructions: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+            case perf_llc_misses: attr.type = PERF_TYPE_HW_CACHE; attr.config = PERF_COUNT_HW_CACHE_LL | read_miss; break;
+            case perf_branch_misses: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+            default: attr.type = PERF_TYPE_HW_CACHE; attr.config = PERF_COUNT_HW_CACHE_DTLB | read_miss; break; }
+        return attr;
+    }
+
+    // explain (once per program) why there are no counters
+    static void warn_unavailable(int err) {
+        static bool warned = false;
+        if (warned) return;
+        warned = true;
+        int paranoid = -100;
+        std::ifstream f("/proc/sys/kernel/perf_event_paranoid");
+        f >> paranoid;
+        std::cerr << "PerfScope: hardware counters unavailable (" << std::strerror(err) << ", perf_event_paranoid = " \
+                  << paranoid << "), reporting time only" << std::endl;
+    }
+
+    public:
+
+    PerfScope(const std::string& label, double n_elements=0., bool print_on_exit=true) :
+        label(label), n_elements(n_elements), print_on_exit(print_on_exit) {
+        for (int e=0;e<n_perf_events;e++) {
+            perf_event_attr attr = make_attr(PerfEvent(e));
+            fd[e] = perf_event_open(&attr, leader);
+            if (fd[e] >= 0 && leader < 0) leader = fd[e]; }
+        if (leader < 0) {
+            warn_unavailable(errno);
+        } else {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP); }
+        t_start = std::chrono::steady_clock::now();
+    }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+    ~PerfScope() {
+        stop();
+        if (print_on_exit) result.print(label, n_elements);
+        for (int e=0;e<n_perf_events;e++) {
+            if (fd[e] >= 0) close(fd[e]); }
+    }
+
+    // stop counting and return the counts. Later calls return the same counts
+    const PerfCounts& stop() {
+        if (stopped) return result;
+        stopped = true;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+        if (leader < 0) return result;
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        for (int e=0;e<n_perf_events;e++) {
+            if (fd[e] < 0) continue;
+            uint64_t buf[3]; // value, time enabled, time running
+            if (read(fd[e], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0) continue;
+            // if there were more events than hardware counters, the kernel time-shared them: scale up to the full time
+            result.value[e] = double(buf[0])*double(buf[1])/double(buf[2]);
+            result.valid[e] = true; }
+        return result;
+    }
+};
+
+#endif
@@ -1,42 +1,38 @@
 /*
 2D array of unknown size as a class variable
+The matrix is a DenseMatrix (containers/dense_matrix.h): all the elements in one contiguous block, element (i,j) at
+offset i*ld + j, instead of an array of pointers to separately allocated rows (m+1 allocations, scattered in memory).
+The matrix knows its own size, so the class does not keep copies of it that could disagree.
+
+Compile with:
+g++ -std=c++17 -o 2darr_member 2darr_member.cpp
+(dense_matrix.h uses the aligned operator new of C++17)
 */
 
 #include <iostream>
+#include "../containers/dense_matrix.h"
 using namespace std;
 
 class Matrice
 {
 private:
-    int** mMatr; // pointer to pointer
-    int m, n;
+    DenseMatrix<int> mMatr; // one allocation, freed by its destructor
 public:
-    Matrice(const int m1, const int n1)
+    Matrice(const int m1, const int n1) : mMatr(m1, n1)
     {
-        m = m1;
-        n = n1;
-        mMatr = new int*[m]; 
-        for (int i = 0; i < m; i++) {
-            mMatr[i] = new int[n];
-            for (int j = 0; j < n; j++) {
-                mMatr[i][j] = j + (i*n); }
+        for (size_t i = 0; i < mMatr.rows(); i++) {
+            for (size_t j = 0; j < mMatr.cols(); j++) {
+                mMatr(i, j) = int(j + (i*mMatr.cols())); }
         }
     }
 
-    ~Matrice()
-    {
-        for (int i = 0; i < m; i++) {
-            delete [] mMatr[i]; }
-        delete [] mMatr;
-    }
-
     void print_elems()
     {
         // note that mMatr has the proper scope - we can access it from here!
         cout << "Printing elems:\n";
-        for (int i = 0; i < m; i++) {
-            for (int j = 0; j < n; j++) {
-                cout << mMatr[i][j] << "\n"; }
+        for (size_t i = 0; i < mMatr.rows(); i++) {
+            for (size_t j = 0; j < mMatr.cols(); j++) {
+                cout << mMatr(i, j) << "\n"; }
         }
         cout << "\n";
     }